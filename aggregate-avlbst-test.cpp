@@ -0,0 +1,172 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include "aggregate-avlbst.h"
+
+using namespace std;
+
+// Concatenates values in key order, to check that combine keeps its order
+struct ConcatAggregate
+{
+    typedef string summary_type;
+    static summary_type identity() { return ""; }
+    static summary_type lift(const int&, const char& value) { return string(1, value); }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return a + b; }
+};
+
+template<typename Map>
+long long referenceSum(const Map& m, int lo, int hi)
+{
+    long long sum = 0;
+    for(typename Map::const_iterator it = m.lower_bound(lo); it != m.end() && it->first <= hi; ++it)
+        sum += it->second;
+    return sum;
+}
+
+int main(int argc, char *argv[])
+{
+    AggregateAVLTree<int, long long> traffic;
+    for(int bucket = 0; bucket < 10; bucket++) traffic.insert(std::make_pair(bucket, bucket * 10LL));
+    cout << "Traffic in buckets 2..5: " << traffic.aggregate(2, 5) << endl;
+    traffic[3] = 1000;
+    cout << "After traffic[3] = 1000: " << traffic.aggregate(2, 5) << endl;
+    traffic.find(4).mutableValue() += 1;
+    cout << "After bumping bucket 4: " << traffic.aggregate(2, 5) << endl;
+    traffic.remove(3);
+    cout << "After removing bucket 3: " << traffic.aggregate(2, 5) << ", total " << traffic.total() << endl;
+
+    AggregateAVLTree<int, int, MinAggregate<int, int> > lows;
+    AggregateAVLTree<int, int, MaxAggregate<int, int> > highs;
+    AggregateAVLTree<int, int, CountAggregate<int, int> > counts;
+    const int readings[] = { 7, -3, 12, 5, 0, 9, -8, 4 };
+    for(int i = 0; i < 8; i++) {
+        lows.insert(std::make_pair(i * 5, readings[i]));
+        highs.insert(std::make_pair(i * 5, readings[i]));
+        counts.insert(std::make_pair(i * 5, readings[i]));
+    }
+    cout << "Keys 5..27: min " << lows.aggregate(5, 27) << ", max " << highs.aggregate(5, 27)
+         << ", count " << counts.aggregate(5, 27) << endl;
+
+    AggregateAVLTree<int, char, ConcatAggregate> letters;
+    string word = "aggregate";
+    for(size_t i = 0; i < word.size(); i++) letters.insert(std::make_pair((int)(i * 7 % word.size()), word[i]));
+    cout << "Concatenation of keys 1..6: " << letters.aggregate(1, 6) << endl;
+
+    // Randomized against std::map, mixing inserts, removes, batches and writes
+    AggregateAVLTree<int, long long> rt;
+    map<int, long long> reference;
+    srand(104);
+    bool ok = true;
+    for(int i = 0; ok && i < 20000; i++) {
+        int key = rand() % 1000;
+        int op = rand() % 10;
+        if(op < 3) {
+            rt.remove(key);
+            reference.erase(key);
+        }
+        else if(op < 6) {
+            rt.insert(std::make_pair(key, (long long)i));
+            reference[key] = i;
+        }
+        else if(op < 8 && reference.count(key) == 1) {
+            rt[key] -= 7;
+            reference[key] -= 7;
+        }
+        else if(op == 8) {
+            AggregateAVLTree<int, long long>::iterator it = rt.lower_bound(key);
+            map<int, long long>::iterator ref = reference.lower_bound(key);
+            for(int j = 0; j < 3 && it != rt.end(); j++, ++it, ++ref) {
+                it.mutableValue() *= 2;
+                ref->second *= 2;
+            }
+        }
+        else if(i % 500 == 0) {
+            std::vector<std::pair<int, long long> > batch;
+            for(int j = 0; j < 800; j++) {
+                int k = rand() % 1000;
+                batch.push_back(std::make_pair(k, (long long)j));
+                reference[k] = j;
+            }
+            rt.insert_batch(batch.begin(), batch.end());
+        }
+        int lo = rand() % 1000;
+        int hi = lo + rand() % 200;
+        ok = rt.aggregate(lo, hi) == referenceSum(reference, lo, hi) && rt.isBalanced();
+    }
+    ok = ok && rt.total() == referenceSum(reference, 0, 1000);
+    cout << "Randomized aggregates match: " << ok << endl;
+
+    // A copy taken with writes pending starts with correct summaries
+    rt.begin().mutableValue() += 5;
+    AggregateAVLTree<int, long long> snapshot(rt);
+    rt.begin().mutableValue() += 5;
+    cout << "Copy total trails original by 5: " << (rt.total() - snapshot.total() == 5) << endl;
+
+    // Writes pending while the nodes move are not lost
+    long long before = rt.total();
+    rt.beginCompactLayout();
+    rt.begin().mutableValue() += 7;
+    long long added = 7;
+    for(; !rt.stepCompactLayout(64); added++) rt[rt.begin()->first] += 1;
+    cout << "Relaid out total matches: " << (rt.total() == before + added) << endl;
+
+    // Summaries follow nodes moved between trees by handle and by merge
+    AggregateAVLTree<int, long long> from, to;
+    for(int i = 0; i < 100; i++) (i % 3 == 0 ? to : from).insert(std::make_pair(i, (long long)i));
+    from.begin().mutableValue() += 1000;
+    AVLTree<int, long long>::node_type handle = from.extract(from.find(50));
+    to.insert(std::move(handle));
+    cout << "After handle, totals: " << from.total() << " + " << to.total();
+    to.merge(from);
+    cout << ", after merge: " << from.total() << " + " << to.total() << " (aggregate 40..60: " << to.aggregate(40, 60)
+         << ")" << endl;
+
+    // Nodes only move between trees of the same type
+    AVLTree<int, long long> plain;
+    plain.insert(std::make_pair(1, 1LL));
+    try {
+        to.insert(plain.extract(1));
+        cout << "Foreign handle accepted" << endl;
+    }
+    catch(std::invalid_argument& e) {
+        cout << "Foreign handle rejected: " << e.what() << endl;
+    }
+
+    // Writes through a reference to the base class are seen too
+    AggregateAVLTree<int, long long> viaBase;
+    for(int i = 0; i < 10; i++) viaBase.insert(std::make_pair(i, 1LL));
+    BinarySearchTree<int, long long>& base = viaBase;
+    long long read = 0;
+    for(AggregateAVLTree<int, long long>::iterator it = viaBase.begin(); it != viaBase.end(); ++it) read += it->second;
+    base.begin()->second = 10;
+    BinarySearchTree<int, long long>::iterator copied = viaBase.find(5);
+    copied->second = 10;
+    base[9] = 10;
+    base.back().second += 5;
+    cout << "Read " << read << ", total after base writes: " << viaBase.total() << endl;
+
+    // Pending writes stay right when handles, merges and relayouts go through base references
+    AggregateAVLTree<int, long long> source, target;
+    for(int i = 0; i < 100; i++) {
+        source.insert(std::make_pair(i, 1LL));
+        target.insert(std::make_pair(i + 1000, 1LL));
+    }
+    AVLTree<int, long long>& baseSource = source;
+    AVLTree<int, long long>& baseTarget = target;
+    baseSource[7] = 100;
+    baseSource[8] = 100;
+    baseSource[50] = 100;
+    {
+        AVLTree<int, long long>::node_type dropped = baseSource.extract(7);
+    }
+    baseSource[60] = 100;
+    cout << "Base handle: " << source.total();
+    baseTarget[1050] = 100;
+    baseTarget.merge(source);
+    cout << ", base merge: " << source.total() << " + " << target.total();
+    baseTarget[1051] = 100;
+    static_cast<BinarySearchTree<int, long long>&>(target).compactLayout();
+    cout << ", after base relayout: " << target.total() << " (aggregate 0..99: " << target.aggregate(0, 99) << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,525 @@
+#ifndef AGGREGATE_AVLBST_H
+#define AGGREGATE_AVLBST_H
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "avlbst.h"
+
+/**
+ * Aggregate policies for AggregateAVLTree.
+ *
+ * A policy names its summary_type and provides identity(), lift(key, value)
+ * for a single item and an associative combine(left, right) over adjacent
+ * key ranges, i.e. a monoid over the items in key order. combine need not
+ * be commutative.
+ */
+template <typename Key, typename Value>
+struct SumAggregate
+{
+    typedef Value summary_type;
+    static summary_type identity() { return Value(); }
+    static summary_type lift(const Key&, const Value& value) { return value; }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return a + b; }
+};
+
+template <typename Key, typename Value>
+struct MinAggregate
+{
+    typedef Value summary_type;
+    static summary_type identity() { return std::numeric_limits<Value>::max(); }
+    static summary_type lift(const Key&, const Value& value) { return value; }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return b < a ? b : a; }
+};
+
+template <typename Key, typename Value>
+struct MaxAggregate
+{
+    typedef Value summary_type;
+    static summary_type identity() { return std::numeric_limits<Value>::lowest(); }
+    static summary_type lift(const Key&, const Value& value) { return value; }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return a < b ? b : a; }
+};
+
+template <typename Key, typename Value>
+struct CountAggregate
+{
+    typedef size_t summary_type;
+    static summary_type identity() { return 0; }
+    static summary_type lift(const Key&, const Value&) { return 1; }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return a + b; }
+};
+
+/**
+ * An AVLNode that also holds the aggregate of its whole subtree.
+ */
+template <typename Key, typename Value, typename Summary>
+class AggregateAVLNode : public AVLNode<Key, Value>
+{
+public:
+    AggregateAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent, const Summary& summary);
+    virtual ~AggregateAVLNode();
+
+    const Summary& getSummary() const;
+    void setSummary(const Summary& summary);
+    bool isDirty() const;
+    void setDirty(bool dirty);
+    virtual AggregateAVLNode<Key, Value, Summary>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
+protected:
+    Summary summary_;
+    bool dirty_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the AggregateAVLNode class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value, class Summary>
+AggregateAVLNode<Key, Value, Summary>::AggregateAVLNode(const Key& key, const Value& value,
+                                                        AVLNode<Key, Value>* parent, const Summary& summary) :
+    AVLNode<Key, Value>(key, value, parent), summary_(summary), dirty_(false)
+{
+}
+
+template<class Key, class Value, class Summary>
+AggregateAVLNode<Key, Value, Summary>::~AggregateAVLNode()
+{
+}
+
+template<class Key, class Value, class Summary>
+const Summary& AggregateAVLNode<Key, Value, Summary>::getSummary() const
+{
+    return summary_;
+}
+
+template<class Key, class Value, class Summary>
+void AggregateAVLNode<Key, Value, Summary>::setSummary(const Summary& summary)
+{
+    summary_ = summary;
+}
+
+template<class Key, class Value, class Summary>
+bool AggregateAVLNode<Key, Value, Summary>::isDirty() const
+{
+    return dirty_;
+}
+
+template<class Key, class Value, class Summary>
+void AggregateAVLNode<Key, Value, Summary>::setDirty(bool dirty)
+{
+    dirty_ = dirty;
+}
+
+template<class Key, class Value, class Summary>
+AggregateAVLNode<Key, Value, Summary>* AggregateAVLNode<Key, Value, Summary>::cloneAt(void* where) const
+{
+    return new (where) AggregateAVLNode<Key, Value, Summary>(*this);
+}
+
+template<class Key, class Value, class Summary>
+size_t AggregateAVLNode<Key, Value, Summary>::footprint() const
+{
+    return sizeof(*this);
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the AggregateAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+ * An AVLTree whose nodes keep Policy's aggregate of their subtree, kept up
+ * to date by the rotation, swap and retrace hooks of AVLTree, so that
+ * aggregate(lo, hi) folds any key range in O(log n).
+ *
+ * Values written through operator[], front(), back() or an iterator
+ * cannot be seen when they happen, so handing out a mutable reference
+ * marks the node as pending. Pending nodes have their root paths
+ * recomputed before the next aggregate(), remove() or pop, which costs
+ * O(log n) per node written. This tree's own iterators are read-only and
+ * mark only through mutableValue(), so scans leave nothing to recompute.
+ */
+template <typename Key, typename Value, typename Policy = SumAggregate<Key, Value> >
+class AggregateAVLTree : public AVLTree<Key, Value>
+{
+public:
+    typedef typename Policy::summary_type summary_type;
+
+    AggregateAVLTree();
+    AggregateAVLTree(const AggregateAVLTree& other);
+    AggregateAVLTree(AggregateAVLTree&& other) noexcept;
+    AggregateAVLTree& operator=(const AggregateAVLTree& other);
+    AggregateAVLTree& operator=(AggregateAVLTree&& other) noexcept;
+
+    virtual void clear();
+
+    // Combines the items with lo <= key <= hi, in key order.
+    summary_type aggregate(const Key& lo, const Key& hi) const;
+    // Combines every item in the tree.
+    summary_type total() const;
+
+    /**
+    * An iterator whose dereference is read-only and has no side effects.
+    * mutableValue() is the way to write, and marks the node as pending.
+    * Copied into a BinarySearchTree iterator it marks on every dereference
+    * instead, since there a write cannot be told from a read.
+    */
+    class iterator : public BinarySearchTree<Key, Value>::iterator
+    {
+    public:
+        iterator();
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+        Value& mutableValue() const;
+        iterator& operator++();
+    protected:
+        friend class AggregateAVLTree<Key, Value, Policy>;
+        iterator(const typename BinarySearchTree<Key, Value>::iterator& it);
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+
+protected:
+    typedef AggregateAVLNode<Key, Value, summary_type> AggNode;
+
+    // Small batches fall back to single inserts, which only retrace their
+    // own paths, so pending writes are folded in first.
+    virtual void insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads);
+    virtual void valueExposed(Node<Key, Value>* node) const;
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void updateNode(AVLNode<Key, Value>* node);
+    virtual void updatePath(AVLNode<Key, Value>* node);
+    virtual void eraseNode(Node<Key, Value>* node);
+    // Handles, merge and relayouts keep pending_ pointing at live nodes of
+    // this tree, whichever class they are called through.
+    virtual typename AVLTree<Key, Value>::node_type extractNode(AVLNode<Key, Value>* node);
+    virtual void adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+
+    // Helper functions
+    static summary_type summaryOf(Node<Key, Value>* node);
+    void markPending(Node<Key, Value>* node) const;
+    void refresh() const;
+
+protected:
+    mutable std::vector<AggNode*> pending_;
+};
+
+/*
+  --------------------------------------------------------------------
+  Begin implementations for the AggregateAVLTree::iterator class.
+  --------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>::iterator::iterator() :
+    BinarySearchTree<Key, Value>::iterator()
+{
+}
+
+/**
+* Takes an iterator from the tree's iteratorAt, which knows its tree.
+*/
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>::iterator::iterator(const typename BinarySearchTree<Key, Value>::iterator& it) :
+    BinarySearchTree<Key, Value>::iterator(it)
+{
+}
+
+template<class Key, class Value, class Policy>
+const std::pair<const Key, Value>& AggregateAVLTree<Key, Value, Policy>::iterator::operator*() const
+{
+    return this->current_->getItem();
+}
+
+template<class Key, class Value, class Policy>
+const std::pair<const Key, Value>* AggregateAVLTree<Key, Value, Policy>::iterator::operator->() const
+{
+    return &(this->current_->getItem());
+}
+
+template<class Key, class Value, class Policy>
+Value& AggregateAVLTree<Key, Value, Policy>::iterator::mutableValue() const
+{
+    static_cast<const AggregateAVLTree<Key, Value, Policy>*>(this->tree_)->markPending(this->current_);
+    return this->current_->getValue();
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::iterator& AggregateAVLTree<Key, Value, Policy>::iterator::operator++()
+{
+    BinarySearchTree<Key, Value>::iterator::operator++();
+    return *this;
+}
+
+/*
+  ------------------------------------------------------------------
+  End implementations for the AggregateAVLTree::iterator class.
+  ------------------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the AggregateAVLTree class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>::AggregateAVLTree()
+{
+    this->watchesWrites_ = true;
+}
+
+/**
+* Pending writes are folded in before copying, so that the copy starts
+* with correct summaries and no pending nodes.
+*/
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>::AggregateAVLTree(const AggregateAVLTree<Key, Value, Policy>& other) :
+    AVLTree<Key, Value>((other.refresh(), other))
+{
+    this->watchesWrites_ = true;
+}
+
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>::AggregateAVLTree(AggregateAVLTree<Key, Value, Policy>&& other) noexcept :
+    AVLTree<Key, Value>(std::move(other)), pending_(std::move(other.pending_))
+{
+    this->watchesWrites_ = true;
+    other.pending_.clear();
+}
+
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>& AggregateAVLTree<Key, Value, Policy>::operator=(const AggregateAVLTree<Key, Value, Policy>& other)
+{
+    if(this == &other) return *this;
+    other.refresh();
+    pending_.clear();
+    AVLTree<Key, Value>::operator=(other);
+    return *this;
+}
+
+template<class Key, class Value, class Policy>
+AggregateAVLTree<Key, Value, Policy>& AggregateAVLTree<Key, Value, Policy>::operator=(AggregateAVLTree<Key, Value, Policy>&& other) noexcept
+{
+    if(this == &other) return *this;
+    AVLTree<Key, Value>::operator=(std::move(other));
+    pending_ = std::move(other.pending_);
+    other.pending_.clear();
+    return *this;
+}
+
+/**
+* Brings pending summaries up to date first so none of them point at the
+* freed node.
+*/
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::eraseNode(Node<Key, Value>* node)
+{
+    refresh();
+    AVLTree<Key, Value>::eraseNode(node);
+}
+
+/**
+* A pending node is dropped from pending_ as it leaves; the retrace after
+* unlinking recomputes its old ancestors without it.
+*/
+template<class Key, class Value, class Policy>
+typename AVLTree<Key, Value>::node_type AggregateAVLTree<Key, Value, Policy>::extractNode(AVLNode<Key, Value>* node)
+{
+    AggNode* n = static_cast<AggNode*>(node);
+    if(n->isDirty()) {
+        pending_.erase(std::find(pending_.begin(), pending_.end(), n));
+        n->setDirty(false);
+    }
+    return AVLTree<Key, Value>::extractNode(node);
+}
+
+/**
+* Linking recomputes the whole new path from the node up, so it arrives
+* clean and later writes to it are marked again.
+*/
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    static_cast<AggNode*>(node)->setDirty(false);
+    AVLTree<Key, Value>::adoptNode(parent, asLeftChild, node);
+}
+
+/**
+* A copy keeps the dirty flag, so only pending nodes need looking up.
+*/
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    if(static_cast<AggNode*>(to)->isDirty())
+        std::replace(pending_.begin(), pending_.end(), static_cast<AggNode*>(from), static_cast<AggNode*>(to));
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads)
+{
+    refresh();
+    AVLTree<Key, Value>::insertItems(batch, threads);
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::clear()
+{
+    pending_.clear();
+    BinarySearchTree<Key, Value>::clear();
+}
+
+/**
+* Finds the highest node inside [lo, hi], then folds the in-range part of
+* its left subtree (walking towards lo) and of its right subtree (walking
+* towards hi), taking whole child summaries wherever a subtree lies
+* entirely in range. Touches O(log n) nodes.
+*/
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::summary_type
+AggregateAVLTree<Key, Value, Policy>::aggregate(const Key& lo, const Key& hi) const
+{
+    refresh();
+    Node<Key, Value>* split = this->root_;
+    while(split != NULL) {
+        if(split->getKey() < lo)      split = split->getRight();
+        else if(hi < split->getKey()) split = split->getLeft();
+        else break;
+    }
+    if(split == NULL) return Policy::identity();
+
+    summary_type left = Policy::identity();
+    for(Node<Key, Value>* n = split->getLeft(); n != NULL; ) {
+        if(n->getKey() < lo)
+            n = n->getRight();
+        else {
+            left = Policy::combine(Policy::combine(Policy::lift(n->getKey(), n->getValue()),
+                                                   summaryOf(n->getRight())), left);
+            n = n->getLeft();
+        }
+    }
+    summary_type right = Policy::identity();
+    for(Node<Key, Value>* n = split->getRight(); n != NULL; ) {
+        if(hi < n->getKey())
+            n = n->getLeft();
+        else {
+            right = Policy::combine(right, Policy::combine(summaryOf(n->getLeft()),
+                                                           Policy::lift(n->getKey(), n->getValue())));
+            n = n->getRight();
+        }
+    }
+    return Policy::combine(Policy::combine(left, Policy::lift(split->getKey(), split->getValue())), right);
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::summary_type AggregateAVLTree<Key, Value, Policy>::total() const
+{
+    refresh();
+    return summaryOf(this->root_);
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::iterator AggregateAVLTree<Key, Value, Policy>::begin() const
+{
+    return iterator(BinarySearchTree<Key, Value>::begin());
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::iterator AggregateAVLTree<Key, Value, Policy>::end() const
+{
+    return iterator(BinarySearchTree<Key, Value>::end());
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::iterator AggregateAVLTree<Key, Value, Policy>::find(const Key& key) const
+{
+    return iterator(BinarySearchTree<Key, Value>::find(key));
+}
+
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::iterator AggregateAVLTree<Key, Value, Policy>::lower_bound(const Key& key) const
+{
+    return iterator(BinarySearchTree<Key, Value>::lower_bound(key));
+}
+
+template<class Key, class Value, class Policy>
+AVLNode<Key, Value>* AggregateAVLTree<Key, Value, Policy>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AggNode(key, value, parent, Policy::lift(key, value));
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::updateNode(AVLNode<Key, Value>* node)
+{
+    static_cast<AggNode*>(node)->setSummary(
+        Policy::combine(Policy::combine(summaryOf(node->getLeft()), Policy::lift(node->getKey(), node->getValue())),
+                        summaryOf(node->getRight())));
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::updatePath(AVLNode<Key, Value>* node)
+{
+    for(; node != NULL; node = node->getParent())
+        updateNode(node);
+}
+
+/**
+* Helper function: summaryOf
+*
+* The summary of a possibly empty subtree.
+*/
+template<class Key, class Value, class Policy>
+typename AggregateAVLTree<Key, Value, Policy>::summary_type AggregateAVLTree<Key, Value, Policy>::summaryOf(Node<Key, Value>* node)
+{
+    if(node == NULL) return Policy::identity();
+    return static_cast<AggNode*>(node)->getSummary();
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::valueExposed(Node<Key, Value>* node) const
+{
+    markPending(node);
+}
+
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::markPending(Node<Key, Value>* node) const
+{
+    AggNode* n = static_cast<AggNode*>(node);
+    if(n->isDirty()) return;
+    n->setDirty(true);
+    pending_.push_back(n);
+}
+
+/**
+* Helper function: refresh
+*
+* Recomputes the root path of every node written since the last refresh.
+*/
+template<class Key, class Value, class Policy>
+void AggregateAVLTree<Key, Value, Policy>::refresh() const
+{
+    AggregateAVLTree<Key, Value, Policy>* self = const_cast<AggregateAVLTree<Key, Value, Policy>*>(this);
+    for(size_t i = 0; i < pending_.size(); i++) {
+        pending_[i]->setDirty(false);
+        self->updatePath(pending_[i]);
+    }
+    pending_.clear();
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the AggregateAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -6,6 +6,10 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+#include <thread>
 #include "bst.h"
 
 struct KeyError { };
@@ -32,6 +36,9 @@ public:
     virtual AVLNode<Key, Value>* getLeft() const override;
     virtual AVLNode<Key, Value>* getRight() const override;
 
+    virtual AVLNode<Key, Value>* cloneAt(void* where) const override;
+    virtual size_t footprint() const override;
+
 protected:
     int8_t balance_;    // effectively a signed char
 };
@@ -89,6 +96,18 @@ AVLNode<Key, Value>* AVLNode<Key, Value>::getRight() const
     return static_cast<AVLNode<Key, Value>*>(this->right_);
 }
 
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLNode<Key, Value>::cloneAt(void* where) const
+{
+    return new (where) AVLNode<Key, Value>(*this);
+}
+
+template<class Key, class Value>
+size_t AVLNode<Key, Value>::footprint() const
+{
+    return sizeof(*this);
+}
+
 /*
   -----------------------------------------------
   End implementations for the AVLNode class.
@@ -101,9 +120,93 @@ class AVLTree : public BinarySearchTree<Key, Value>
 public:
     virtual void insert (const std::pair<const Key, Value> &new_item); // Implemented below
     virtual void remove(const Key& key);  
+    // An AVL tree is always balanced, so this does nothing.
+    virtual void rebalance();
+
+    // Inserts every item of [first, last); later duplicates win, as with insert().
+    template<typename InputIterator>
+    void insert_batch(InputIterator first, InputIterator last, unsigned threads = 1);
+
+    /**
+    * Owns a node taken out of a tree, so that it can be linked into another
+    * tree of the same type without reallocating or copying its item.
+    */
+    class node_type
+    {
+    public:
+        node_type();
+        node_type(node_type&& other) noexcept;
+        node_type& operator=(node_type&& other) noexcept;
+        ~node_type();
+        bool empty() const;
+        explicit operator bool() const;
+        const Key& key() const;
+        Value& mapped() const;
+    protected:
+        friend class AVLTree<Key, Value>;
+        node_type(AVLNode<Key, Value>* node, const std::type_info* origin);
+        node_type(const node_type&);
+        node_type& operator=(const node_type&);
+        AVLNode<Key, Value>* node_;
+        const std::type_info* origin_;  // type of the tree the node came from
+    };
+
+    // Unlinks the item with key, or at pos, and hands over its node; the
+    // handle is empty if there is no such item.
+    node_type extract(const Key& key);
+    node_type extract(const typename BinarySearchTree<Key, Value>::iterator& pos);
+    // Links the handle's node into this tree and empties the handle. If the
+    // key is already present, returns false and leaves the handle as it was.
+    bool insert(node_type&& handle);
+    // Moves every node of other whose key is not in this tree, and any
+    // other node absorbNode takes; returns how many items moved.
+    size_t merge(AVLTree<Key, Value>& other);
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
+    // insert_batch copies its range into batch and hands it here, so trees
+    // with bookkeeping per item can replace the merge; batch may be reordered.
+    virtual void insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads);
+
+    // Allocates the node for a new item; overridden by trees whose nodes carry extra data.
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+
+    // Attaches a new item below parent (or as the root) and rebalances.
+    AVLNode<Key, Value>* linkNewNode(AVLNode<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& new_item);
+
+    // Unlinks and frees a node that is in the tree, then rebalances.
+    void removeNode(AVLNode<Key, Value>* node);
+    virtual void eraseNode(Node<Key, Value>* node);
+
+    virtual Node<Key, Value>* insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item);
+    virtual void assignValue(Node<Key, Value>* node, const Value& value);
+
+    // Returns the node holding key, or NULL with parent/asLeftChild set to
+    // where a node for key would be attached.
+    AVLNode<Key, Value>* findSlot(const Key& key, AVLNode<Key, Value>*& parent, bool& asLeftChild) const;
+    // Attaches an unlinked node below parent (or as the root) and rebalances.
+    void linkNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+    // Unlinks a node that is in the tree and rebalances, without freeing it.
+    void unlinkNode(AVLNode<Key, Value>* node);
+    // Every handle leaves through extractNode and comes back through
+    // adoptNode, so trees with counts per node can keep their totals.
+    virtual node_type extractNode(AVLNode<Key, Value>* node);
+    virtual void adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+    // Where an unlinked node would go: returns the node that keeps it out,
+    // or NULL with parent/asLeftChild set as in findSlot.
+    virtual AVLNode<Key, Value>* adoptSlot(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& parent, bool& asLeftChild);
+    // Lets merge fold a node of other into here, the node that keeps it
+    // out, instead of leaving it behind; merge then erases it from other.
+    // The default declines.
+    virtual bool absorbNode(AVLNode<Key, Value>* here, const AVLNode<Key, Value>* node);
+
+    // Augmentation hooks for trees whose nodes summarise their subtrees.
+    // updateNode recomputes one node from its children and is called after
+    // every structural change to it; updatePath does so from node up to the
+    // root after an insert or a value overwrite. Both do nothing here.
+    virtual void updateNode(AVLNode<Key, Value>* node);
+    virtual void updatePath(AVLNode<Key, Value>* node);
+
     // dhelper functions for rotations.
     void rotateLeft(AVLNode<Key, Value>* node);
     void rotateRight(AVLNode<Key, Value>* node);
@@ -111,69 +214,378 @@ protected:
     // Reblancing after insertion uses a delta‐based approach
     void rebalanceAfterInsert(AVLNode<Key, Value>* node);
 
-    // rebalancing after removal now implemented recursively
-    void rebalanceAfterRemove(AVLNode<Key, Value>* node);
+    // Retraces upward from a node whose left or right subtree got one
+    // level shorter.
+    void rebalanceAfterRemove(AVLNode<Key, Value>* node, bool leftShrank);
 
-    // helper to compute the height of a subtree
-    int height(AVLNode<Key, Value>* node);
+    // Links nodes[lo, hi), which are in key order, into a perfectly balanced
+    // subtree below parent and sets their balance factors. O(hi - lo).
+    AVLNode<Key, Value>* buildBalanced(const std::vector<AVLNode<Key, Value>*>& nodes,
+                                       size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& subtreeHeight);
+
+    // buildBalanced with the two halves of large ranges built on separate threads.
+    AVLNode<Key, Value>* buildBalancedParallel(const std::vector<AVLNode<Key, Value>*>& nodes,
+                                               size_t lo, size_t hi, AVLNode<Key, Value>* parent,
+                                               int& subtreeHeight, unsigned threads);
 };
 
 
+/*
+  -------------------------------------------------------
+  Begin implementations for the AVLTree::node_type class.
+  -------------------------------------------------------
+*/
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type() :
+    node_(NULL), origin_(NULL)
+{
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type(AVLNode<Key, Value>* node, const std::type_info* origin) :
+    node_(node), origin_(origin)
+{
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::node_type(node_type&& other) noexcept :
+    node_(other.node_), origin_(other.origin_)
+{
+    other.node_ = NULL;
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type& AVLTree<Key, Value>::node_type::operator=(node_type&& other) noexcept
+{
+    if (this == &other) return *this;
+    delete node_;
+    node_ = other.node_;
+    origin_ = other.origin_;
+    other.node_ = NULL;
+    return *this;
+}
+
+/*
+ * A node still held when the handle goes away is freed with it.
+ */
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::~node_type()
+{
+    delete node_;
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::node_type::empty() const
+{
+    return node_ == NULL;
+}
+
+template<class Key, class Value>
+AVLTree<Key, Value>::node_type::operator bool() const
+{
+    return node_ != NULL;
+}
+
+template<class Key, class Value>
+const Key& AVLTree<Key, Value>::node_type::key() const
+{
+    return node_->getKey();
+}
+
+template<class Key, class Value>
+Value& AVLTree<Key, Value>::node_type::mapped() const
+{
+    return node_->getValue();
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the AVLTree::node_type class.
+  -----------------------------------------------------
+*/
+
 template<class Key, class Value>
 void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
 {
-    if (this->root_ == NULL) {
-        this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, NULL);
+    AVLNode<Key, Value>* parent;
+    bool asLeftChild;
+    AVLNode<Key, Value>* current = findSlot(new_item.first, parent, asLeftChild);
+    if (current != NULL) {
+        // Key exists; update value.
+        current->setValue(new_item.second);
+        updatePath(current);
         return;
     }
+    linkNewNode(parent, asLeftChild, new_item);
+}
+
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::remove(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if (node == NULL) return;
+    eraseNode(node);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::rebalance()
+{
+    this->rebalanceDebt_ = 0;
+}
+
+template<class Key, class Value>
+template<typename InputIterator>
+void AVLTree<Key, Value>::insert_batch(InputIterator first, InputIterator last, unsigned threads)
+{
+    std::vector<std::pair<Key, Value> > batch(first, last);
+    if (!batch.empty())
+        insertItems(batch, threads);
+}
+
+/*
+ * AVLTree::insertItems
+ *
+ * Sorts the batch and, unless it is tiny next to the tree, merges it with
+ * an in-order walk of the existing nodes and relinks everything into a
+ * balanced tree in one O(n + m) pass instead of m descents and retraces.
+ * Existing nodes are reused; with threads > 1 the new nodes are allocated
+ * and the tree is relinked in parallel. If making a node throws, the nodes
+ * made so far are freed and the exception is rethrown here, with the tree
+ * still linked as it was; values already overwritten stay overwritten.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads)
+{
+    std::stable_sort(batch.begin(), batch.end(),
+                     [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+    size_t m = 0;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (m > 0 && !(batch[m - 1].first < batch[i].first))
+            batch[m - 1].second = batch[i].second;
+        else
+            batch[m++] = batch[i];
+    }
+    batch.erase(batch.begin() + m, batch.end());
+
+    // Merging touches all n nodes; for small batches m descents are cheaper.
+    size_t logN = 1;
+    while ((size_t(1) << logN) <= this->size_) logN++;
+    if (m * logN < this->size_) {
+        for (size_t i = 0; i < m; i++)
+            insert(std::make_pair(batch[i].first, batch[i].second));
+        return;
+    }
+
+    std::vector<AVLNode<Key, Value>*> merged;
+    std::vector<size_t> freshSlots, freshItems;
+    merged.reserve(this->size_ + m);
+    Node<Key, Value>* n = this->getSmallestNode();
+    size_t j = 0;
+    while (n != NULL || j < m) {
+        if (j == m || (n != NULL && n->getKey() < batch[j].first)) {
+            merged.push_back(static_cast<AVLNode<Key, Value>*>(n));
+            n = BinarySearchTree<Key, Value>::successor(n);
+        }
+        else if (n == NULL || batch[j].first < n->getKey()) {
+            freshSlots.push_back(merged.size());
+            freshItems.push_back(j++);
+            merged.push_back(NULL);
+        }
+        else {
+            n->setValue(batch[j++].second);
+            merged.push_back(static_cast<AVLNode<Key, Value>*>(n));
+            n = BinarySearchTree<Key, Value>::successor(n);
+        }
+    }
+
+    if (threads < 1) threads = 1;
+    // An exception leaving a thread ends the program, so each chunk keeps
+    // its own to be rethrown once every worker has joined.
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    size_t chunk = (freshSlots.size() + threads - 1) / threads;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t lo = t * chunk, hi = std::min(freshSlots.size(), lo + chunk);
+        if (lo >= hi) break;
+        auto allocate = [&, t, lo, hi]() {
+            try {
+                for (size_t i = lo; i < hi; i++) {
+                    const std::pair<Key, Value>& item = batch[freshItems[i]];
+                    merged[freshSlots[i]] = createNode(item.first, item.second, NULL);
+                }
+            }
+            catch (...) {
+                errors[t] = std::current_exception();
+            }
+        };
+        if (t + 1 == threads || hi == freshSlots.size()) allocate();
+        else workers.push_back(std::thread(allocate));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+    for (unsigned t = 0; t < threads; t++) {
+        if (!errors[t]) continue;
+        for (size_t i = 0; i < freshSlots.size(); i++)
+            delete merged[freshSlots[i]];
+        std::rethrow_exception(errors[t]);
+    }
+    if (this->filter_ != NULL) {
+        for (size_t i = 0; i < freshItems.size(); i++)
+            this->filter_->add(batch[freshItems[i]].first);
+    }
+
+    int h;
+    this->root_ = buildBalancedParallel(merged, 0, merged.size(), NULL, h, threads);
+    this->size_ = merged.size();
+    this->findExtremes();
+    this->arrivals_++;
+}
+
+/*
+ * AVLTree::createNode
+ *
+ * Allocates a plain AVLNode. Every node of the tree is made here.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new AVLNode<Key, Value>(key, value, parent);
+}
+
+/*
+ * AVLTree::linkNewNode
+ *
+ * Creates the node for new_item as the left or right child of parent, or as
+ * the root when parent is NULL, and retraces the balance factors upward.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::linkNewNode(AVLNode<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& new_item)
+{
+    AVLNode<Key, Value>* newNode = createNode(new_item.first, new_item.second, parent);
+    linkNode(parent, asLeftChild, newNode);
+    return newNode;
+}
+
+/*
+ * AVLTree::insertAt / assignValue
+ *
+ * The same as an insert that ended at parent, or found node.
+ */
+template<class Key, class Value>
+Node<Key, Value>* AVLTree<Key, Value>::insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item)
+{
+    return linkNewNode(static_cast<AVLNode<Key, Value>*>(parent), asLeftChild, item);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::assignValue(Node<Key, Value>* node, const Value& value)
+{
+    node->setValue(value);
+    updatePath(static_cast<AVLNode<Key, Value>*>(node));
+}
+
+/*
+ * AVLTree::linkNode
+ *
+ * Attaches a node with no links of its own as the left or right child of
+ * parent, or as the root when parent is NULL, and retraces the balance
+ * factors upward.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::linkNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    node->setParent(parent);
+    if (parent == NULL)
+         this->root_ = node;
+    else if (asLeftChild)
+         parent->setLeft(node);
+    else
+         parent->setRight(node);
+    this->noteLinked(node);
+    this->size_++;
+    this->arrivals_++;
+    if (this->filter_ != NULL) this->filter_->add(node->getKey());
     
-    AVLNode<Key, Value>* parent = NULL;
+    rebalanceAfterInsert(node);
+    updatePath(node);
+}
+
+/*
+ * AVLTree::findSlot
+ *
+ * Plain descent by key from the root.
+ */
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::findSlot(const Key& key, AVLNode<Key, Value>*& parent, bool& asLeftChild) const
+{
+    parent = NULL;
+    asLeftChild = false;
     AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
     while (current != NULL) {
-        parent = current;
-        if (new_item.first < current->getKey())
+        if (key < current->getKey()) {
+            parent = current;
             current = current->getLeft();
-        else if (new_item.first > current->getKey())
+            asLeftChild = true;
+        }
+        else if (key > current->getKey()) {
+            parent = current;
             current = current->getRight();
-        else {
-            // Key exists; update value.
-            current->setValue(new_item.second);
-            return;
+            asLeftChild = false;
         }
+        else
+            return current;
     }
-    
-    AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-    if (new_item.first < parent->getKey())
-         parent->setLeft(newNode);
-    else
-         parent->setRight(newNode);
-    
-    rebalanceAfterInsert(newNode);
+    return NULL;
 }
 
+template<class Key, class Value>
+void AVLTree<Key, Value>::updateNode(AVLNode<Key, Value>*)
+{
+}
 
 template<class Key, class Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+void AVLTree<Key, Value>::updatePath(AVLNode<Key, Value>*)
 {
-    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
-    if (node == NULL) return;
-    
+}
+
+/*
+ * AVLTree::removeNode
+ *
+ * Removes a node that is known to be in the tree.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::removeNode(AVLNode<Key, Value>* node)
+{
+    unlinkNode(node);
+    this->destroyNode(node);
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    removeNode(static_cast<AVLNode<Key, Value>*>(node));
+}
+
+/*
+ * AVLTree::unlinkNode
+ *
+ * Takes a node that is known to be in the tree out of it and rebalances.
+ * The node keeps its stale links.
+ */
+template<class Key, class Value>
+void AVLTree<Key, Value>::unlinkNode(AVLNode<Key, Value>* node)
+{
+    if (this->filter_ != NULL) this->filter_->remove(node->getKey());
+    this->noteUnlinking(node);
+
+    // If the node has two children, swap with its predecessor.
+    if (node->getLeft() != NULL && node->getRight() != NULL)
+         nodeSwap(node, static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::predecessor(node)));
     AVLNode<Key, Value>* parent = node->getParent();
     bool isLeftChild = (parent != NULL && parent->getLeft() == node);
     
-    // If the node has two children, swap with its predecessor.
-    if (node->getLeft() != NULL && node->getRight() != NULL) {
-         AVLNode<Key, Value>* pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key,Value>::predecessor(node));
-         if (node->getLeft() == pred) {
-             // Direct left child: perform a right rotation.
-             rotateRight(node);
-         } else {
-             nodeSwap(node, pred);
-         }
-         parent = node->getParent();
-         isLeftChild = (parent != NULL && parent->getLeft() == node);
-    }
-    
     // Node now has at most one child.
     AVLNode<Key, Value>* child = (node->getLeft() != NULL) ?
           static_cast<AVLNode<Key, Value>*>(node->getLeft()) :
@@ -189,11 +601,123 @@ void AVLTree<Key, Value>::remove(const Key& key)
          else
              parent->setRight(child);
     }
-    
-    delete node;
+    this->size_--;
     
     if (parent != NULL)
-         rebalanceAfterRemove(parent);
+         rebalanceAfterRemove(parent, isLeftChild);
+}
+
+/*
+ * AVLTree::extract
+ *
+ * Unlinks the node without freeing it. A relayout in progress is abandoned,
+ * as it may have planned to move the node.
+ */
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extract(const Key& key)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    if (node == NULL) return node_type();
+    return extractNode(node);
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extract(const typename BinarySearchTree<Key, Value>::iterator& pos)
+{
+    AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::nodeOf(pos));
+    if (node == NULL) return node_type();
+    return extractNode(node);
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type AVLTree<Key, Value>::extractNode(AVLNode<Key, Value>* node)
+{
+    if (this->layoutSlab_ != NULL) this->cancelCompactLayout();
+    this->departures_++;
+    if (this->hotCache_ != NULL) this->hotCache_->forget(node);
+    unlinkNode(node);
+    node = static_cast<AVLNode<Key, Value>*>(this->detachFromSlab(node));
+    node->setParent(NULL);
+    node->setLeft(NULL);
+    node->setRight(NULL);
+    node->setBalance(0);
+    return node_type(node, &typeid(*this));
+}
+
+template<class Key, class Value>
+void AVLTree<Key, Value>::adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    linkNode(parent, asLeftChild, node);
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::adoptSlot(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& parent, bool& asLeftChild)
+{
+    return findSlot(node->getKey(), parent, asLeftChild);
+}
+
+template<class Key, class Value>
+bool AVLTree<Key, Value>::absorbNode(AVLNode<Key, Value>*, const AVLNode<Key, Value>*)
+{
+    return false;
+}
+
+/*
+ * AVLTree::insert(node_type&&)
+ *
+ * Only nodes from a tree of exactly this type are accepted, since another
+ * tree may make its nodes with extra data.
+ */
+template<class Key, class Value>
+bool AVLTree<Key, Value>::insert(node_type&& handle)
+{
+    if (handle.node_ == NULL) return false;
+    if (*handle.origin_ != typeid(*this))
+        throw std::invalid_argument("node handle from a different type of tree");
+    AVLNode<Key, Value>* parent;
+    bool asLeftChild;
+    if (adoptSlot(handle.node_, parent, asLeftChild) != NULL) return false;
+    adoptNode(parent, asLeftChild, handle.node_);
+    handle.node_ = NULL;
+    return true;
+}
+
+/*
+ * AVLTree::merge
+ *
+ * Walks other in order, moving each node whose key is missing here and
+ * erasing each one absorbNode folds into a node here. Unlinking or
+ * erasing a node never frees its successor, so the walk can continue
+ * from it.
+ */
+template<class Key, class Value>
+size_t AVLTree<Key, Value>::merge(AVLTree<Key, Value>& other)
+{
+    if (&other == this) return 0;
+    if (typeid(other) != typeid(*this))
+        throw std::invalid_argument("merge from a different type of tree");
+    size_t moved = 0;
+    Node<Key, Value>* n = other.getSmallestNode();
+    while (n != NULL) {
+        Node<Key, Value>* next = BinarySearchTree<Key, Value>::successor(n);
+        AVLNode<Key, Value>* node = static_cast<AVLNode<Key, Value>*>(n);
+        AVLNode<Key, Value>* parent;
+        bool asLeftChild;
+        size_t copies = other.copiesAt(node);
+        AVLNode<Key, Value>* here = adoptSlot(node, parent, asLeftChild);
+        if (here == NULL) {
+            node_type handle = other.extractNode(node);
+            adoptNode(parent, asLeftChild, handle.node_);
+            handle.node_ = NULL;
+            moved += copies;
+        }
+        else if (here != node && absorbNode(here, node)) {
+            other.eraseNode(node);
+            moved += copies;
+        }
+        n = next;
+    }
+    return moved;
 }
 
 /*
@@ -209,6 +733,11 @@ void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    // Children first, in case the swap left one directly above the other.
+    AVLNode<Key, Value>* upper = (n1->getParent() == n2) ? n2 : n1;
+    AVLNode<Key, Value>* lower = (upper == n1) ? n2 : n1;
+    updateNode(lower);
+    updateNode(upper);
 }
 
 /*
@@ -236,6 +765,8 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node)
     int8_t rBalance = r->getBalance();
     node->setBalance(node->getBalance() - 1 - std::max(rBalance, (int8_t)0));
     r->setBalance(rBalance - 1 + std::min(node->getBalance(), (int8_t)0));
+    updateNode(node);
+    updateNode(r);
 }
 
 /*
@@ -263,6 +794,8 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node)
     int8_t lBalance = l->getBalance();
     node->setBalance(node->getBalance() + 1 - std::min(lBalance, (int8_t)0));
     l->setBalance(lBalance + 1 + std::max(node->getBalance(), (int8_t)0));
+    updateNode(node);
+    updateNode(l);
 }
 
 /*
@@ -311,50 +844,100 @@ void AVLTree<Key, Value>::rebalanceAfterInsert(AVLNode<Key, Value>* node)
 }
 
 /*
- * Helper function: height
+ * Helper function: buildBalanced
  *
- * Recursively computes the height of the subtree rooted at 'node'. An empty subtree has height 0.
+ * The middle node becomes the subtree root and the halves are built
+ * recursively. Half sizes differ by at most one, so the heights do too.
  */
 template<class Key, class Value>
-int AVLTree<Key, Value>::height(AVLNode<Key, Value>* node)
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildBalanced(const std::vector<AVLNode<Key, Value>*>& nodes,
+                                                        size_t lo, size_t hi, AVLNode<Key, Value>* parent, int& subtreeHeight)
 {
-    if (node == NULL) return 0;
-    return std::max(height(node->getLeft()), height(node->getRight())) + 1;
+    if (lo >= hi) {
+        subtreeHeight = 0;
+        return NULL;
+    }
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* node = nodes[mid];
+    int leftH, rightH;
+    node->setParent(parent);
+    node->setLeft(buildBalanced(nodes, lo, mid, node, leftH));
+    node->setRight(buildBalanced(nodes, mid + 1, hi, node, rightH));
+    node->setBalance(rightH - leftH);
+    updateNode(node);
+    subtreeHeight = std::max(leftH, rightH) + 1;
+    return node;
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* AVLTree<Key, Value>::buildBalancedParallel(const std::vector<AVLNode<Key, Value>*>& nodes,
+                                                                size_t lo, size_t hi, AVLNode<Key, Value>* parent,
+                                                                int& subtreeHeight, unsigned threads)
+{
+    if (threads <= 1 || hi - lo < 65536)
+        return buildBalanced(nodes, lo, hi, parent, subtreeHeight);
+    size_t mid = lo + (hi - lo) / 2;
+    AVLNode<Key, Value>* node = nodes[mid];
+    AVLNode<Key, Value>* left;
+    int leftH, rightH;
+    std::thread leftWorker([&]() {
+        left = buildBalancedParallel(nodes, lo, mid, node, leftH, threads / 2);
+    });
+    node->setRight(buildBalancedParallel(nodes, mid + 1, hi, node, rightH, threads - threads / 2));
+    leftWorker.join();
+    node->setLeft(left);
+    node->setParent(parent);
+    node->setBalance(rightH - leftH);
+    updateNode(node);
+    subtreeHeight = std::max(leftH, rightH) + 1;
+    return node;
 }
 
 /*
  * Helper function: rebalanceAfterRemove
  *
- * Recursively rebalances the tree from the given node upward.
- * At each node, we recompute the height of its left and right subtrees,
- * set its balance factor, and if the node is unbalanced, perform the appropriate rotations.
+ * The mirror of rebalanceAfterInsert, driven by balance factors alone.
+ * Each step adjusts one node for the side that shrank. A node left at
+ * +-1 kept its height, so the walk stops; one left at 0 got shorter, so
+ * the walk goes on to its parent. A node at +-2 is rotated, and the
+ * rotated subtree got shorter unless the taller child was balanced.
+ * Nodes the walk no longer reaches keep their shape; updatePath refreshes
+ * any summaries above it.
  */
 template<class Key, class Value>
-void AVLTree<Key, Value>::rebalanceAfterRemove(AVLNode<Key, Value>* node)
+void AVLTree<Key, Value>::rebalanceAfterRemove(AVLNode<Key, Value>* node, bool leftShrank)
 {
-    if (node == NULL) return;
-    
-    int leftH = (node->getLeft() ? height(node->getLeft()) : 0);
-    int rightH = (node->getRight() ? height(node->getRight()) : 0);
-    node->setBalance(rightH - leftH);
-    
-    if (node->getBalance() == 2) {
-         AVLNode<Key, Value>* r = node->getRight();
-         int rLeftH = (r->getLeft() ? height(r->getLeft()) : 0);
-         int rRightH = (r->getRight() ? height(r->getRight()) : 0);
-         if (rLeftH > rRightH)
-             rotateRight(r);
-         rotateLeft(node);
-    } else if (node->getBalance() == -2) {
-         AVLNode<Key, Value>* l = node->getLeft();
-         int lLeftH = (l->getLeft() ? height(l->getLeft()) : 0);
-         int lRightH = (l->getRight() ? height(l->getRight()) : 0);
-         if (lRightH > lLeftH)
-             rotateLeft(l);
-         rotateRight(node);
+    while (node != NULL) {
+        AVLNode<Key, Value>* parent = node->getParent();
+        bool isLeftChild = (parent != NULL && parent->getLeft() == node);
+        node->updateBalance(leftShrank ? 1 : -1);
+        int8_t balance = node->getBalance();
+        bool shorter = true;
+        if (balance == 2) {
+            AVLNode<Key, Value>* r = node->getRight();
+            int8_t rBalance = r->getBalance();
+            if (rBalance < 0)
+                rotateRight(r);
+            rotateLeft(node);
+            shorter = (rBalance != 0);
+        } else if (balance == -2) {
+            AVLNode<Key, Value>* l = node->getLeft();
+            int8_t lBalance = l->getBalance();
+            if (lBalance > 0)
+                rotateLeft(l);
+            rotateRight(node);
+            shorter = (lBalance != 0);
+        } else {
+            updateNode(node);
+            shorter = (balance == 0);
+        }
+        if (!shorter) {
+            if (parent != NULL) updatePath(parent);
+            return;
+        }
+        node = parent;
+        leftShrank = isLeftChild;
     }
-    // Recurse upward.
-    rebalanceAfterRemove(node->getParent());
 }
 
 #endif
@@ -0,0 +1,219 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+#include <vector>
+
+/**
+ * The filter's default hash: std::hash where the key type has one and a
+ * constant otherwise. A constant hash keeps the filter correct but lets
+ * every lookup through; it only exists so that trees over such keys still
+ * compile. Specialize std::hash for a key type to make its filter useful.
+ */
+template <typename Key, typename Enable = void>
+struct BloomHash
+{
+    size_t operator()(const Key&) const { return 0; }
+};
+
+template <typename Key>
+struct BloomHash<Key, decltype(void(std::hash<Key>()(std::declval<const Key&>())))> : public std::hash<Key>
+{
+};
+
+/**
+ * A blocked counting Bloom filter.
+ *
+ * Every key hashes to one 64-byte block (a single cache line) and sets
+ * numProbes 4-bit counters inside it, so a membership test costs one cache
+ * miss. Counters (rather than bits) let keys be removed again. A counter
+ * that reaches 15 saturates and is never decremented afterwards, which can
+ * only cause extra false positives, never false negatives.
+ */
+template <typename Key, typename Hash = BloomHash<Key> >
+class CountingBloomFilter
+{
+public:
+    CountingBloomFilter(size_t expectedItems, double falsePositiveRate);
+
+    void add(const Key& key);
+    void remove(const Key& key);
+    bool mayContain(const Key& key) const;
+    void clear();
+
+    size_t memoryUsage() const;
+    unsigned numProbes() const;
+
+protected:
+    static const unsigned COUNTERS_PER_BLOCK = 128;    // 64 bytes of 4-bit counters
+    static const uint8_t MAX_COUNT = 15;
+
+    // Helper functions
+    static uint64_t mix(uint64_t h);
+    uint8_t* blockFor(uint64_t h) const;
+    static unsigned probe(uint64_t h, unsigned i);
+    static uint8_t getCounter(const uint8_t* block, unsigned idx);
+    static void setCounter(uint8_t* block, unsigned idx, uint8_t count);
+
+protected:
+    std::vector<uint64_t> storage_;     // uint64_t keeps blocks 8-byte aligned
+    size_t numBlocks_;
+    unsigned numProbes_;
+    Hash hash_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the CountingBloomFilter class.
+  ------------------------------------------------------
+*/
+
+/**
+* Sizes the filter with the classic m = -n ln(p) / ln(2)^2 counters and
+* k = (m/n) ln(2) probes for n expected items and false positive rate p.
+*/
+template <typename Key, typename Hash>
+CountingBloomFilter<Key, Hash>::CountingBloomFilter(size_t expectedItems, double falsePositiveRate)
+{
+    if(expectedItems == 0) expectedItems = 1;
+    if(falsePositiveRate <= 0.0 || falsePositiveRate >= 1.0) falsePositiveRate = 0.01;
+    double ln2 = std::log(2.0);
+    double counters = -(double)expectedItems * std::log(falsePositiveRate) / (ln2 * ln2);
+    numBlocks_ = (size_t)std::ceil(counters / COUNTERS_PER_BLOCK);
+    if(numBlocks_ == 0) numBlocks_ = 1;
+    double probes = std::round(counters / expectedItems * ln2);
+    numProbes_ = (unsigned)std::max(1.0, std::min(probes, 16.0));
+    storage_.assign(numBlocks_ * 8, 0);
+}
+
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::add(const Key& key)
+{
+    uint64_t h = mix(hash_(key));
+    uint8_t* block = blockFor(h);
+    for(unsigned i = 0; i < numProbes_; i++) {
+        unsigned idx = probe(h, i);
+        uint8_t count = getCounter(block, idx);
+        if(count < MAX_COUNT)
+            setCounter(block, idx, count + 1);
+    }
+}
+
+/**
+* Removes one occurrence of key.
+* @precondition key was previously added and not yet removed
+*/
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::remove(const Key& key)
+{
+    uint64_t h = mix(hash_(key));
+    uint8_t* block = blockFor(h);
+    for(unsigned i = 0; i < numProbes_; i++) {
+        unsigned idx = probe(h, i);
+        uint8_t count = getCounter(block, idx);
+        if(count > 0 && count < MAX_COUNT)
+            setCounter(block, idx, count - 1);
+    }
+}
+
+/**
+* Returns false only if key is definitely not in the set.
+*/
+template <typename Key, typename Hash>
+bool CountingBloomFilter<Key, Hash>::mayContain(const Key& key) const
+{
+    uint64_t h = mix(hash_(key));
+    const uint8_t* block = blockFor(h);
+    for(unsigned i = 0; i < numProbes_; i++) {
+        if(getCounter(block, probe(h, i)) == 0)
+            return false;
+    }
+    return true;
+}
+
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::clear()
+{
+    std::fill(storage_.begin(), storage_.end(), 0);
+}
+
+template <typename Key, typename Hash>
+size_t CountingBloomFilter<Key, Hash>::memoryUsage() const
+{
+    return storage_.size() * sizeof(uint64_t);
+}
+
+template <typename Key, typename Hash>
+unsigned CountingBloomFilter<Key, Hash>::numProbes() const
+{
+    return numProbes_;
+}
+
+/**
+* Helper function: mix
+*
+* 64-bit finalizer from MurmurHash3. std::hash is the identity for
+* integers, which would put consecutive keys in consecutive blocks.
+*/
+template <typename Key, typename Hash>
+uint64_t CountingBloomFilter<Key, Hash>::mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+* Helper function: blockFor
+*
+* Picks a block from the high half of the hash (the low half feeds probe).
+*/
+template <typename Key, typename Hash>
+uint8_t* CountingBloomFilter<Key, Hash>::blockFor(uint64_t h) const
+{
+    size_t block = (size_t)(((h >> 32) * (uint64_t)numBlocks_) >> 32);
+    return (uint8_t*)(storage_.data() + block * 8);
+}
+
+/**
+* Helper function: probe
+*
+* Double hashing inside the block; the step is odd so that the probes
+* of one key are distinct.
+*/
+template <typename Key, typename Hash>
+unsigned CountingBloomFilter<Key, Hash>::probe(uint64_t h, unsigned i)
+{
+    unsigned h1 = (unsigned)(h & 0xffff);
+    unsigned h2 = (unsigned)((h >> 16) & 0xffff) | 1;
+    return (h1 + i * h2) % COUNTERS_PER_BLOCK;
+}
+
+template <typename Key, typename Hash>
+uint8_t CountingBloomFilter<Key, Hash>::getCounter(const uint8_t* block, unsigned idx)
+{
+    return (block[idx >> 1] >> ((idx & 1) * 4)) & 0xf;
+}
+
+template <typename Key, typename Hash>
+void CountingBloomFilter<Key, Hash>::setCounter(uint8_t* block, unsigned idx, uint8_t count)
+{
+    unsigned shift = (idx & 1) * 4;
+    block[idx >> 1] = (uint8_t)((block[idx >> 1] & ~(0xf << shift)) | (count << shift));
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the CountingBloomFilter class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,82 @@
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include "bplustree.h"
+
+using namespace std;
+
+
+// Compares the tree against a std::map, item by item in order
+template<typename Tree>
+bool sameContents(const Tree& tree, const map<int,int>& reference)
+{
+    map<int,int>::const_iterator ref = reference.begin();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++ref) {
+        if(ref == reference.end() || it->first != ref->first || it->second != ref->second)
+            return false;
+    }
+    return ref == reference.end() && tree.size() == reference.size();
+}
+
+int main(int argc, char *argv[])
+{
+    BPlusTree<int,int> bt;
+    bt.insert(std::make_pair(2,20));
+    bt.insert(std::make_pair(1,10));
+    cout << "B+ tree contents:" << endl;
+    for(BPlusTree<int,int>::iterator it = bt.begin(); it != bt.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    bt[2] = 21;
+    cout << "bt[2] = " << bt[2] << endl;
+    bt.remove(1);
+    cout << "Found 1 after removal: " << (bt.find(1) != bt.end()) << endl;
+
+    // Randomized inserts and removes against std::map, small nodes so the
+    // tree gets several levels deep
+    BPlusTree<int,int,64> small;
+    BPlusTree<long long,int> wide;
+    map<int,int> reference;
+    srand(104);
+    bool ok = true;
+    for(int i = 0; i < 20000; i++) {
+        int key = rand() % 3000;
+        if(rand() % 3 == 0) {
+            small.remove(key);
+            wide.remove(key);
+            reference.erase(key);
+        }
+        else {
+            small.insert(std::make_pair(key, i));
+            wide.insert(std::make_pair((long long)key, i));
+            reference[key] = i;
+        }
+        if(i % 1000 == 0 && !sameContents(small, reference)) ok = false;
+    }
+    cout << "Randomized contents match: " << (ok && sameContents(small, reference)) << endl;
+    cout << "Small-node tree height: " << small.height() << endl;
+
+    // Copies are independent; a moved-from tree is empty
+    BPlusTree<int,int,64> copy(small);
+    copy.remove(reference.begin()->first);
+    copy.insert(std::make_pair(-1, -1));
+    BPlusTree<int,int,64> moved(std::move(copy));
+    copy = moved;
+    cout << "Copy leaves the original alone: " << sameContents(small, reference) << endl;
+    size_t walked = 0;
+    for(BPlusTree<int,int,64>::iterator it = copy.begin(); it != copy.end(); ++it) walked++;
+    cout << "Copy and move keep their items: " << (walked == reference.size() && moved.begin()->first == -1) << endl;
+
+    int found = 0;
+    for(int key = 0; key < 3000; key++) {
+        if((wide.find(key) != wide.end()) == (reference.count(key) == 1)) found++;
+    }
+    cout << "64-bit key lookups matching: " << found << " of 3000" << endl;
+
+    while(!reference.empty()) {
+        small.remove(reference.begin()->first);
+        reference.erase(reference.begin());
+    }
+    cout << "Empty after removing all: " << small.empty() << endl;
+    return 0;
+}
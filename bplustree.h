@@ -0,0 +1,797 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <iostream>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * In-node search for the B+-tree.
+ *
+ * Both functions return how many of the n sorted keys are less than
+ * (less than or equal to) key. The generic version binary searches; signed
+ * 32- and 64-bit integers get vectorized versions below that compare a
+ * whole register of keys per instruction.
+ */
+template <typename Key, typename Enable = void>
+struct BPlusKeySearch
+{
+    static unsigned countLess(const Key* keys, unsigned n, const Key& key)
+    {
+        return (unsigned)(std::lower_bound(keys, keys + n, key) - keys);
+    }
+    static unsigned countLessEqual(const Key* keys, unsigned n, const Key& key)
+    {
+        return (unsigned)(std::upper_bound(keys, keys + n, key) - keys);
+    }
+};
+
+template <typename Key>
+struct BPlusKeySearch<Key, typename std::enable_if<std::is_integral<Key>::value &&
+                                                   std::is_signed<Key>::value &&
+                                                   sizeof(Key) == 4>::type>
+{
+    static unsigned countLess(const Key* keys, unsigned n, Key key)
+    {
+        unsigned count = 0, i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi32(key);
+        for(; i + 8 <= n; i += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)));
+            count += __builtin_popcount(mask);
+            if(mask != 0xff) return count;
+        }
+#elif defined(__SSE2__)
+        __m128i k = _mm_set1_epi32(key);
+        for(; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+            unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v)));
+            count += __builtin_popcount(mask);
+            if(mask != 0xf) return count;
+        }
+#endif
+        for(; i < n; i++) count += (keys[i] < key);
+        return count;
+    }
+    static unsigned countLessEqual(const Key* keys, unsigned n, Key key)
+    {
+        unsigned count = 0, i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi32(key);
+        for(; i + 8 <= n; i += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, k)));
+            count += 8 - __builtin_popcount(mask);
+            if(mask != 0) return count;
+        }
+#elif defined(__SSE2__)
+        __m128i k = _mm_set1_epi32(key);
+        for(; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+            unsigned mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, k)));
+            count += 4 - __builtin_popcount(mask);
+            if(mask != 0) return count;
+        }
+#endif
+        for(; i < n; i++) count += !(key < keys[i]);
+        return count;
+    }
+};
+
+template <typename Key>
+struct BPlusKeySearch<Key, typename std::enable_if<std::is_integral<Key>::value &&
+                                                   std::is_signed<Key>::value &&
+                                                   sizeof(Key) == 8>::type>
+{
+    static unsigned countLess(const Key* keys, unsigned n, Key key)
+    {
+        unsigned count = 0, i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi64x(key);
+        for(; i + 4 <= n; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)));
+            count += __builtin_popcount(mask);
+            if(mask != 0xf) return count;
+        }
+#elif defined(__SSE4_2__)
+        __m128i k = _mm_set1_epi64x(key);
+        for(; i + 2 <= n; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+            unsigned mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v)));
+            count += __builtin_popcount(mask);
+            if(mask != 0x3) return count;
+        }
+#endif
+        for(; i < n; i++) count += (keys[i] < key);
+        return count;
+    }
+    static unsigned countLessEqual(const Key* keys, unsigned n, Key key)
+    {
+        unsigned count = 0, i = 0;
+#if defined(__AVX2__)
+        __m256i k = _mm256_set1_epi64x(key);
+        for(; i + 4 <= n; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(keys + i));
+            unsigned mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(v, k)));
+            count += 4 - __builtin_popcount(mask);
+            if(mask != 0) return count;
+        }
+#elif defined(__SSE4_2__)
+        __m128i k = _mm_set1_epi64x(key);
+        for(; i + 2 <= n; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(keys + i));
+            unsigned mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(v, k)));
+            count += 2 - __builtin_popcount(mask);
+            if(mask != 0) return count;
+        }
+#endif
+        for(; i < n; i++) count += !(key < keys[i]);
+        return count;
+    }
+};
+
+/**
+ * A B+-tree map with fat nodes of roughly NodeBytes bytes.
+ *
+ * Inner nodes hold only separator keys and child pointers; all items live
+ * in the leaves, which are doubly linked so that iteration is a walk along
+ * contiguous arrays. Keys of a node are stored contiguously so that
+ * BPlusKeySearch can compare several of them per instruction.
+ *
+ * Exposes the same insert/remove/find/iterator/operator[] surface as
+ * BinarySearchTree. Since keys and values are stored in separate arrays the
+ * iterator yields a std::pair of references rather than a reference to a
+ * std::pair; it->first and it->second work as usual.
+ */
+template <typename Key, typename Value, size_t NodeBytes = 256>
+class BPlusTree
+{
+protected:
+    struct NodeBase {
+        bool leaf;
+        unsigned count;     // number of keys
+    };
+
+public:
+    static const unsigned LEAF_CAPACITY =
+        (NodeBytes - sizeof(NodeBase) - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(Value)) > 4 ?
+        (NodeBytes - sizeof(NodeBase) - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(Value)) : 4;
+    static const unsigned INNER_CAPACITY =
+        (NodeBytes - sizeof(NodeBase) - sizeof(void*)) / (sizeof(Key) + sizeof(void*)) > 4 ?
+        (NodeBytes - sizeof(NodeBase) - sizeof(void*)) / (sizeof(Key) + sizeof(void*)) : 4;
+
+protected:
+    struct Leaf : public NodeBase {
+        Key keys[LEAF_CAPACITY];
+        Value values[LEAF_CAPACITY];
+        Leaf* prev;
+        Leaf* next;
+    };
+    struct Inner : public NodeBase {
+        Key keys[INNER_CAPACITY];                   // keys[i] is the smallest key under children[i+1]
+        NodeBase* children[INNER_CAPACITY + 1];
+    };
+    typedef BPlusKeySearch<Key> Search;
+
+public:
+    BPlusTree();
+    BPlusTree(const BPlusTree& other);
+    BPlusTree(BPlusTree&& other) noexcept;
+    BPlusTree& operator=(const BPlusTree& other);
+    BPlusTree& operator=(BPlusTree&& other) noexcept;
+    ~BPlusTree();
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    size_t size() const;
+    size_t height() const;
+
+    /**
+    * An iterator over the items in key order.
+    */
+    class iterator
+    {
+    public:
+        typedef std::pair<const Key&, Value&> reference;
+
+        /**
+        * Holds the pair of references so operator-> has something to point at.
+        */
+        class pointer
+        {
+        public:
+            pointer(const reference& ref) : ref_(ref) { }
+            const reference* operator->() const { return &ref_; }
+        private:
+            reference ref_;
+        };
+
+        iterator();
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        iterator& operator++();
+    protected:
+        friend class BPlusTree<Key, Value, NodeBytes>;
+        iterator(Leaf* leaf, unsigned index);
+        Leaf* leaf_;
+        unsigned index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // Helper functions
+    Leaf* findLeaf(const Key& key) const;
+    NodeBase* insertRecursive(NodeBase* node, const std::pair<const Key, Value>& item, Key& separator);
+    bool removeRecursive(NodeBase* node, const Key& key);
+    void fixUnderflow(Inner* parent, unsigned childIndex);
+    static unsigned minKeys(const NodeBase* node);
+    void destroy(NodeBase* node);
+    static NodeBase* cloneNode(const NodeBase* node, Leaf*& last);
+
+protected:
+    NodeBase* root_;
+    Leaf* head_;        // leftmost leaf, so begin() is O(1)
+    size_t size_;
+};
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the BPlusTree::iterator class.
+  ---------------------------------------------------------
+*/
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::iterator::iterator() :
+    leaf_(NULL), index_(0)
+{
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::iterator::iterator(Leaf* leaf, unsigned index) :
+    leaf_(leaf), index_(index)
+{
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator::reference
+BPlusTree<Key, Value, NodeBytes>::iterator::operator*() const
+{
+    return reference(leaf_->keys[index_], leaf_->values[index_]);
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator::pointer
+BPlusTree<Key, Value, NodeBytes>::iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances within the leaf, then along the sibling link.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator&
+BPlusTree<Key, Value, NodeBytes>::iterator::operator++()
+{
+    if(++index_ >= leaf_->count) {
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+/*
+  -------------------------------------------------------
+  End implementations for the BPlusTree::iterator class.
+  -------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------
+  Begin implementations for the BPlusTree class.
+  ------------------------------------------------
+*/
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree() :
+    root_(NULL), head_(NULL), size_(0)
+{
+}
+
+/**
+* Copies other node by node, relinking the copied leaves as it goes.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree(const BPlusTree<Key, Value, NodeBytes>& other) :
+    root_(NULL), head_(NULL), size_(0)
+{
+    *this = other;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree(BPlusTree<Key, Value, NodeBytes>&& other) noexcept :
+    root_(other.root_), head_(other.head_), size_(other.size_)
+{
+    other.root_ = NULL;
+    other.head_ = NULL;
+    other.size_ = 0;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>& BPlusTree<Key, Value, NodeBytes>::operator=(const BPlusTree<Key, Value, NodeBytes>& other)
+{
+    if(this == &other) return *this;
+    clear();
+    Leaf* last = NULL;
+    root_ = cloneNode(other.root_, last);
+    NodeBase* node = root_;
+    while(node != NULL && !node->leaf)
+        node = static_cast<Inner*>(node)->children[0];
+    head_ = static_cast<Leaf*>(node);
+    size_ = other.size_;
+    return *this;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>& BPlusTree<Key, Value, NodeBytes>::operator=(BPlusTree<Key, Value, NodeBytes>&& other) noexcept
+{
+    if(this == &other) return *this;
+    clear();
+    root_ = other.root_;
+    head_ = other.head_;
+    size_ = other.size_;
+    other.root_ = NULL;
+    other.head_ = NULL;
+    other.size_ = 0;
+    return *this;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::~BPlusTree()
+{
+    clear();
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::clear()
+{
+    destroy(root_);
+    root_ = NULL;
+    head_ = NULL;
+    size_ = 0;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+size_t BPlusTree<Key, Value, NodeBytes>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns the number of levels, counting the leaves.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+size_t BPlusTree<Key, Value, NodeBytes>::height() const
+{
+    size_t h = 0;
+    for(NodeBase* n = root_; n != NULL; h++) {
+        if(n->leaf) return h + 1;
+        n = static_cast<Inner*>(n)->children[0];
+    }
+    return h;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::begin() const
+{
+    return iterator(head_, 0);
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::end() const
+{
+    return iterator(NULL, 0);
+}
+
+/**
+* Returns an iterator to the item with the given key
+* or the end iterator if it is not in the tree
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::find(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if(leaf == NULL) return end();
+    unsigned i = Search::countLess(leaf->keys, leaf->count, key);
+    if(i < leaf->count && !(key < leaf->keys[i]))
+        return iterator(leaf, i);
+    return end();
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::lower_bound(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if(leaf == NULL) return end();
+    unsigned i = Search::countLess(leaf->keys, leaf->count, key);
+    if(i < leaf->count)
+        return iterator(leaf, i);
+    return iterator(leaf->next, 0);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<typename Key, typename Value, size_t NodeBytes>
+Value& BPlusTree<Key, Value, NodeBytes>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it.leaf_->values[it.index_];
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+Value const & BPlusTree<Key, Value, NodeBytes>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it.leaf_->values[it.index_];
+}
+
+/**
+* Inserts the item, overwriting the value if the key is already present.
+* A full root splits and the tree grows a level at the top.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    if(root_ == NULL) {
+        Leaf* leaf = new Leaf();
+        leaf->leaf = true;
+        leaf->count = 0;
+        leaf->prev = leaf->next = NULL;
+        root_ = head_ = leaf;
+    }
+    Key separator;
+    NodeBase* right = insertRecursive(root_, keyValuePair, separator);
+    if(right != NULL) {
+        Inner* newRoot = new Inner();
+        newRoot->leaf = false;
+        newRoot->count = 1;
+        newRoot->keys[0] = separator;
+        newRoot->children[0] = root_;
+        newRoot->children[1] = right;
+        root_ = newRoot;
+    }
+}
+
+/**
+* Removes the item with the given key, if present.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::remove(const Key& key)
+{
+    if(root_ == NULL) return;
+    if(!removeRecursive(root_, key)) return;
+    if(root_->leaf) {
+        if(root_->count == 0) {
+            delete static_cast<Leaf*>(root_);
+            root_ = NULL;
+            head_ = NULL;
+        }
+    }
+    else if(root_->count == 0) {
+        // The root's last two children merged; drop a level.
+        Inner* oldRoot = static_cast<Inner*>(root_);
+        root_ = oldRoot->children[0];
+        delete oldRoot;
+    }
+}
+
+/**
+* Helper function: findLeaf
+*
+* Descends to the leaf whose key range covers key.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::Leaf* BPlusTree<Key, Value, NodeBytes>::findLeaf(const Key& key) const
+{
+    NodeBase* node = root_;
+    if(node == NULL) return NULL;
+    while(!node->leaf) {
+        Inner* inner = static_cast<Inner*>(node);
+        node = inner->children[Search::countLessEqual(inner->keys, inner->count, key)];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+/**
+* Helper function: insertRecursive
+*
+* Inserts into the subtree at node. If node had to split, returns the new
+* right sibling and sets separator to the smallest key under it.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::NodeBase*
+BPlusTree<Key, Value, NodeBytes>::insertRecursive(NodeBase* node, const std::pair<const Key, Value>& item, Key& separator)
+{
+    if(node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        unsigned pos = Search::countLess(leaf->keys, leaf->count, item.first);
+        if(pos < leaf->count && !(item.first < leaf->keys[pos])) {
+            leaf->values[pos] = item.second;
+            return NULL;
+        }
+        size_++;
+        Leaf* target = leaf;
+        Leaf* right = NULL;
+        if(leaf->count == LEAF_CAPACITY) {
+            right = new Leaf();
+            right->leaf = true;
+            unsigned half = LEAF_CAPACITY / 2;
+            right->count = LEAF_CAPACITY - half;
+            std::copy(leaf->keys + half, leaf->keys + LEAF_CAPACITY, right->keys);
+            std::copy(leaf->values + half, leaf->values + LEAF_CAPACITY, right->values);
+            leaf->count = half;
+            right->prev = leaf;
+            right->next = leaf->next;
+            if(leaf->next != NULL) leaf->next->prev = right;
+            leaf->next = right;
+            if(pos > half) {
+                target = right;
+                pos -= half;
+            }
+        }
+        std::copy_backward(target->keys + pos, target->keys + target->count, target->keys + target->count + 1);
+        std::copy_backward(target->values + pos, target->values + target->count, target->values + target->count + 1);
+        target->keys[pos] = item.first;
+        target->values[pos] = item.second;
+        target->count++;
+        if(right != NULL)
+            separator = right->keys[0];
+        return right;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    unsigned pos = Search::countLessEqual(inner->keys, inner->count, item.first);
+    Key childSeparator;
+    NodeBase* newChild = insertRecursive(inner->children[pos], item, childSeparator);
+    if(newChild == NULL) return NULL;
+
+    // Insert the new child after children[pos]; splitting first if full.
+    Inner* target = inner;
+    Inner* right = NULL;
+    if(inner->count == INNER_CAPACITY) {
+        right = new Inner();
+        right->leaf = false;
+        unsigned half = INNER_CAPACITY / 2;
+        // keys[half] moves up; right takes the keys after it
+        separator = inner->keys[half];
+        right->count = INNER_CAPACITY - half - 1;
+        std::copy(inner->keys + half + 1, inner->keys + INNER_CAPACITY, right->keys);
+        std::copy(inner->children + half + 1, inner->children + INNER_CAPACITY + 1, right->children);
+        inner->count = half;
+        if(pos > half) {
+            target = right;
+            pos -= half + 1;
+        }
+    }
+    std::copy_backward(target->keys + pos, target->keys + target->count, target->keys + target->count + 1);
+    std::copy_backward(target->children + pos + 1, target->children + target->count + 1, target->children + target->count + 2);
+    target->keys[pos] = childSeparator;
+    target->children[pos + 1] = newChild;
+    target->count++;
+    return right;
+}
+
+/**
+* Helper function: removeRecursive
+*
+* Removes key from the subtree at node and repairs any child left with too
+* few keys. Returns false if key was not found.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::removeRecursive(NodeBase* node, const Key& key)
+{
+    if(node->leaf) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        unsigned pos = Search::countLess(leaf->keys, leaf->count, key);
+        if(pos >= leaf->count || key < leaf->keys[pos]) return false;
+        std::copy(leaf->keys + pos + 1, leaf->keys + leaf->count, leaf->keys + pos);
+        std::copy(leaf->values + pos + 1, leaf->values + leaf->count, leaf->values + pos);
+        leaf->count--;
+        size_--;
+        return true;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    unsigned pos = Search::countLessEqual(inner->keys, inner->count, key);
+    if(!removeRecursive(inner->children[pos], key)) return false;
+    if(inner->children[pos]->count < minKeys(inner->children[pos]))
+        fixUnderflow(inner, pos);
+    return true;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+unsigned BPlusTree<Key, Value, NodeBytes>::minKeys(const NodeBase* node)
+{
+    return node->leaf ? LEAF_CAPACITY / 2 : INNER_CAPACITY / 2;
+}
+
+/**
+* Helper function: fixUnderflow
+*
+* Refills parent->children[childIndex] by borrowing one key from a sibling
+* that can spare it, or otherwise merges it with a sibling.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::fixUnderflow(Inner* parent, unsigned childIndex)
+{
+    NodeBase* child = parent->children[childIndex];
+    NodeBase* left = (childIndex > 0) ? parent->children[childIndex - 1] : NULL;
+    NodeBase* right = (childIndex < parent->count) ? parent->children[childIndex + 1] : NULL;
+
+    if(child->leaf) {
+        Leaf* c = static_cast<Leaf*>(child);
+        if(left != NULL && left->count > minKeys(left)) {
+            Leaf* l = static_cast<Leaf*>(left);
+            std::copy_backward(c->keys, c->keys + c->count, c->keys + c->count + 1);
+            std::copy_backward(c->values, c->values + c->count, c->values + c->count + 1);
+            c->keys[0] = l->keys[l->count - 1];
+            c->values[0] = l->values[l->count - 1];
+            c->count++;
+            l->count--;
+            parent->keys[childIndex - 1] = c->keys[0];
+            return;
+        }
+        if(right != NULL && right->count > minKeys(right)) {
+            Leaf* r = static_cast<Leaf*>(right);
+            c->keys[c->count] = r->keys[0];
+            c->values[c->count] = r->values[0];
+            c->count++;
+            std::copy(r->keys + 1, r->keys + r->count, r->keys);
+            std::copy(r->values + 1, r->values + r->count, r->values);
+            r->count--;
+            parent->keys[childIndex] = r->keys[0];
+            return;
+        }
+        // Merge the right one of the pair into the left one.
+        unsigned sepIndex = (left != NULL) ? childIndex - 1 : childIndex;
+        Leaf* l = static_cast<Leaf*>(parent->children[sepIndex]);
+        Leaf* r = static_cast<Leaf*>(parent->children[sepIndex + 1]);
+        std::copy(r->keys, r->keys + r->count, l->keys + l->count);
+        std::copy(r->values, r->values + r->count, l->values + l->count);
+        l->count += r->count;
+        l->next = r->next;
+        if(r->next != NULL) r->next->prev = l;
+        delete r;
+        std::copy(parent->keys + sepIndex + 1, parent->keys + parent->count, parent->keys + sepIndex);
+        std::copy(parent->children + sepIndex + 2, parent->children + parent->count + 1, parent->children + sepIndex + 1);
+        parent->count--;
+        return;
+    }
+
+    Inner* c = static_cast<Inner*>(child);
+    if(left != NULL && left->count > minKeys(left)) {
+        // Rotate right through the parent's separator.
+        Inner* l = static_cast<Inner*>(left);
+        std::copy_backward(c->keys, c->keys + c->count, c->keys + c->count + 1);
+        std::copy_backward(c->children, c->children + c->count + 1, c->children + c->count + 2);
+        c->keys[0] = parent->keys[childIndex - 1];
+        c->children[0] = l->children[l->count];
+        c->count++;
+        parent->keys[childIndex - 1] = l->keys[l->count - 1];
+        l->count--;
+        return;
+    }
+    if(right != NULL && right->count > minKeys(right)) {
+        // Rotate left through the parent's separator.
+        Inner* r = static_cast<Inner*>(right);
+        c->keys[c->count] = parent->keys[childIndex];
+        c->children[c->count + 1] = r->children[0];
+        c->count++;
+        parent->keys[childIndex] = r->keys[0];
+        std::copy(r->keys + 1, r->keys + r->count, r->keys);
+        std::copy(r->children + 1, r->children + r->count + 1, r->children);
+        r->count--;
+        return;
+    }
+    // Merge: left keys + separator + right keys.
+    unsigned sepIndex = (left != NULL) ? childIndex - 1 : childIndex;
+    Inner* l = static_cast<Inner*>(parent->children[sepIndex]);
+    Inner* r = static_cast<Inner*>(parent->children[sepIndex + 1]);
+    l->keys[l->count] = parent->keys[sepIndex];
+    std::copy(r->keys, r->keys + r->count, l->keys + l->count + 1);
+    std::copy(r->children, r->children + r->count + 1, l->children + l->count + 1);
+    l->count += r->count + 1;
+    delete r;
+    std::copy(parent->keys + sepIndex + 1, parent->keys + parent->count, parent->keys + sepIndex);
+    std::copy(parent->children + sepIndex + 2, parent->children + parent->count + 1, parent->children + sepIndex + 1);
+    parent->count--;
+}
+
+template<typename Key, typename Value, size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::destroy(NodeBase* node)
+{
+    if(node == NULL) return;
+    if(node->leaf) {
+        delete static_cast<Leaf*>(node);
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for(unsigned i = 0; i <= inner->count; i++)
+        destroy(inner->children[i]);
+    delete inner;
+}
+
+/**
+* Helper function: cloneNode
+*
+* Copies the subtree under node. Leaves are copied left to right, and last
+* is the most recent copy so each new leaf can be linked after it.
+*/
+template<typename Key, typename Value, size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::NodeBase*
+BPlusTree<Key, Value, NodeBytes>::cloneNode(const NodeBase* node, Leaf*& last)
+{
+    if(node == NULL) return NULL;
+    if(node->leaf) {
+        Leaf* leaf = new Leaf(*static_cast<const Leaf*>(node));
+        leaf->prev = last;
+        leaf->next = NULL;
+        if(last != NULL) last->next = leaf;
+        last = leaf;
+        return leaf;
+    }
+    Inner* inner = new Inner(*static_cast<const Inner*>(node));
+    for(unsigned i = 0; i <= inner->count; i++)
+        inner->children[i] = cloneNode(inner->children[i], last);
+    return inner;
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the BPlusTree class.
+  ----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1012 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <map>
+#include <set>
+#include "bst.h"
+#include "avlbst.h"
+#include "bplustree.h"
+#include "string-avlbst.h"
+#include "tombstone-avlbst.h"
+#include "aggregate-avlbst.h"
+#include "interval-tree.h"
+#include "tree-export.h"
+#include "perf-counters.h"
+#include "scapegoat-bst.h"
+#include "tree-finger.h"
+#include "ordered-cache.h"
+#include "static-search-tree.h"
+#include "compressed-snapshot.h"
+#include "counted-avlbst.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Keeps results alive so the optimizer cannot drop the measured work
+static volatile size_t sink;
+
+double nsPerOp(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+void report(const string& name, double ns)
+{
+    cout << "  " << left << setw(36) << name << right << setw(10)
+         << fixed << setprecision(1) << ns << " ns/op" << endl;
+}
+
+// Shuffled keys 0, 2, 4, ... so every odd key is a guaranteed miss
+vector<int> evenKeys(size_t n, mt19937& rng)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; i++) keys[i] = (int)(2 * i);
+    shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+ * Lookup cost with and without the membership filter at 90% and 99% misses.
+ */
+void benchFilter(size_t n)
+{
+    cout << "Lookups with membership filter, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++)
+        tree.insert(make_pair(keys[i], keys[i]));
+
+    const double missRatios[] = { 0.90, 0.99 };
+    for(double missRatio : missRatios) {
+        vector<int> probes(n);
+        for(size_t i = 0; i < n; i++) {
+            int k = keys[rng() % n];
+            probes[i] = (rng() % 1000 < missRatio * 1000) ? k + 1 : k;
+        }
+        cout << " miss ratio " << setprecision(2) << missRatio << endl;
+
+        tree.detachFilter();
+        Clock::time_point start = Clock::now();
+        size_t hits = 0;
+        for(size_t i = 0; i < n; i++) hits += (tree.find(probes[i]) != tree.end());
+        report("no filter", nsPerOp(start, n));
+        sink = hits;
+
+        const double rates[] = { 0.01, 0.001 };
+        for(double rate : rates) {
+            tree.attachFilter(n, rate);
+            start = Clock::now();
+            hits = 0;
+            for(size_t i = 0; i < n; i++) hits += (tree.find(probes[i]) != tree.end());
+            ostringstream name;
+            name << "filter, fp rate " << rate;
+            report(name.str(), nsPerOp(start, n));
+            sink = hits;
+        }
+    }
+    tree.detachFilter();
+}
+
+/**
+ * Insert, lookup and full-scan throughput of the B+-tree against AVLTree.
+ */
+template<typename Tree>
+void benchMapOps(const string& name, const vector<int>& keys, const vector<int>& probes)
+{
+    size_t n = keys.size();
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++)
+        tree.insert(make_pair(keys[i], keys[i]));
+    report(name + " insert", nsPerOp(start, n));
+
+    start = Clock::now();
+    size_t hits = 0;
+    for(size_t i = 0; i < n; i++) hits += (tree.find(probes[i]) != tree.end());
+    report(name + " find", nsPerOp(start, n));
+
+    start = Clock::now();
+    long long sum = 0;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) sum += it->second;
+    report(name + " scan", nsPerOp(start, n));
+    sink = hits + (size_t)sum;
+}
+
+void benchBPlusTree(size_t n)
+{
+    cout << "B+-tree vs AVLTree, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    vector<int> probes(n);
+    for(size_t i = 0; i < n; i++) probes[i] = keys[rng() % n];
+    benchMapOps<AVLTree<int,int> >("AVLTree", keys, probes);
+    benchMapOps<BPlusTree<int,int,256> >("BPlusTree<256B nodes>", keys, probes);
+    benchMapOps<BPlusTree<int,int,4096> >("BPlusTree<4KB nodes>", keys, probes);
+}
+
+/**
+ * String lookups on URL- and path-like keys, AVLTree<string> against
+ * StringAVLTree with and without shared-prefix skipping.
+ */
+template<typename Tree>
+void benchStringFind(const string& name, Tree& tree, const vector<string>& keys, const vector<string>& probes)
+{
+    for(size_t i = 0; i < keys.size(); i++)
+        tree.insert(make_pair(keys[i], (int)i));
+    Clock::time_point start = Clock::now();
+    size_t hits = 0;
+    for(size_t i = 0; i < probes.size(); i++) hits += (tree.find(probes[i]) != tree.end());
+    report(name, nsPerOp(start, probes.size()));
+    sink = hits;
+}
+
+void benchStringKeys(size_t n)
+{
+    mt19937 rng(104);
+    const char* hosts[] = { "https://www.example.com/", "https://api.example.com/v2/", "https://cdn.example.net/static/" };
+    const char* dirs[] = { "/var/log/nginx/", "/home/user/projects/hw4/", "/usr/share/doc/" };
+    vector<string> urls(n), paths(n);
+    for(size_t i = 0; i < n; i++) {
+        urls[i] = string(hosts[rng() % 3]) + "users/" + to_string(rng() % 100000) + "/posts/" + to_string(rng());
+        paths[i] = string(dirs[rng() % 3]) + "dir" + to_string(rng() % 1000) + "/file" + to_string(rng()) + ".txt";
+    }
+    const vector<string>* sets[] = { &urls, &paths };
+    const char* names[] = { "URL", "path" };
+    for(int s = 0; s < 2; s++) {
+        cout << "String keys (" << names[s] << "), n = " << n << endl;
+        const vector<string>& keys = *sets[s];
+        vector<string> probes(n);
+        for(size_t i = 0; i < n; i++) probes[i] = keys[rng() % n];
+        AVLTree<string,int> avl;
+        StringAVLTree<int> prefixOnly(false);
+        StringAVLTree<int> skipping(true);
+        benchStringFind("AVLTree<string> find", avl, keys, probes);
+        benchStringFind("StringAVLTree find (prefix cache)", prefixOnly, keys, probes);
+        benchStringFind("StringAVLTree find (+skip shared)", skipping, keys, probes);
+    }
+}
+
+/**
+ * Bulk delete of half the keys: eager AVLTree::remove against tombstones
+ * plus one compaction.
+ */
+void benchTombstones(size_t n)
+{
+    cout << "Bulk delete of n/2 keys, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    vector<int> victims(keys.begin(), keys.begin() + n / 2);
+
+    AVLTree<int,int> eager;
+    TombstoneAVLTree<int,int> lazy(1.0);    // compacted explicitly below
+    for(size_t i = 0; i < n; i++) {
+        eager.insert(make_pair(keys[i], keys[i]));
+        lazy.insert(make_pair(keys[i], keys[i]));
+    }
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < victims.size(); i++) eager.remove(victims[i]);
+    report("AVLTree::remove", nsPerOp(start, victims.size()));
+
+    start = Clock::now();
+    for(size_t i = 0; i < victims.size(); i++) lazy.remove(victims[i]);
+    report("TombstoneAVLTree::remove", nsPerOp(start, victims.size()));
+    start = Clock::now();
+    size_t freed = lazy.compact();
+    report("compact(), per removed key", nsPerOp(start, victims.size()));
+    cout << "  reclaimed " << freed << " nodes, "
+         << freed * sizeof(TombstoneAVLNode<int,int>) / 1024 << " KiB" << endl;
+}
+
+/**
+ * Applying batches of new keys to a tree of n keys: per-key insert against
+ * insert_batch on one and four threads.
+ */
+void benchBatchInsert(size_t n)
+{
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    vector<pair<int,int> > initial(n);
+    for(size_t i = 0; i < n; i++) initial[i] = make_pair(keys[i], keys[i]);
+    const size_t batchSizes[] = { 10000, 100000, 1000000 };
+    for(size_t b : batchSizes) {
+        cout << "Batch of " << b << " new keys into n = " << n << endl;
+        vector<pair<int,int> > batch(b);
+        for(size_t i = 0; i < b; i++) {
+            int k = (int)(rng() % (2 * max(n, b))) | 1;
+            batch[i] = make_pair(k, k);
+        }
+        const unsigned threadCounts[] = { 0, 1, 4 };
+        for(unsigned threads : threadCounts) {
+            AVLTree<int,int> tree;
+            tree.insert_batch(initial.begin(), initial.end());
+            Clock::time_point start = Clock::now();
+            if(threads == 0) {
+                for(size_t i = 0; i < b; i++) tree.insert(batch[i]);
+            }
+            else {
+                tree.insert_batch(batch.begin(), batch.end(), threads);
+            }
+            string name = (threads == 0) ? "per-key insert" :
+                          "insert_batch, " + to_string(threads) + " thread(s)";
+            report(name, nsPerOp(start, b));
+            sink = tree.size();
+        }
+    }
+}
+
+/**
+ * Range sums over n keys by iterator walk against aggregate(), for ranges
+ * covering about 1% and 50% of the keys.
+ */
+void benchAggregate(size_t n)
+{
+    cout << "Range sum, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,long long> plain;
+    AggregateAVLTree<int,long long> summed;
+    for(size_t i = 0; i < n; i++) {
+        plain.insert(make_pair(keys[i], (long long)i));
+        summed.insert(make_pair(keys[i], (long long)i));
+    }
+    const int spans[] = { (int)(n / 50), (int)n };
+    for(int span : spans) {
+        size_t queries = 2000;
+        vector<int> starts(queries);
+        for(size_t i = 0; i < queries; i++) starts[i] = (int)(rng() % (2 * n));
+        string pct = to_string(span * 50 / (int)n) + "%";
+
+        Clock::time_point start = Clock::now();
+        long long total = 0;
+        for(size_t i = 0; i < queries; i++) {
+            for(AVLTree<int,long long>::iterator it = plain.lower_bound(starts[i]);
+                it != plain.end() && it->first <= starts[i] + span; ++it)
+                total += it->second;
+        }
+        report("iterator walk, " + pct + " of keys", nsPerOp(start, queries));
+        start = Clock::now();
+        for(size_t i = 0; i < queries; i++)
+            total -= summed.aggregate(starts[i], starts[i] + span);
+        report("aggregate(), " + pct + " of keys", nsPerOp(start, queries));
+        sink = (size_t)total;
+    }
+}
+
+/**
+ * Stabbing queries over n intervals of up to 1000 units in a space of 100n
+ * units: a scan of every interval against IntervalTree::stab.
+ */
+void benchIntervals(size_t n)
+{
+    cout << "Stabbing query, n = " << n << " intervals" << endl;
+    mt19937 rng(104);
+    IntervalTree<int,int> tree;
+    vector<Interval<int> > all(n);
+    for(size_t i = 0; i < n; i++) {
+        int start = (int)(rng() % (100 * n));
+        all[i] = Interval<int>(start, start + (int)(rng() % 1000));
+        tree.insert(all[i].start, all[i].end, (int)i);
+    }
+    size_t queries = 1000;
+    vector<int> points(queries);
+    for(size_t i = 0; i < queries; i++) points[i] = (int)(rng() % (100 * n));
+
+    Clock::time_point start = Clock::now();
+    size_t found = 0;
+    for(size_t i = 0; i < queries; i++) {
+        for(size_t j = 0; j < n; j++) found += all[j].contains(points[i]);
+    }
+    report("scan of all intervals", nsPerOp(start, queries));
+    start = Clock::now();
+    vector<pair<Interval<int>, int> > hits;
+    for(size_t i = 0; i < queries; i++) {
+        hits.clear();
+        tree.stab(points[i], hits);
+        found -= hits.size();
+    }
+    report("IntervalTree::stab", nsPerOp(start, queries));
+    sink = found;
+}
+
+/**
+ * Streaming a tree of n nodes to /dev/null in each export format.
+ */
+void benchExport(size_t n)
+{
+    cout << "Export, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+    ofstream devnull("/dev/null");
+    const char* names[] = { "DOT", "JSON lines", "text" };
+    for(int f = 0; f < 3; f++) {
+        TreeExporter<int,int> exporter(devnull, (TreeExporter<int,int>::Format)f);
+        Clock::time_point start = Clock::now();
+        sink = exporter.write(tree);
+        report(string(names[f]) + ", per node", nsPerOp(start, n));
+    }
+}
+
+// Runs work once under the counters and prints time and events per op
+template<typename Work>
+void perfRow(PerfCounters& counters, const string& name, size_t ops, Work work)
+{
+    Clock::time_point start = Clock::now();
+    counters.start();
+    work();
+    counters.stop();
+    double ns = nsPerOp(start, ops);
+    cout << "  " << left << setw(28) << name << right << setw(9) << fixed << setprecision(1) << ns;
+    for(int e = 0; e < PerfCounters::NUM_EVENTS; e++) {
+        if(counters.available((PerfCounters::Event)e))
+            cout << setw(11) << setprecision(2) << (double)counters.value((PerfCounters::Event)e) / ops;
+        else
+            cout << setw(11) << "n/a";
+    }
+    cout << endl;
+}
+
+template<typename Tree>
+void perfTree(PerfCounters& counters, const string& name, const vector<int>& keys, size_t removes)
+{
+    Tree tree;
+    perfRow(counters, name + " insert", keys.size(), [&]() {
+        for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], keys[i]));
+    });
+    perfRow(counters, name + " find", keys.size(), [&]() {
+        size_t found = 0;
+        for(size_t i = 0; i < keys.size(); i++) found += (tree.find(keys[i]) != tree.end());
+        sink = found;
+    });
+    perfRow(counters, name + " iterate", keys.size(), [&]() {
+        size_t total = 0;
+        for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) total += it->second;
+        sink = total;
+    });
+    perfRow(counters, name + " remove", removes, [&]() {
+        for(size_t i = 0; i < removes; i++) tree.remove(keys[i]);
+    });
+}
+
+/**
+ * Time and hardware events per operation for find, insert, remove and
+ * iteration on BinarySearchTree and AVLTree, with random keys.
+ */
+void benchPerf(size_t n)
+{
+    PerfCounters counters;
+    cout << "Hardware events per op, n = " << n << endl;
+    if(!counters.anyAvailable())
+        cout << "  (no hardware counters: " << counters.unavailableReason() << ")" << endl;
+    else if(!counters.unavailableReason().empty())
+        cout << "  (some counters missing: " << counters.unavailableReason() << ")" << endl;
+    cout << "  " << left << setw(28) << "operation" << right << setw(9) << "ns";
+    for(int e = 0; e < PerfCounters::NUM_EVENTS; e++)
+        cout << setw(11) << PerfCounters::name((PerfCounters::Event)e);
+    cout << endl;
+
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    size_t removes = n;
+    perfTree<BinarySearchTree<int,int> >(counters, "BinarySearchTree", keys, removes);
+    perfTree<AVLTree<int,int> >(counters, "AVLTree", keys, removes);
+}
+
+/**
+ * Copying a tree of n nodes: re-inserting every item against the O(n)
+ * structural copy constructor, and moving.
+ */
+void benchClone(size_t n)
+{
+    cout << "Copy, n = " << n << endl;
+    mt19937 rng(104);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], keys[i]));
+
+    Clock::time_point start = Clock::now();
+    {
+        AVLTree<int,int> copy;
+        for(AVLTree<int,int>::iterator it = tree.begin(); it != tree.end(); ++it) copy.insert(*it);
+        sink = copy.size();
+        report("re-insert, per node", nsPerOp(start, n));
+    }
+    start = Clock::now();
+    {
+        AVLTree<int,int> copy(tree);
+        sink = copy.size();
+        report("copy constructor, per node", nsPerOp(start, n));
+        start = Clock::now();
+        AVLTree<int,int> moved(std::move(copy));
+        sink = moved.size();
+        report("move constructor", nsPerOp(start, 1));
+        start = Clock::now();
+        size_t found = 0;
+        for(size_t i = 0; i < n; i++) found += (moved.find(keys[i]) != moved.end());
+        sink = found;
+        report("find in the copy", nsPerOp(start, n));
+    }
+    start = Clock::now();
+    size_t found = 0;
+    for(size_t i = 0; i < n; i++) found += (tree.find(keys[i]) != tree.end());
+    sink = found;
+    report("find in the original", nsPerOp(start, n));
+}
+
+double findAll(const AVLTree<int,int>& tree, const vector<int>& probes)
+{
+    Clock::time_point start = Clock::now();
+    size_t found = 0;
+    for(size_t i = 0; i < probes.size(); i++) found += (tree.find(probes[i]) != tree.end());
+    sink = found;
+    return nsPerOp(start, probes.size());
+}
+
+/**
+ * Lookups in a tree aged by unrelated allocations between its inserts,
+ * before and after an incremental van Emde Boas relayout, against a fresh
+ * pre-order copy.
+ */
+void benchRelayout(size_t n)
+{
+    cout << "Relayout, n = " << n << endl;
+    mt19937 rng(105);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    vector<char*> noise;
+    for(size_t i = 0; i < n; i++) {
+        tree.insert(make_pair(keys[i], keys[i]));
+        for(int j = 0; j < 4; j++) noise.push_back(new char[16 + rng() % 240]);
+    }
+    shuffle(noise.begin(), noise.end(), rng);
+    for(size_t i = 0; i < noise.size() / 2; i++) delete[] noise[i];
+    vector<int> probes(keys);
+    shuffle(probes.begin(), probes.end(), rng);
+
+    report("find, aged", findAll(tree, probes));
+    {
+        AVLTree<int,int> copy(tree);
+        report("find, pre-order copy", findAll(copy, probes));
+    }
+
+    const size_t slice = 4096;
+    Clock::time_point start = Clock::now();
+    tree.beginCompactLayout();
+    report("plan, per node", nsPerOp(start, n));
+    double worst = 0;
+    size_t slices = 0;
+    start = Clock::now();
+    for(bool done = false; !done; slices++) {
+        Clock::time_point sliceStart = Clock::now();
+        done = tree.stepCompactLayout(slice);
+        worst = max(worst, nsPerOp(sliceStart, 1));
+    }
+    report("relayout, per node", nsPerOp(start, n));
+    report("relayout, worst 4096-node slice", worst);
+    report("find, relaid out", findAll(tree, probes));
+    for(size_t i = noise.size() / 2; i < noise.size(); i++) delete[] noise[i];
+}
+
+/**
+ * Moving half of one tree's items into another: remove and re-insert
+ * against extract and insert of the node handle, and merge.
+ */
+void benchNodeHandles(size_t n)
+{
+    cout << "Move n/2 items between trees, n = " << n << endl;
+    mt19937 rng(106);
+    vector<int> keys = evenKeys(n, rng);
+    {
+        AVLTree<int,int> source, target;
+        for(size_t i = 0; i < n; i++) source.insert(make_pair(keys[i], keys[i]));
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < n / 2; i++) {
+            target.insert(*source.find(keys[i]));
+            source.remove(keys[i]);
+        }
+        report("remove + insert, per item", nsPerOp(start, n / 2));
+    }
+    {
+        AVLTree<int,int> source, target;
+        for(size_t i = 0; i < n; i++) source.insert(make_pair(keys[i], keys[i]));
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < n / 2; i++)
+            target.insert(source.extract(keys[i]));
+        report("extract + insert handle, per item", nsPerOp(start, n / 2));
+    }
+    {
+        AVLTree<int,int> source, target;
+        for(size_t i = 0; i < n; i++) (i < n / 2 ? source : target).insert(make_pair(keys[i], keys[i]));
+        Clock::time_point start = Clock::now();
+        sink = target.merge(source);
+        report("merge, per item", nsPerOp(start, n / 2));
+    }
+}
+
+/**
+ * Sorted input into the unbalanced BinarySearchTree: the resulting chain
+ * against an explicit rebalance() and against auto-rebalance mode.
+ * Building the chain is quadratic, so n is capped.
+ */
+void benchRebalance(size_t n)
+{
+    n = min(n, (size_t)20000);
+    cout << "Sorted inserts into BinarySearchTree, n = " << n << endl;
+    mt19937 rng(107);
+    vector<int> probes(n);
+    for(size_t i = 0; i < n; i++) probes[i] = (int)i;
+    shuffle(probes.begin(), probes.end(), rng);
+
+    BinarySearchTree<int,int> chain;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) chain.insert(make_pair((int)i, (int)i));
+    report("insert, plain", nsPerOp(start, n));
+    start = Clock::now();
+    size_t found = 0;
+    for(size_t i = 0; i < n; i++) found += (chain.find(probes[i]) != chain.end());
+    report("find, chain", nsPerOp(start, n));
+    start = Clock::now();
+    chain.rebalance();
+    report("rebalance, per node", nsPerOp(start, n));
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (chain.find(probes[i]) != chain.end());
+    report("find, rebalanced", nsPerOp(start, n));
+
+    BinarySearchTree<int,int> automatic;
+    automatic.setAutoRebalance(2);
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) automatic.insert(make_pair((int)i, (int)i));
+    report("insert, auto-rebalance", nsPerOp(start, n));
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (automatic.find(probes[i]) != automatic.end());
+    report("find, auto-rebalance", nsPerOp(start, n));
+    sink = found;
+}
+
+template<typename Tree>
+void benchBalancedTree(const string& name, const vector<int>& keys, const vector<int>& probes, size_t removes)
+{
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++) tree.insert(make_pair(keys[i], keys[i]));
+    report(name + " insert random", nsPerOp(start, keys.size()));
+    start = Clock::now();
+    size_t found = 0;
+    for(size_t i = 0; i < probes.size(); i++) found += (tree.find(probes[i]) != tree.end());
+    report(name + " find", nsPerOp(start, probes.size()));
+    start = Clock::now();
+    for(size_t i = 0; i < removes; i++) tree.remove(keys[i]);
+    report(name + " remove", nsPerOp(start, removes));
+    Tree sorted;
+    start = Clock::now();
+    for(size_t i = 0; i < keys.size(); i++) sorted.insert(make_pair((int)i, (int)i));
+    report(name + " insert sorted", nsPerOp(start, keys.size()));
+    sink = found + sorted.size();
+}
+
+/**
+ * ScapegoatTree against AVLTree: bytes per node and throughput.
+ */
+void benchScapegoat(size_t n)
+{
+    cout << "Scapegoat vs AVL, n = " << n << endl;
+    cout << "  node size: Node " << sizeof(Node<int,int>) << " bytes, AVLNode " << sizeof(AVLNode<int,int>)
+         << " bytes" << endl;
+    mt19937 rng(108);
+    vector<int> keys = evenKeys(n, rng);
+    vector<int> probes(n);
+    for(size_t i = 0; i < n; i++) probes[i] = (int)(rng() % (2 * n));
+    size_t removes = n / 2;
+    benchBalancedTree<ScapegoatTree<int,int> >("scapegoat", keys, probes, removes);
+    benchBalancedTree<AVLTree<int,int> >("avl", keys, probes, removes);
+}
+
+/**
+ * Lookups from the root vs from a finger at the last position, on a
+ * sequential trace, a clustered one (runs of keys within 16 of random
+ * centers) and a uniform one where the finger cannot help.
+ */
+void benchFinger(size_t n)
+{
+    cout << "Finger search on AVLTree, n = " << n << endl;
+    mt19937 rng(109);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], (int)i));
+
+    vector<int> sequential(n), clustered(n), uniform(n);
+    int center = 0;
+    for(size_t i = 0; i < n; i++) {
+        sequential[i] = (int)i;
+        if(i % 64 == 0) center = (int)(rng() % (2 * n));
+        clustered[i] = center + (int)(rng() % 32) - 16;
+        uniform[i] = (int)(rng() % (2 * n));
+    }
+    const vector<int>* traces[] = { &sequential, &clustered, &uniform };
+    const char* names[] = { "sequential", "clustered", "uniform" };
+    size_t found = 0;
+    for(int t = 0; t < 3; t++) {
+        const vector<int>& trace = *traces[t];
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < n; i++) found += (tree.find(trace[i]) != tree.end());
+        report(string("find, ") + names[t], nsPerOp(start, n));
+        TreeFinger<int,int> finger(tree);
+        start = Clock::now();
+        for(size_t i = 0; i < n; i++) found += (finger.find(trace[i]) != tree.end());
+        double ns = nsPerOp(start, n);
+        ostringstream name;
+        name << "finger find, " << names[t] << " (" << setprecision(1) << fixed
+             << (double)finger.steps() / n << " steps)";
+        report(name.str(), ns);
+    }
+
+    AVLTree<int,int> appended, viaFinger;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) appended.insert(make_pair((int)i, (int)i));
+    report("insert, sequential", nsPerOp(start, n));
+    TreeFinger<int,int> finger(viaFinger);
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) finger.insert(make_pair((int)i, (int)i));
+    report("finger insert, sequential", nsPerOp(start, n));
+    sink = found + viaFinger.size();
+}
+
+// Keys drawn from a Zipf distribution with exponent s over the given keys,
+// the first key being the most popular
+vector<int> zipfTrace(const vector<int>& keys, size_t count, double s, mt19937& rng)
+{
+    vector<double> cdf(keys.size());
+    double total = 0;
+    for(size_t i = 0; i < keys.size(); i++) cdf[i] = (total += 1.0 / pow((double)(i + 1), s));
+    uniform_real_distribution<double> uniform(0, total);
+    vector<int> trace(count);
+    for(size_t i = 0; i < count; i++)
+        trace[i] = keys[lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin()];
+    return trace;
+}
+
+/**
+ * find latency under Zipfian load with and without a hot-key cache. Each
+ * lookup is timed on its own, so the percentiles include about 20 ns of
+ * clock overhead.
+ */
+void benchHotKeys(size_t n)
+{
+    cout << "Hot-key cache on AVLTree, Zipf s = 0.99, n = " << n << endl;
+    mt19937 rng(110);
+    vector<int> keys = evenKeys(n, rng);
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], (int)i));
+    vector<int> trace = zipfTrace(keys, n, 0.99, rng);
+
+    const size_t sizes[] = { 0, 256, 4096, 65536 };
+    vector<double> latency(n);
+    size_t found = 0;
+    for(size_t entries : sizes) {
+        if(entries == 0) tree.detachHotKeyCache();
+        else tree.attachHotKeyCache(entries);
+        for(size_t i = 0; i < n / 4; i++) found += (tree.find(trace[i]) != tree.end());
+        if(entries != 0) const_cast<HotKeyCache<int,int>*>(tree.hotKeyCache())->resetCounters();
+        Clock::time_point all = Clock::now();
+        for(size_t i = 0; i < n; i++) {
+            Clock::time_point start = Clock::now();
+            found += (tree.find(trace[i]) != tree.end());
+            latency[i] = chrono::duration<double, nano>(Clock::now() - start).count();
+        }
+        double mean = nsPerOp(all, n);
+        sort(latency.begin(), latency.end());
+        ostringstream name;
+        if(entries == 0) name << "no cache";
+        else name << entries << " entries, hit rate " << setprecision(2) << fixed
+                  << (double)tree.hotKeyCache()->hits() / n;
+        cout << "  " << left << setw(36) << name.str() << right << fixed << setprecision(1)
+             << " p50 " << setw(7) << latency[n / 2] << "  p99 " << setw(7) << latency[n * 99 / 100]
+             << "  mean " << setw(7) << mean << " ns" << endl;
+    }
+    tree.detachHotKeyCache();
+    sink = found;
+}
+
+/**
+ * OrderedCache at capacity: every insert of a new key evicts the least
+ * recently used entry. Keys follow the same Zipf trace as the hot-key
+ * bench, so most gets hit.
+ */
+void benchOrderedCache(size_t n)
+{
+    size_t capacity = n / 10;
+    cout << "OrderedCache with " << capacity << " entries, n = " << n << endl;
+    mt19937 rng(111);
+    vector<int> keys = evenKeys(n, rng);
+    vector<int> trace = zipfTrace(keys, n, 0.99, rng);
+
+    AVLTree<int,int> plain;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) plain.insert(make_pair(trace[i], (int)i));
+    report("AVLTree insert, unbounded", nsPerOp(start, n));
+
+    OrderedCache<int,int> cache(capacity);
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) cache.insert(make_pair(trace[i], (int)i));
+    report("cache insert, LRU eviction", nsPerOp(start, n));
+    size_t found = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (cache.get(trace[n - 1 - i]) != cache.end());
+    report("cache get", nsPerOp(start, n));
+    cout << "  size " << cache.size() << " (AVLTree " << plain.size() << "), evictions " << cache.evictions()
+         << ", get hit rate " << setprecision(2) << fixed << (double)found / n << endl;
+
+    OrderedCache<int,int> timed(0);
+    timed.setDefaultTtl(chrono::microseconds(50));
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) timed.insert(make_pair(keys[i], (int)i));
+    report("cache insert, 50 us TTL", nsPerOp(start, n));
+    cout << "  size " << timed.size() << ", expirations " << timed.expirations() << endl;
+    sink = found;
+}
+
+/**
+ * A priority queue with cancellation, as in timer queues and schedulers:
+ * pushes, pops of the smallest key and cancels of a key pushed earlier,
+ * mixed 2:1:1 over unique random keys. std::priority_queue cannot remove
+ * from the middle, so a cancel only clears the key's queued flag and pops
+ * discard flagged-off tops; AVLTree removes the key and pops its cached
+ * smallest node. Both must pop the same keys.
+ */
+void benchPriorityQueue(size_t n)
+{
+    cout << "Priority queue with cancels, n = " << n << endl;
+    mt19937 rng(112);
+    vector<int> keys = evenKeys(n, rng);
+    vector<int> ops(n), cancels(n);
+    size_t pushed = 0;
+    for(size_t i = 0; i < n; i++) {
+        int r = (int)(rng() % 4);
+        ops[i] = (i < n / 8 || r < 2) ? 0 : r - 1;
+        if(ops[i] == 0) pushed++;
+        cancels[i] = keys[rng() % max(pushed, (size_t)1)];
+    }
+
+    vector<char> queued(2 * n, 0);
+    priority_queue<int, vector<int>, greater<int> > heap;
+    size_t live = 0, next = 0, heapSum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        if(ops[i] == 0) {
+            heap.push(keys[next]);
+            queued[keys[next++]] = 1;
+            live++;
+        }
+        else if(ops[i] == 1) {
+            if(live == 0) continue;
+            while(!queued[heap.top()]) heap.pop();
+            heapSum += heap.top();
+            queued[heap.top()] = 0;
+            heap.pop();
+            live--;
+        }
+        else if(queued[cancels[i]]) {
+            queued[cancels[i]] = 0;
+            live--;
+        }
+    }
+    report("priority_queue + lazy delete", nsPerOp(start, n));
+    size_t heapLeft = heap.size();
+
+    AVLTree<int,int> tree;
+    size_t treeSum = 0;
+    next = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        if(ops[i] == 0) {
+            tree.insert(make_pair(keys[next++], 0));
+        }
+        else if(ops[i] == 1) {
+            if(tree.empty()) continue;
+            treeSum += tree.front().first;
+            tree.pop_min();
+        }
+        else
+            tree.remove(cancels[i]);
+    }
+    report("AVLTree insert/remove/pop_min", nsPerOp(start, n));
+    cout << "  same pops: " << (heapSum == treeSum) << ", live " << tree.size() << ", heap holds "
+         << heapLeft << " (" << heapLeft - live << " cancelled)" << endl;
+
+    // Copies, so both drains start from the same compact layout
+    AVLTree<int,int> byKey(tree), byPop(tree);
+    size_t left = tree.size();
+    start = Clock::now();
+    while(!byKey.empty()) byKey.remove(byKey.begin()->first);
+    report("drain by remove(begin()->first)", nsPerOp(start, left));
+    start = Clock::now();
+    while(!byPop.empty()) byPop.pop_min();
+    report("drain by pop_min", nsPerOp(start, left));
+    sink = treeSum;
+}
+
+// Keys 0, 2, 4, ... generated at compile time, for the static tree bench
+template<typename List>
+struct EvenTable;
+
+template<size_t... Is>
+struct EvenTable<StaticIndexList<Is...> >
+{
+    static constexpr pair<int,int> items[sizeof...(Is)] = { pair<int,int>(2 * (int)Is, (int)Is)... };
+};
+
+template<size_t... Is>
+constexpr pair<int,int> EvenTable<StaticIndexList<Is...> >::items[sizeof...(Is)];
+
+template<size_t N>
+void benchStaticTable(size_t n)
+{
+    typedef EvenTable<typename MakeStaticIndexList<N>::type> Table;
+    static constexpr StaticSearchTree<int,int,N> table(Table::items);
+    cout << "  " << N << " keys" << endl;
+    mt19937 rng(113);
+    vector<int> probes(n);
+    for(size_t i = 0; i < n; i++) probes[i] = (int)(rng() % (2 * N));
+
+    Clock::time_point start = Clock::now();
+    AVLTree<int,int> avl;
+    for(size_t i = 0; i < N; i++) avl.insert(Table::items[i]);
+    report("AVLTree build, per key", nsPerOp(start, N));
+    size_t found = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (avl.find(probes[i]) != avl.end());
+    report("AVLTree find", nsPerOp(start, n));
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        const pair<int,int>* it = lower_bound(Table::items, Table::items + N, probes[i],
+            [](const pair<int,int>& item, int key) { return item.first < key; });
+        found += (it != Table::items + N && it->first == probes[i]);
+    }
+    report("lower_bound on the sorted array", nsPerOp(start, n));
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (table.find(probes[i]) != table.end());
+    report("StaticSearchTree find", nsPerOp(start, n));
+    sink = found;
+}
+
+/**
+ * Lookup tables fixed at compile time: an AVLTree built at startup against
+ * binary search of the sorted array and the constexpr Eytzinger layout,
+ * with half the probes missing.
+ */
+void benchStaticTree(size_t n)
+{
+    cout << "Compile-time tables, n = " << n << " lookups" << endl;
+    benchStaticTable<255>(n);
+    benchStaticTable<4095>(n);
+}
+
+/**
+ * Size against lookup time for CompressedSnapshot at several block sizes,
+ * from an AVLTree of n keys about 16 apart; probes hit one time in 16.
+ */
+void benchSnapshot(size_t n)
+{
+    cout << "Compressed snapshot of n = " << n << " keys" << endl;
+    mt19937 rng(114);
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; i++) keys[i] = (int)(16 * i + rng() % 16);
+    shuffle(keys.begin(), keys.end(), rng);
+    vector<int> probes(n);
+    for(size_t i = 0; i < n; i++) probes[i] = (int)(rng() % (16 * n));
+
+    AVLTree<int,int> tree;
+    for(size_t i = 0; i < n; i++) tree.insert(make_pair(keys[i], (int)i));
+    size_t found = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) found += (tree.find(probes[i]) != tree.end());
+    report("AVLTree find", nsPerOp(start, n));
+    cout << "  AVLTree: " << sizeof(AVLNode<int,int>) << " bytes per node before allocator overhead" << endl;
+
+    cout << "  " << setw(6) << "block" << setw(12) << "key B/key" << setw(12) << "total B/key"
+         << setw(10) << "find ns" << setw(10) << "lb ns" << setw(10) << "iter ns" << endl;
+    for(size_t blockSize = 16; blockSize <= 256; blockSize *= 2) {
+        CompressedSnapshot<int,int> snapshot(tree, blockSize);
+        start = Clock::now();
+        for(size_t i = 0; i < n; i++) found += (snapshot.find(probes[i]) != snapshot.end());
+        double findNs = nsPerOp(start, n);
+        start = Clock::now();
+        for(size_t i = 0; i < n; i++) found += snapshot.lower_bound(probes[i])->second;
+        double lowerBoundNs = nsPerOp(start, n);
+        start = Clock::now();
+        for(CompressedSnapshot<int,int>::iterator it = snapshot.begin(); it != snapshot.end(); ++it) found += it->first;
+        double iterateNs = nsPerOp(start, n);
+        cout << "  " << setw(6) << blockSize << fixed << setprecision(2)
+             << setw(12) << (double)snapshot.keyBytes() / n << setw(12) << (double)snapshot.bytes() / n
+             << setprecision(1) << setw(10) << findNs << setw(10) << lowerBoundNs << setw(10) << iterateNs << endl;
+    }
+    sink = found;
+}
+
+/**
+ * A frequency table over a Zipf trace of n keys drawn from n / 10:
+ * CountedAVLTree against an AVLTree with a separate count map, as done
+ * before the counted mode, and the std containers.
+ */
+void benchCounted(size_t n)
+{
+    size_t universe = max(n / 10, (size_t)1);
+    cout << "Frequency table, n = " << n << " inserts over " << universe << " keys" << endl;
+    mt19937 rng(115);
+    vector<int> keys = evenKeys(universe, rng);
+    vector<int> trace = zipfTrace(keys, n, 0.99, rng);
+
+    CountedAVLTree<int,int> counted;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < n; i++) counted.insert(make_pair(trace[i], 0));
+    report("CountedAVLTree insert", nsPerOp(start, n));
+
+    AVLTree<int,int> tree;
+    map<int,size_t> counts;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) {
+        tree.insert(make_pair(trace[i], 0));
+        counts[trace[i]]++;
+    }
+    report("AVLTree + count map insert", nsPerOp(start, n));
+
+    map<int,size_t> plainCounts;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) plainCounts[trace[i]]++;
+    report("std::map<int,size_t> ++", nsPerOp(start, n));
+
+    multiset<int> bag;
+    start = Clock::now();
+    for(size_t i = 0; i < n; i++) bag.insert(trace[i]);
+    report("std::multiset insert", nsPerOp(start, n));
+
+    size_t total = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < universe; i++) total += counted.count(keys[i]);
+    report("CountedAVLTree count", nsPerOp(start, universe));
+    cout << "  counted: " << counted.distinct() << " nodes of " << sizeof(CountedAVLNode<int,int>)
+         << " bytes for " << counted.size() << " copies; multiset: " << bag.size() << " nodes" << endl;
+    sink = total + counts.size() + plainCounts.size();
+}
+
+int main(int argc, char *argv[])
+{
+    string which = (argc > 1) ? argv[1] : "all";
+    size_t n = (argc > 2) ? strtoul(argv[2], NULL, 10) : 200000;
+
+    if(which == "all" || which == "filter") benchFilter(n);
+    if(which == "all" || which == "bplustree") benchBPlusTree(n);
+    if(which == "all" || which == "strings") benchStringKeys(n);
+    if(which == "all" || which == "tombstone") benchTombstones(n);
+    if(which == "all" || which == "batch") benchBatchInsert(n);
+    if(which == "all" || which == "aggregate") benchAggregate(n);
+    if(which == "all" || which == "interval") benchIntervals(n);
+    if(which == "all" || which == "export") benchExport(n);
+    if(which == "all" || which == "perf") benchPerf(n);
+    if(which == "all" || which == "clone") benchClone(n);
+    if(which == "all" || which == "relayout") benchRelayout(n);
+    if(which == "all" || which == "handles") benchNodeHandles(n);
+    if(which == "all" || which == "rebalance") benchRebalance(n);
+    if(which == "all" || which == "scapegoat") benchScapegoat(n);
+    if(which == "all" || which == "finger") benchFinger(n);
+    if(which == "all" || which == "hotkeys") benchHotKeys(n);
+    if(which == "all" || which == "cache") benchOrderedCache(n);
+    if(which == "all" || which == "pqueue") benchPriorityQueue(n);
+    if(which == "all" || which == "static") benchStaticTree(n);
+    if(which == "all" || which == "snapshot") benchSnapshot(n);
+    if(which == "all" || which == "counted") benchCounted(n);
+    return 0;
+}
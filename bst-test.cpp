@@ -1,11 +1,45 @@
 #include <iostream>
 #include <map>
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+#include <thread>
 #include "bst.h"
 #include "avlbst.h"
 
 using namespace std;
 
 
+// Exposes cloneFrom so the parallel path runs even on one core
+template<typename Value>
+struct ParallelCloner : public AVLTree<int,Value>
+{
+    void cloneFrom(const ParallelCloner& other, unsigned threads)
+    {
+        this->clear();
+        AVLTree<int,Value>::cloneFrom(other, threads);
+    }
+};
+
+// A value that cannot be copied on a worker thread while failOffMain is set
+std::atomic<bool> failOffMain(false);
+std::thread::id mainThread = std::this_thread::get_id();
+struct Fragile
+{
+    Fragile(int v = 0) : value(v) { }
+    Fragile(const Fragile& other) : value(other.value)
+    {
+        if(failOffMain && std::this_thread::get_id() != mainThread) throw std::runtime_error("copy failed");
+    }
+    Fragile& operator=(const Fragile& other) { value = other.value; return *this; }
+    int value;
+};
+
+std::ostream& operator<<(std::ostream& os, const Fragile& f)
+{
+    return os << f.value;
+}
+
 int main(int argc, char *argv[])
 {
     // Binary Search Tree tests
@@ -44,5 +78,245 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Membership filter tests
+    AVLTree<int,int> ft;
+    for(int i = 0; i < 100; i++) ft.insert(std::make_pair(2 * i, i));
+    ft.attachFilter(100, 0.01);
+    ft.remove(10);
+    ft.insert(std::make_pair(301, 301));
+    int found = 0;
+    for(int i = 0; i < 400; i++) {
+        if(ft.find(i) != ft.end()) found++;
+    }
+    cout << "\nFiltered AVLTree size: " << ft.size() << ", found: " << found << endl;
+
+    // Batch insert tests
+    AVLTree<int,int> bat;
+    for(int i = 0; i < 50; i++) bat.insert(std::make_pair(3 * i, i));
+    std::vector<std::pair<int,int> > batch;
+    for(int i = 0; i < 200; i++) batch.push_back(std::make_pair((i * 37) % 150, -i));
+    bat.insert_batch(batch.begin(), batch.end(), 4);
+    bool ordered = true;
+    int expected = 0;
+    for(AVLTree<int,int>::iterator it = bat.begin(); it != bat.end(); ++it, ++expected) {
+        if(it->first != expected) ordered = false;
+    }
+    cout << "Batch inserted AVLTree size: " << bat.size() << ", ordered: " << ordered
+         << ", balanced: " << bat.isBalanced() << ", bat[1] = " << bat[1] << endl;
+
+    // A node that fails to copy on a worker thread surfaces as an exception
+    AVLTree<int,Fragile> fragile;
+    for(int i = 0; i < 100; i++) fragile.insert(std::make_pair(2 * i, Fragile(i)));
+    std::vector<std::pair<int,Fragile> > fresh;
+    for(int i = 0; i < 4000; i++) fresh.push_back(std::make_pair(2 * i + 1, Fragile(i)));
+    failOffMain = true;
+    try {
+        fragile.insert_batch(fresh.begin(), fresh.end(), 4);
+        cout << "Failing batch did not throw" << endl;
+    }
+    catch(std::runtime_error& e) {
+        cout << "Failing batch: " << e.what() << ", size still " << fragile.size()
+             << ", balanced: " << fragile.isBalanced() << endl;
+    }
+    failOffMain = false;
+
+    // Copy and move tests
+    AVLTree<int,int> copy(bat);
+    bat.remove(1);
+    copy.insert(std::make_pair(1000, 1000));
+    cout << "Copy size: " << copy.size() << ", original size: " << bat.size()
+         << ", copy[1] = " << copy[1] << ", balanced: " << copy.isBalanced() << endl;
+    copy = bat;
+    cout << "Assigned copy has 1: " << (copy.find(1) != copy.end()) << ", size: " << copy.size() << endl;
+    AVLTree<int,int> moved(std::move(copy));
+    cout << "Moved size: " << moved.size() << ", source size: " << copy.size() << endl;
+
+    // A large tree cloned on four threads whatever the machine
+    ParallelCloner<int> big;
+    for(int i = 0; i < 100000; i++) big.insert(std::make_pair((i * 7919) % 100000, i));
+    ParallelCloner<int> bigCopy;
+    bigCopy.cloneFrom(big, 4);
+    bool same = bigCopy.size() == big.size() && bigCopy.isBalanced();
+    AVLTree<int,int>::iterator a = big.begin(), b = bigCopy.begin();
+    for(; same && a != big.end(); ++a, ++b) same = (b != bigCopy.end() && a->first == b->first && a->second == b->second);
+    for(int i = 0; i < 100000; i += 2) bigCopy.remove(i);
+    cout << "Parallel clone matches: " << same << ", after 50000 removes: " << bigCopy.size()
+         << " balanced " << bigCopy.isBalanced() << endl;
+
+    // A clone whose workers fail leaves the copy empty and rethrows
+    ParallelCloner<Fragile> fragileBig;
+    for(int i = 0; i < 70000; i++) fragileBig.insert(std::make_pair(i, Fragile(i)));
+    ParallelCloner<Fragile> fragileCopy;
+    failOffMain = true;
+    try {
+        fragileCopy.cloneFrom(fragileBig, 4);
+        cout << "Failing clone did not throw" << endl;
+    }
+    catch(std::runtime_error& e) {
+        cout << "Failing clone: " << e.what() << ", copy size " << fragileCopy.size()
+             << ", empty: " << fragileCopy.empty() << endl;
+    }
+    failOffMain = false;
+    fragileCopy.cloneFrom(fragileBig, 4);
+    cout << "Retried clone size: " << fragileCopy.size() << ", balanced: " << fragileCopy.isBalanced() << endl;
+
+    // Relayout in slices, with inserts between them, then one cut short by a remove
+    big.beginCompactLayout();
+    int steps = 0;
+    for(int i = 0; !big.stepCompactLayout(4096); i++, steps++)
+        big.insert(std::make_pair(100000 + i, i));
+    bool intact = big.size() == 100000 + (size_t)steps && big.isBalanced();
+    expected = 0;
+    for(AVLTree<int,int>::iterator it = big.begin(); intact && it != big.end(); ++it, ++expected)
+        intact = (it->first == expected);
+    big.beginCompactLayout();
+    big.stepCompactLayout(1000);
+    big.remove(5);
+    cout << "Relaid out in " << steps + 1 << " steps, intact: " << intact
+         << ", done after a remove: " << big.stepCompactLayout(1) << ", has 5: " << (big.find(5) != big.end())
+         << ", has 6: " << (big.find(6) != big.end()) << endl;
+    big.compactLayout();
+    cout << "Relaid out again, balanced: " << big.isBalanced() << ", size: " << big.size() << endl;
+
+    // Node handles: the same node moves between trees
+    AVLTree<int,int> left, right;
+    for(int i = 0; i < 20; i++) left.insert(std::make_pair(i, i * i));
+    for(int i = 15; i < 30; i++) right.insert(std::make_pair(i, -i));
+    const int* address = &left.find(7)->second;
+    AVLTree<int,int>::node_type handle = left.extract(7);
+    cout << "Extracted " << handle.key() << ": " << handle.mapped() << ", left size: " << left.size()
+         << ", left has 7: " << (left.find(7) != left.end()) << endl;
+    handle.mapped() = 700;
+    bool linked = right.insert(std::move(handle));
+    cout << "Linked: " << linked << ", handle empty: " << handle.empty() << ", same node: "
+         << (&right.find(7)->second == address) << ", right[7] = " << right[7] << endl;
+    AVLTree<int,int>::node_type clash = left.extract(left.find(16));
+    cout << "Clashing insert: " << right.insert(std::move(clash)) << ", handle kept: " << (bool)clash << endl;
+    size_t merged = right.merge(left);
+    cout << "Merged " << merged << ", left keeps " << left.size() << " (" << left.begin()->first << " ..."
+         << "), right size: " << right.size() << ", balanced: " << right.isBalanced() << endl;
+    AVLTree<int,int> copied(right);
+    AVLTree<int,int>::node_type fromSlab = copied.extract(copied.begin());
+    copied.clear();
+    cout << "Handle from a copy outlives it: " << fromSlab.key() << ": " << fromSlab.mapped() << endl;
+
+    // Day-Stout-Warren rebalance of a degenerate tree, and auto mode
+    BinarySearchTree<int,int> chain;
+    for(int i = 0; i < 1000; i++) chain.insert(std::make_pair(i, -i));
+    bool wasBalanced = chain.isBalanced();
+    BinarySearchTree<int,int>::iterator smallest = chain.begin();
+    chain.rebalance();
+    bool inOrder = (chain.begin() == smallest);
+    expected = 0;
+    for(BinarySearchTree<int,int>::iterator it = chain.begin(); it != chain.end(); ++it, ++expected)
+        inOrder = inOrder && it->first == expected && it->second == -expected;
+    cout << "Chain balanced before: " << wasBalanced << ", after rebalance: " << chain.isBalanced()
+         << ", in order: " << inOrder << ", chain[999] = " << chain[999] << endl;
+
+    BinarySearchTree<int,int> growing;
+    growing.setAutoRebalance(2);
+    for(int i = 0; i < 20000; i++) growing.insert(std::make_pair(i, i));
+    size_t deepest = 0;
+    for(BinarySearchTree<int,int>::iterator it = growing.begin(); it != growing.end(); ++it) {
+        size_t depth = 0;
+        for(const Node<int,int>* n = growing.getRoot(); n != NULL && n->getKey() != it->first; depth++)
+            n = (it->first < n->getKey()) ? n->getLeft() : n->getRight();
+        deepest = std::max(deepest, depth);
+    }
+    cout << "Auto-rebalanced sorted inserts: " << growing.size() << " items, deepest " << deepest
+         << (deepest < 1000 ? " (bounded)" : " (degenerate)") << endl;
+
+    // Deep finds leave the tree alone; the rebuild they call for waits
+    // for the next change
+    BinarySearchTree<int,int> searched;
+    for(int i = 0; i < 2000; i++) searched.insert(std::make_pair(i, i));
+    searched.setAutoRebalance(2);
+    const BinarySearchTree<int,int>& view = searched;
+    for(int i = 0; i < 2000; i++) view.find(1999);
+    bool untouched = !searched.isBalanced();
+    searched.insert(std::make_pair(-1, -1));
+    cout << "Finds left the chain alone: " << untouched << ", balanced after the next insert: "
+         << searched.isBalanced() << endl;
+
+    // Hot-key cache: entries go away with their nodes
+    AVLTree<int,int> hot;
+    for(int i = 0; i < 2000; i++) hot.insert(std::make_pair(i, i));
+    hot.attachHotKeyCache(64);
+    map<int,int> hotReference;
+    for(int i = 0; i < 2000; i++) hotReference[i] = i;
+    bool hotOk = true;
+    for(int i = 0; hotOk && i < 50000; i++) {
+        int key = (i % 7 == 0) ? (i * 31) % 2000 : (i % 16);
+        if(i % 97 == 0) {
+            hot.remove(key);
+            hotReference.erase(key);
+        }
+        else if(i % 101 == 0) {
+            AVLTree<int,int>::node_type moved = hot.extract(key);
+            hotReference.erase(key);
+        }
+        else if(i % 89 == 0) {
+            hot.insert(std::make_pair(key, -i));
+            hotReference[key] = -i;
+        }
+        else if(i == 25000)
+            hot.compactLayout();
+        AVLTree<int,int>::iterator it = hot.find(key);
+        hotOk = hotReference.count(key) == 1 ? (it != hot.end() && it->second == hotReference[key]) : it == hot.end();
+    }
+    cout << "Hot-key cache matches: " << hotOk << ", hits: " << hot.hotKeyCache()->hits()
+         << ", misses: " << hot.hotKeyCache()->misses() << endl;
+    hot.clear();
+    hot.insert(std::make_pair(3, 33));
+    cout << "After clear, find(3): " << hot.find(3)->second << ", find(4) is end: " << (hot.find(4) == hot.end()) << endl;
+
+    // Cached ends and pops, against std::map
+    AVLTree<int,int> queue;
+    BinarySearchTree<int,int> plainQueue;
+    map<int,int> queueReference;
+    bool endsOk = true;
+    for(int i = 0; endsOk && i < 60000; i++) {
+        int key = (i * 7919 + i / 3) % 20000;
+        int op = i % 7;
+        if(op < 3) {
+            queue.insert(std::make_pair(key, i));
+            plainQueue.insert(std::make_pair(key, i));
+            queueReference[key] = i;
+        }
+        else if(queueReference.empty())
+            continue;
+        else if(op == 3) {
+            queue.pop_min();
+            plainQueue.pop_min();
+            queueReference.erase(queueReference.begin());
+        }
+        else if(op == 4) {
+            queue.pop_max();
+            plainQueue.pop_max();
+            queueReference.erase(--queueReference.end());
+        }
+        else {
+            queue.remove(key);
+            plainQueue.remove(key);
+            queueReference.erase(key);
+        }
+        if(queueReference.empty())
+            endsOk = queue.empty() && plainQueue.empty();
+        else
+            endsOk = queue.front() == *queueReference.begin() && queue.back() == *queueReference.rbegin() &&
+                     plainQueue.front() == queue.front() && plainQueue.back() == queue.back() &&
+                     queue.begin()->first == queueReference.begin()->first;
+    }
+    cout << "Ends match: " << endsOk << ", size " << queue.size() << ", balanced " << queue.isBalanced() << endl;
+    while(!queue.empty()) queue.pop_min();
+    bool threw = false;
+    try {
+        queue.front();
+    }
+    catch(std::out_of_range&) {
+        threw = true;
+    }
+    cout << "Drained by pop_min, front() throws: " << threw << endl;
+
     return 0;
 }
@@ -7,6 +7,13 @@
 #include <utility>
 #include <functional>
 #include <algorithm>
+#include <cmath>
+#include <new>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "bloom-filter.h"
+#include "hot-key-cache.h"
 
 /**
  * A templated class for a Node in a search tree.
@@ -37,6 +44,12 @@ public:
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
 
+    // Copy-constructs this node, including any data a subclass adds, into
+    // memory of at least footprint() bytes. Used to clone whole trees; the
+    // caller overwrites the copied links.
+    virtual Node<Key, Value>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
 protected:
     std::pair<const Key, Value> item_;
     Node<Key, Value>* parent_;
@@ -182,6 +195,18 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+template<typename Key, typename Value>
+Node<Key, Value>* Node<Key, Value>::cloneAt(void* where) const
+{
+    return new (where) Node<Key, Value>(*this);
+}
+
+template<typename Key, typename Value>
+size_t Node<Key, Value>::footprint() const
+{
+    return sizeof(*this);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
@@ -197,15 +222,44 @@ class BinarySearchTree
 public:
     BinarySearchTree(); //TODO
     virtual ~BinarySearchTree(); //TODO
+    BinarySearchTree(const BinarySearchTree& other);
+    BinarySearchTree(BinarySearchTree&& other) noexcept;
+    BinarySearchTree& operator=(const BinarySearchTree& other);
+    BinarySearchTree& operator=(BinarySearchTree&& other) noexcept;
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
-    void clear(); //TODO
+    virtual void clear(); //TODO
     bool isBalanced() const; //TODO
+    // Rebuilds the tree into a balanced shape in O(n) time and O(1) space.
+    virtual void rebalance();
+    // Rebalance automatically once searches deeper than factor * log2(size)
+    // have cost as much as a rebuild, at the next insert or remove (finds
+    // never change the tree); 0 turns it off.
+    void setAutoRebalance(double factor);
     void print() const;
     bool empty() const;
+    virtual size_t size() const;
+    // Read-only access to the nodes for external tools such as tree-profile.h
+    const Node<Key, Value>* getRoot() const;
+    void attachFilter(size_t expectedItems, double falsePositiveRate = 0.01);
+    void detachFilter();
+    // A cache of recently found nodes in front of find and operator[]; see
+    // hot-key-cache.h. hotKeyCache() is NULL without one.
+    void attachHotKeyCache(size_t entries);
+    void detachHotKeyCache();
+    const HotKeyCache<Key, Value>* hotKeyCache() const;
+
+    // Moves every node into one block in van Emde Boas order, see below.
+    void compactLayout();
+    // The same, a slice at a time: begin plans the order, each step moves up
+    // to maxNodes nodes and returns true once nothing is left to move.
+    void beginCompactLayout();
+    bool stepCompactLayout(size_t maxNodes);
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue>& tree);
+    template<typename FKey, typename FValue>
+    friend class TreeFinger;
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -222,20 +276,36 @@ public:
     protected:
         friend class BinarySearchTree<Key, Value>;
         iterator(Node<Key,Value>* ptr);
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree);
+        void skipEmpty();
         Node<Key, Value>* current_;
+        // Set only for trees that set copiesVary_ or watchesWrites_, so
+        // plain trees step and dereference without virtual calls.
+        const BinarySearchTree<Key, Value>* tree_;
+        size_t copy_;   // which copy of current_'s item this is at
     };
 
 public:
     iterator begin() const;
     iterator end() const;
     iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
+    // The smallest and largest items in O(1), from cached end nodes; both
+    // throw std::out_of_range on an empty tree, as do the pops.
+    std::pair<const Key, Value>& front() const;
+    std::pair<const Key, Value>& back() const;
+    // Remove the smallest or largest item without searching for it, for
+    // use as a double-ended priority queue.
+    virtual void pop_min();
+    virtual void pop_max();
 
 protected:
     // Mandatory helper functions
-    Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    virtual Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value>* getSmallestNode() const;  // TODO
+    Node<Key, Value>* getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     static Node<Key, Value>* successor(Node<Key, Value>* current); // Added implementation
 
@@ -245,9 +315,89 @@ protected:
 
     // Add helper functions here
 
+    // Unlinks and frees a node that is in the tree; remove() and the pops
+    // end here, so trees with extra bookkeeping per node override this.
+    virtual void eraseNode(Node<Key, Value>* node);
+    // Keep smallest_ and largest_ current: noteLinked right after a new
+    // leaf is linked and before any rotation, noteUnlinking before a node
+    // is taken out, findExtremes after the tree is rebuilt wholesale.
+    void noteLinked(Node<Key, Value>* node);
+    void noteUnlinking(Node<Key, Value>* node);
+    void findExtremes();
+
+    // Insert and overwrite at a position already found by a search, for
+    // callers that searched on their own such as TreeFinger. insertAt links
+    // a new node below parent (or as the root) and does any rebalancing.
+    virtual Node<Key, Value>* insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item);
+    virtual void assignValue(Node<Key, Value>* node, const Value& value);
+
+    // Frees a node, whether it was allocated on its own or in a slab.
+    void destroyNode(Node<Key, Value>* node);
+    // Returns an unlinked node that can outlive this tree: node itself, or
+    // a heap copy of it if it was allocated in a slab.
+    Node<Key, Value>* detachFromSlab(Node<Key, Value>* node);
+    static Node<Key, Value>* nodeOf(const iterator& it);
+    iterator iteratorAt(Node<Key, Value>* node) const;
+    // How many items node stands for: 1 here, 0 for a node that is linked
+    // but holds nothing (a tombstone), more for a key stored several times.
+    // Iterators and the ends only ask when copiesVary_ is set.
+    virtual size_t copiesAt(const Node<Key, Value>* node) const;
+    // Called, when watchesWrites_ is set, as a reference through which
+    // node's value can be written is handed out: by operator[], front(),
+    // back() and by dereferencing this class's iterators. Does nothing here.
+    virtual void valueExposed(Node<Key, Value>* node) const;
+    Node<Key, Value>* nearestHolding(Node<Key, Value>* node, bool forward) const;
+    // Makes this (empty) tree a copy of other's nodes in one slab, using up
+    // to threads threads for large trees (0: one per hardware thread). If a
+    // node fails to copy, the tree is left empty and the exception rethrown.
+    void cloneFrom(const BinarySearchTree<Key, Value>& other, unsigned threads = 0);
+    // Destroys the copies it made before rethrowing if one fails.
+    static Node<Key, Value>* cloneSubtree(const Node<Key, Value>* src, char* mem, size_t stride);
+    static void destroySlots(char* mem, size_t count, size_t stride);
+    static size_t countNodes(const Node<Key, Value>* subtree);
+    void releaseNode(Node<Key, Value>* node);
+    // Called when a node is copied to a new address (relayout, detaching a
+    // slab node) just before the old one is freed, for trees whose nodes
+    // are linked to from outside the tree. Does nothing here.
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+    void cancelCompactLayout();
+    void rotateNodeLeft(Node<Key, Value>* node);
+    void rotateNodeRight(Node<Key, Value>* node);
+    void compressVine(size_t count);
+    void observeDepth(size_t depth) const;
+    void payRebalanceDebt();
+    static void planLayout(const std::vector<std::pair<size_t, size_t> >& children, size_t subtree, int levels,
+                           std::vector<size_t>& order, std::vector<size_t>& roots,
+                           std::vector<std::pair<size_t, int> >& stack);
+
+    // Trees with at least this many nodes are cloned on several threads.
+    static const size_t PARALLEL_CLONE_MIN = 1 << 16;
+
+    // A block of nodes allocated together by a clone. It is freed once the
+    // last of its nodes has been destroyed.
+    struct Slab {
+        char* begin;
+        char* end;
+        size_t live;
+    };
+
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    size_t size_;   // number of nodes currently linked into the tree
+    CountingBloomFilter<Key>* filter_;  // optional, rules out misses before descending
+    HotKeyCache<Key, Value>* hotCache_; // optional, finds hot keys without descending
+    Node<Key, Value>* smallest_;    // ends of the in-order sequence, NULL when empty
+    Node<Key, Value>* largest_;
+    std::vector<Slab> slabs_;
+    std::vector<Node<Key, Value>*> layoutPlan_;  // nodes in their new order, while a relayout runs
+    size_t layoutNext_;     // index in layoutPlan_ of the next node to move
+    char* layoutSlab_;      // begin of the slab they move into
+    double autoRebalance_;  // depth factor that triggers a rebalance, 0 for never
+    mutable std::atomic<size_t> rebalanceDebt_;  // levels searched beyond that depth since the last one
+    size_t departures_;     // bumped when a node is freed, moved or extracted, so cursors can tell theirs may be gone
+    size_t arrivals_;       // bumped when nodes are linked in, which changes in-order neighbours
+    bool copiesVary_;       // set by the constructors of trees that override copiesAt
+    bool watchesWrites_;    // likewise for valueExposed
 };
 
 /*
@@ -263,6 +413,21 @@ template<class Key, class Value>
 BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
 {
     current_ = ptr;
+    tree_ = NULL;
+    copy_ = 0;
+}
+
+/**
+* An iterator that asks tree how many items each node holds, starting at
+* the first item from ptr on.
+*/
+template<class Key, class Value>
+BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree)
+{
+    current_ = ptr;
+    tree_ = tree;
+    copy_ = 0;
+    skipEmpty();
 }
 
 /**
@@ -272,6 +437,8 @@ template<class Key, class Value>
 BinarySearchTree<Key, Value>::iterator::iterator()
 {
     current_ = NULL;
+    tree_ = NULL;
+    copy_ = 0;
 }
 
 /**
@@ -280,6 +447,7 @@ BinarySearchTree<Key, Value>::iterator::iterator()
 template<class Key, class Value>
 std::pair<const Key,Value>& BinarySearchTree<Key, Value>::iterator::operator*() const
 {
+    if(tree_ != NULL) tree_->valueExposed(current_);
     return current_->getItem();
 }
 
@@ -289,6 +457,7 @@ std::pair<const Key,Value>& BinarySearchTree<Key, Value>::iterator::operator*()
 template<class Key, class Value>
 std::pair<const Key,Value>* BinarySearchTree<Key, Value>::iterator::operator->() const
 {
+    if(tree_ != NULL) tree_->valueExposed(current_);
     return &(current_->getItem());
 }
 
@@ -298,7 +467,7 @@ std::pair<const Key,Value>* BinarySearchTree<Key, Value>::iterator::operator->()
 template<class Key, class Value>
 bool BinarySearchTree<Key, Value>::iterator::operator==(const iterator& rhs) const
 {
-    return current_ == rhs.current_;
+    return current_ == rhs.current_ && copy_ == rhs.copy_;
 }
 
 /**
@@ -307,7 +476,7 @@ bool BinarySearchTree<Key, Value>::iterator::operator==(const iterator& rhs) con
 template<class Key, class Value>
 bool BinarySearchTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
 {
-    return current_ != rhs.current_;
+    return !(*this == rhs);
 }
 
 /**
@@ -316,10 +485,25 @@ bool BinarySearchTree<Key, Value>::iterator::operator!=(const iterator& rhs) con
 template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
 {
+    if(tree_ != NULL && ++copy_ < tree_->copiesAt(current_))
+        return *this;
     current_ = BinarySearchTree<Key, Value>::successor(current_);
+    copy_ = 0;
+    if(tree_ != NULL)
+        skipEmpty();
     return *this;
 }
 
+/**
+* Steps over nodes that hold no item.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::iterator::skipEmpty()
+{
+    while(current_ != NULL && tree_->copiesAt(current_) == 0)
+        current_ = BinarySearchTree<Key, Value>::successor(current_);
+}
+
 /*
 -------------------------------------------------------------
 End implementations for the BinarySearchTree::iterator class.
@@ -339,6 +523,19 @@ template<class Key, class Value>
 BinarySearchTree<Key, Value>::BinarySearchTree() 
 {
     root_ = NULL;
+    size_ = 0;
+    filter_ = NULL;
+    hotCache_ = NULL;
+    smallest_ = NULL;
+    largest_ = NULL;
+    layoutNext_ = 0;
+    layoutSlab_ = NULL;
+    autoRebalance_ = 0;
+    rebalanceDebt_ = 0;
+    departures_ = 0;
+    arrivals_ = 0;
+    copiesVary_ = false;
+    watchesWrites_ = false;
 }
 
 /**
@@ -348,6 +545,100 @@ template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
     clear();
+    delete filter_;
+    delete hotCache_;
+}
+
+/**
+* Copies other's shape, items and per-node data (such as AVL balance) in
+* O(n), without any comparisons or rebalancing.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other) :
+    root_(NULL), size_(0), filter_(NULL), hotCache_(NULL), smallest_(NULL), largest_(NULL), layoutNext_(0), layoutSlab_(NULL),
+    autoRebalance_(other.autoRebalance_), rebalanceDebt_(0), departures_(0), arrivals_(0), copiesVary_(false), watchesWrites_(false)
+{
+    if(other.filter_ != NULL) filter_ = new CountingBloomFilter<Key>(*other.filter_);
+    if(other.hotCache_ != NULL) hotCache_ = new HotKeyCache<Key, Value>(other.hotCache_->capacity());
+    try {
+        cloneFrom(other);
+    }
+    catch(...) {
+        delete filter_;
+        delete hotCache_;
+        throw;
+    }
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other) noexcept :
+    root_(other.root_), size_(other.size_), filter_(other.filter_), hotCache_(other.hotCache_),
+    smallest_(other.smallest_), largest_(other.largest_), slabs_(std::move(other.slabs_)),
+    layoutPlan_(std::move(other.layoutPlan_)), layoutNext_(other.layoutNext_), layoutSlab_(other.layoutSlab_),
+    autoRebalance_(other.autoRebalance_), rebalanceDebt_(other.rebalanceDebt_.load()), departures_(0), arrivals_(0), copiesVary_(false), watchesWrites_(false)
+{
+    other.departures_++;
+    other.root_ = NULL;
+    other.size_ = 0;
+    other.filter_ = NULL;
+    other.hotCache_ = NULL;
+    other.smallest_ = NULL;
+    other.largest_ = NULL;
+    other.slabs_.clear();
+    other.layoutPlan_.clear();
+    other.layoutNext_ = 0;
+    other.layoutSlab_ = NULL;
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+    if(this == &other) return *this;
+    clear();
+    delete filter_;
+    filter_ = NULL;
+    if(other.filter_ != NULL) filter_ = new CountingBloomFilter<Key>(*other.filter_);
+    delete hotCache_;
+    hotCache_ = NULL;
+    if(other.hotCache_ != NULL) hotCache_ = new HotKeyCache<Key, Value>(other.hotCache_->capacity());
+    cloneFrom(other);
+    autoRebalance_ = other.autoRebalance_;
+    rebalanceDebt_ = 0;
+    return *this;
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other) noexcept
+{
+    if(this == &other) return *this;
+    clear();
+    delete filter_;
+    delete hotCache_;
+    root_ = other.root_;
+    size_ = other.size_;
+    filter_ = other.filter_;
+    hotCache_ = other.hotCache_;
+    smallest_ = other.smallest_;
+    largest_ = other.largest_;
+    slabs_ = std::move(other.slabs_);
+    layoutPlan_ = std::move(other.layoutPlan_);
+    layoutNext_ = other.layoutNext_;
+    layoutSlab_ = other.layoutSlab_;
+    autoRebalance_ = other.autoRebalance_;
+    rebalanceDebt_ = other.rebalanceDebt_.load();
+    departures_++;
+    other.departures_++;
+    other.root_ = NULL;
+    other.size_ = 0;
+    other.filter_ = NULL;
+    other.hotCache_ = NULL;
+    other.smallest_ = NULL;
+    other.largest_ = NULL;
+    other.slabs_.clear();
+    other.layoutPlan_.clear();
+    other.layoutNext_ = 0;
+    other.layoutSlab_ = NULL;
+    return *this;
 }
 
 /**
@@ -356,7 +647,22 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 template<class Key, class Value>
 bool BinarySearchTree<Key, Value>::empty() const
 {
-    return root_ == NULL;
+    return size() == 0;
+}
+
+/**
+ * Returns the number of items in the tree
+*/
+template<class Key, class Value>
+size_t BinarySearchTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+const Node<Key, Value>* BinarySearchTree<Key, Value>::getRoot() const
+{
+    return root_;
 }
 
 template<typename Key, class Value>
@@ -366,13 +672,62 @@ void BinarySearchTree<Key, Value>::print() const
     std::cout << "\n";
 }
 
+/**
+* Attaches a counting Bloom filter sized for expectedItems keys at the given
+* false positive rate. Lookups of keys the filter rules out return without
+* descending the tree. Items already in the tree are added to the filter.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::attachFilter(size_t expectedItems, double falsePositiveRate)
+{
+    delete filter_;
+    filter_ = new CountingBloomFilter<Key>(std::max(expectedItems, size_), falsePositiveRate);
+    for(Node<Key, Value>* n = getSmallestNode(); n != NULL; n = successor(n))
+        filter_->add(n->getKey());
+}
+
+/**
+* Removes the membership filter, if any.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::detachFilter()
+{
+    delete filter_;
+    filter_ = NULL;
+}
+
+/**
+* Attaches an empty hot-key cache with room for entries nodes (rounded up
+* to a power of two). Successful lookups fill it; nodes are dropped from it
+* before they are freed or extracted.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::attachHotKeyCache(size_t entries)
+{
+    delete hotCache_;
+    hotCache_ = new HotKeyCache<Key, Value>(entries);
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::detachHotKeyCache()
+{
+    delete hotCache_;
+    hotCache_ = NULL;
+}
+
+template<class Key, class Value>
+const HotKeyCache<Key, Value>* BinarySearchTree<Key, Value>::hotKeyCache() const
+{
+    return hotCache_;
+}
+
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
 template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::begin() const
 {
-    return iterator(getSmallestNode());
+    return iteratorAt(getSmallestNode());
 }
 
 /**
@@ -392,7 +747,27 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::find(const Key & k) const
 {
     Node<Key, Value>* curr = internalFind(k);
-    return iterator(curr);
+    return iteratorAt(curr);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than k
+* or the end iterator if every key in the tree is smaller than k
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::lower_bound(const Key & k) const
+{
+    Node<Key, Value>* current = root_;
+    Node<Key, Value>* candidate = NULL;
+    while(current != NULL) {
+        if(current->getKey() < k)
+            current = current->getRight();
+        else {
+            candidate = current;
+            current = current->getLeft();
+        }
+    }
+    return iteratorAt(candidate);
 }
 
 /**
@@ -404,6 +779,7 @@ Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
 {
     Node<Key, Value>* curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
+    if(watchesWrites_) valueExposed(curr);
     return curr->getValue();
 }
 template<class Key, class Value>
@@ -423,30 +799,56 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 template<class Key, class Value>
 void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
-    Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, NULL);
-    if(root_ == NULL) {
-        root_ = newNode;
-        return;
-    }
     Node<Key, Value>* current = root_;
     Node<Key, Value>* parent = NULL;
+    bool asLeftChild = false;
+    size_t depth = 0;
     while(current != NULL) {
         parent = current;
-        if(keyValuePair.first < current->getKey())
+        depth++;
+        asLeftChild = keyValuePair.first < current->getKey();
+        if(asLeftChild)
             current = current->getLeft();
         else if(keyValuePair.first > current->getKey())
             current = current->getRight();
         else {
             current->setValue(keyValuePair.second);
-            delete newNode;
+            observeDepth(depth);
+            payRebalanceDebt();
             return;
         }
     }
-    newNode->setParent(parent);
-    if(keyValuePair.first < parent->getKey())
+    BinarySearchTree<Key, Value>::insertAt(parent, asLeftChild, keyValuePair);
+    observeDepth(depth);
+    payRebalanceDebt();
+}
+
+/**
+* Links a new node for item as the left or right child of parent, or as
+* the root when parent is NULL; the key must belong exactly there.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::insertAt(Node<Key, Value>* parent, bool asLeftChild,
+                                                         const std::pair<const Key, Value>& item)
+{
+    Node<Key, Value>* newNode = new Node<Key, Value>(item.first, item.second, parent);
+    if(parent == NULL)
+         root_ = newNode;
+    else if(asLeftChild)
          parent->setLeft(newNode);
     else
          parent->setRight(newNode);
+    noteLinked(newNode);
+    size_++;
+    arrivals_++;
+    if(filter_ != NULL) filter_->add(item.first);
+    return newNode;
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::assignValue(Node<Key, Value>* node, const Value& value)
+{
+    node->setValue(value);
 }
 
 /**
@@ -457,8 +859,15 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 template<typename Key, class Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
+    payRebalanceDebt();
     Node<Key, Value>* nodeToRemove = internalFind(key);
-    if(nodeToRemove == NULL) return;
+    if(nodeToRemove != NULL) eraseNode(nodeToRemove);
+}
+
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::eraseNode(Node<Key, Value>* nodeToRemove)
+{
+    noteUnlinking(nodeToRemove);
     if(nodeToRemove->getLeft() != NULL && nodeToRemove->getRight() != NULL) {
         Node<Key, Value>* pred = predecessor(nodeToRemove);
         nodeSwap(nodeToRemove, pred);
@@ -473,7 +882,80 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
          if(parent->getLeft() == nodeToRemove) parent->setLeft(child);
          else                                  parent->setRight(child);
     }
-    delete nodeToRemove;
+    if(filter_ != NULL) filter_->remove(nodeToRemove->getKey());
+    destroyNode(nodeToRemove);
+    size_--;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& BinarySearchTree<Key, Value>::front() const
+{
+    Node<Key, Value>* node = nearestHolding(smallest_, true);
+    if(node == NULL) throw std::out_of_range("Empty tree");
+    if(watchesWrites_) valueExposed(node);
+    return node->getItem();
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& BinarySearchTree<Key, Value>::back() const
+{
+    Node<Key, Value>* node = nearestHolding(largest_, false);
+    if(node == NULL) throw std::out_of_range("Empty tree");
+    if(watchesWrites_) valueExposed(node);
+    return node->getItem();
+}
+
+/**
+* The smallest node has no left child, so it comes out without a swap and
+* any rebalancing starts right at its parent. Trees whose nodes hold
+* several copies override the pops to take out just one.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::pop_min()
+{
+    Node<Key, Value>* node = nearestHolding(smallest_, true);
+    if(node == NULL) throw std::out_of_range("Empty tree");
+    eraseNode(node);
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::pop_max()
+{
+    Node<Key, Value>* node = nearestHolding(largest_, false);
+    if(node == NULL) throw std::out_of_range("Empty tree");
+    eraseNode(node);
+}
+
+/**
+* A new leaf is a new end exactly when it hangs off the outer side of the
+* old one; a new root is both.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::noteLinked(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    if(parent == NULL) {
+        smallest_ = largest_ = node;
+        return;
+    }
+    if(parent == smallest_ && parent->getLeft() == node)  smallest_ = node;
+    if(parent == largest_ && parent->getRight() == node)  largest_ = node;
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::noteUnlinking(Node<Key, Value>* node)
+{
+    if(node == smallest_) smallest_ = successor(node);
+    if(node == largest_)  largest_ = predecessor(node);
+}
+
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::findExtremes()
+{
+    smallest_ = largest_ = root_;
+    if(root_ == NULL) return;
+    while(smallest_->getLeft() != NULL) smallest_ = smallest_->getLeft();
+    while(largest_->getRight() != NULL) largest_ = largest_->getRight();
 }
 
 template<class Key, class Value>
@@ -524,27 +1006,526 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::successor(Node<Key, Value>* curr
 template<typename Key, class Value>
 void BinarySearchTree<Key, Value>::clear()
 {
-    std::function<void(Node<Key, Value>*)> clearRecursive = [&](Node<Key, Value>* node) {
-        if(node == NULL) return;
-        clearRecursive(node->getLeft());
-        clearRecursive(node->getRight());
-        delete node;
-    };
-    clearRecursive(root_);
+    // Post-order walk along parent links, so no depth is too deep
+    Node<Key, Value>* node = root_;
+    while(node != NULL) {
+        if(node->getLeft() != NULL)
+            node = node->getLeft();
+        else if(node->getRight() != NULL)
+            node = node->getRight();
+        else {
+            Node<Key, Value>* parent = node->getParent();
+            if(parent != NULL) {
+                if(parent->getLeft() == node) parent->setLeft(NULL);
+                else                          parent->setRight(NULL);
+            }
+            destroyNode(node);
+            node = parent;
+        }
+    }
     root_ = NULL;
+    smallest_ = largest_ = NULL;
+    size_ = 0;
+    if(filter_ != NULL) filter_->clear();
+}
+
+/**
+* Frees a node. A relayout in progress may still have the node in its plan,
+* so it is abandoned; the nodes it already moved stay where they are.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroyNode(Node<Key, Value>* node)
+{
+    if(layoutSlab_ != NULL) cancelCompactLayout();
+    releaseNode(node);
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::releaseNode(Node<Key, Value>* node)
+{
+    departures_++;
+    if(hotCache_ != NULL) hotCache_->forget(node);
+    const char* p = reinterpret_cast<const char*>(node);
+    std::less<const char*> before;
+    for(size_t i = 0; i < slabs_.size(); i++) {
+        if(before(p, slabs_[i].begin) || !before(p, slabs_[i].end)) continue;
+        node->~Node();
+        if(--slabs_[i].live == 0) {
+            ::operator delete(slabs_[i].begin);
+            slabs_.erase(slabs_.begin() + i);
+        }
+        return;
+    }
+    delete node;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
 }
 
 /**
-* A helper function to find the smallest node in the tree.
+* Slab nodes are freed with their slab, so one leaving the tree for good is
+* copied out first.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::detachFromSlab(Node<Key, Value>* node)
+{
+    const char* p = reinterpret_cast<const char*>(node);
+    std::less<const char*> before;
+    for(size_t i = 0; i < slabs_.size(); i++) {
+        if(before(p, slabs_[i].begin) || !before(p, slabs_[i].end)) continue;
+        Node<Key, Value>* copy = node->cloneAt(::operator new(node->footprint()));
+        if(smallest_ == node) smallest_ = copy;
+        if(largest_ == node)  largest_ = copy;
+        nodeMoved(node, copy);
+        releaseNode(node);
+        return copy;
+    }
+    return node;
+}
+
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nodeOf(const iterator& it)
+{
+    return it.current_;
+}
+
+/**
+* An iterator at node, or at the first item after it if node holds none.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::iteratorAt(Node<Key, Value>* node) const
+{
+    if(copiesVary_ || watchesWrites_) return iterator(node, this);
+    return iterator(node);
+}
+
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::copiesAt(const Node<Key, Value>* node) const
+{
+    return 1;
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::valueExposed(Node<Key, Value>* node) const
+{
+}
+
+/**
+* Returns node, or the nearest node after it (before it if !forward) that
+* holds an item; NULL if there is none.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::nearestHolding(Node<Key, Value>* node, bool forward) const
+{
+    if(copiesVary_) {
+        while(node != NULL && copiesAt(node) == 0)
+            node = forward ? successor(node) : predecessor(node);
+    }
+    return node;
+}
+
+/**
+* Restores locality to a tree whose nodes were allocated one at a time and
+* have scattered across the heap: the nodes are moved into one block, laid
+* out in van Emde Boas order, and the links to them rewired. The shape of
+* the tree, its items and any per-node data are unchanged.
+*
+* In van Emde Boas order the top half of the levels is laid out first and
+* each subtree hanging below it follows in one piece, recursively, so any
+* root-to-leaf search touches O(log_B n) cache lines or pages for whatever
+* block size B, instead of about one per level.
+*
+* Moving a node invalidates iterators and pointers to it.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::compactLayout()
+{
+    beginCompactLayout();
+    while(!stepCompactLayout(layoutPlan_.size())) { }
+}
+
+/**
+* Plans a relayout and reserves its block; no node moves yet. Planning takes
+* one O(n) pass over the nodes, without writing to them, and then works on
+* index arrays. Any relayout already in progress is abandoned.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::beginCompactLayout()
+{
+    if(layoutSlab_ != NULL) cancelCompactLayout();
+    if(root_ == NULL) return;
+
+    // Copy the shape into index arrays in pre-order, which are much quicker
+    // to walk several times than the scattered nodes
+    std::vector<Node<Key, Value>*> nodes;
+    std::vector<std::pair<size_t, size_t> > children;   // indices, 0 for none
+    nodes.reserve(size_);
+    children.reserve(size_);
+    struct Pending {
+        Node<Key, Value>* node;
+        int depth;
+        size_t* link;   // where the parent keeps this node's index
+    };
+    int levels = 0;
+    std::vector<Pending> stack;
+    Pending first = { root_, 1, NULL };
+    stack.push_back(first);
+    while(!stack.empty()) {
+        Pending at = stack.back();
+        stack.pop_back();
+        if(at.link != NULL) *at.link = nodes.size();
+        nodes.push_back(at.node);
+        children.push_back(std::make_pair((size_t)0, (size_t)0));
+        levels = std::max(levels, at.depth);
+        if(at.node->getRight() != NULL) {
+            Pending right = { at.node->getRight(), at.depth + 1, &children.back().second };
+            stack.push_back(right);
+        }
+        if(at.node->getLeft() != NULL) {
+            Pending left = { at.node->getLeft(), at.depth + 1, &children.back().first };
+            stack.push_back(left);
+        }
+    }
+    std::vector<size_t> order, roots;
+    std::vector<std::pair<size_t, int> > dfs;
+    order.reserve(nodes.size());
+    planLayout(children, 0, levels, order, roots, dfs);
+    layoutPlan_.resize(order.size());
+    for(size_t i = 0; i < order.size(); i++) layoutPlan_[i] = nodes[order[i]];
+
+    size_t stride = root_->footprint();
+    Slab slab;
+    slab.begin = static_cast<char*>(::operator new(layoutPlan_.size() * stride));
+    slab.end = slab.begin + layoutPlan_.size() * stride;
+    slab.live = 0;
+    slabs_.push_back(slab);
+    layoutSlab_ = slab.begin;
+    layoutNext_ = 0;
+}
+
+/**
+* Moves the next maxNodes planned nodes into their slots. The tree is
+* complete and valid between steps and may be searched or added to; new
+* nodes are simply left where they are. Removing a node abandons the rest
+* of the relayout.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::stepCompactLayout(size_t maxNodes)
+{
+    if(layoutSlab_ == NULL) return true;
+    size_t stride = root_->footprint();
+    size_t stop = std::min(layoutPlan_.size(), layoutNext_ + maxNodes);
+    size_t moved = stop - layoutNext_;
+    for(; layoutNext_ < stop; layoutNext_++) {
+        Node<Key, Value>* node = layoutPlan_[layoutNext_];
+        Node<Key, Value>* copy = node->cloneAt(layoutSlab_ + layoutNext_ * stride);
+        Node<Key, Value>* parent = node->getParent();
+        if(parent == NULL)                  root_ = copy;
+        else if(parent->getLeft() == node)  parent->setLeft(copy);
+        else                                parent->setRight(copy);
+        if(node->getLeft() != NULL)  node->getLeft()->setParent(copy);
+        if(node->getRight() != NULL) node->getRight()->setParent(copy);
+        if(smallest_ == node) smallest_ = copy;
+        if(largest_ == node)  largest_ = copy;
+        nodeMoved(node, copy);
+        // Planned nodes all predate the new slab, so this never frees it
+        releaseNode(node);
+    }
+    for(size_t i = 0; i < slabs_.size(); i++) {
+        if(slabs_[i].begin == layoutSlab_) slabs_[i].live += moved;
+    }
+    if(layoutNext_ < layoutPlan_.size()) return false;
+    // Keeping the plan's memory for the next relayout saves a slice here:
+    // freeing it would make malloc consolidate every node just freed
+    layoutPlan_.clear();
+    layoutNext_ = 0;
+    layoutSlab_ = NULL;
+    return true;
+}
+
+/**
+* Drops the rest of a relayout, freeing its block if nothing was moved in.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cancelCompactLayout()
+{
+    for(size_t i = 0; i < slabs_.size(); i++) {
+        if(slabs_[i].begin == layoutSlab_ && slabs_[i].live == 0) {
+            ::operator delete(slabs_[i].begin);
+            slabs_.erase(slabs_.begin() + i);
+            break;
+        }
+    }
+    std::vector<Node<Key, Value>*>().swap(layoutPlan_);
+    layoutNext_ = 0;
+    layoutSlab_ = NULL;
+}
+
+/**
+* Helper function: planLayout
+*
+* Appends the indices of the nodes under subtree that lie less than levels
+* levels down, in van Emde Boas order: the top levels/2 levels, then each
+* subtree rooted just below them, left to right, laid out the same way.
+* Index 0 is the root, so it never appears as a child. Each call keeps
+* the subtree roots below its top levels at the end of roots while it
+* lays them out; stack is only scratch space for finding them.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::planLayout(const std::vector<std::pair<size_t, size_t> >& children, size_t subtree,
+                                              int levels, std::vector<size_t>& order, std::vector<size_t>& roots,
+                                              std::vector<std::pair<size_t, int> >& stack)
+{
+    if(levels == 1) {
+        order.push_back(subtree);
+        return;
+    }
+    int top = levels / 2;
+    planLayout(children, subtree, top, order, roots, stack);
+
+    // Depth-first down to depth top, keeping the nodes found there in order
+    size_t first = roots.size();
+    stack.push_back(std::make_pair(subtree, 0));
+    while(!stack.empty()) {
+        std::pair<size_t, int> at = stack.back();
+        stack.pop_back();
+        if(at.second == top) {
+            roots.push_back(at.first);
+            continue;
+        }
+        if(children[at.first].second != 0) stack.push_back(std::make_pair(children[at.first].second, at.second + 1));
+        if(children[at.first].first != 0)  stack.push_back(std::make_pair(children[at.first].first, at.second + 1));
+    }
+    size_t last = roots.size();
+    for(size_t i = first; i < last; i++)
+        planLayout(children, roots[i], levels - top, order, roots, stack);
+    roots.resize(first);
+}
+
+/**
+* Copies other's nodes into one slab, in pre-order. Large trees have their
+* top levels copied here and the subtrees below them counted and copied on
+* separate threads, each into its own stretch of the slab. A worker keeps
+* the exception of a failed copy for this thread to rethrow once all have
+* joined, after destroying every copy made and freeing the slab.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::cloneFrom(const BinarySearchTree<Key, Value>& other, unsigned threads)
+{
+    if(other.root_ == NULL) return;
+    size_t stride = other.root_->footprint();
+    if(threads == 0) threads = std::thread::hardware_concurrency();
+
+    if(threads <= 1 || other.size_ < PARALLEL_CLONE_MIN) {
+        Slab slab;
+        slab.begin = static_cast<char*>(::operator new(other.size_ * stride));
+        slab.end = slab.begin + other.size_ * stride;
+        slab.live = other.size_;
+        slabs_.push_back(slab);
+        try {
+            root_ = cloneSubtree(other.root_, slab.begin, stride);
+        }
+        catch(...) {
+            slabs_.pop_back();
+            ::operator delete(slab.begin);
+            throw;
+        }
+        size_ = other.size_;
+        findExtremes();
+        return;
+    }
+
+    // Breadth-first down to the first level with a few subtrees per thread
+    std::vector<const Node<Key, Value>*> top;
+    std::vector<size_t> topParent;  // index in top of each node's parent
+    std::vector<const Node<Key, Value>*> level(1, other.root_);
+    std::vector<size_t> levelParent(1, (size_t)-1);
+    while(!level.empty() && level.size() < 4 * threads) {
+        std::vector<const Node<Key, Value>*> next;
+        std::vector<size_t> nextParent;
+        for(size_t i = 0; i < level.size(); i++) {
+            size_t self = top.size();
+            top.push_back(level[i]);
+            topParent.push_back(levelParent[i]);
+            if(level[i]->getLeft() != NULL)  { next.push_back(level[i]->getLeft());  nextParent.push_back(self); }
+            if(level[i]->getRight() != NULL) { next.push_back(level[i]->getRight()); nextParent.push_back(self); }
+        }
+        level.swap(next);
+        levelParent.swap(nextParent);
+    }
+
+    std::vector<size_t> offset(level.size() + 1);
+    std::vector<std::thread> workers;
+    for(unsigned t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            for(size_t j = t; j < level.size(); j += threads) offset[j + 1] = countNodes(level[j]);
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); t++) workers[t].join();
+    offset[0] = top.size();
+    for(size_t j = 0; j < level.size(); j++) offset[j + 1] += offset[j];
+
+    size_t total = offset[level.size()];
+    Slab slab;
+    slab.begin = static_cast<char*>(::operator new(total * stride));
+    slab.end = slab.begin + total * stride;
+    slab.live = total;
+    slabs_.push_back(slab);
+
+    std::vector<Node<Key, Value>*> copies(top.size());
+    for(size_t i = 0; i < top.size(); i++) {
+        Node<Key, Value>* copy;
+        try {
+            copy = top[i]->cloneAt(slab.begin + i * stride);
+        }
+        catch(...) {
+            destroySlots(slab.begin, i, stride);
+            slabs_.pop_back();
+            ::operator delete(slab.begin);
+            throw;
+        }
+        copy->setLeft(NULL);
+        copy->setRight(NULL);
+        copy->setParent(NULL);
+        if(topParent[i] != (size_t)-1) {
+            Node<Key, Value>* parent = copies[topParent[i]];
+            copy->setParent(parent);
+            if(top[topParent[i]]->getLeft() == top[i]) parent->setLeft(copy);
+            else                                       parent->setRight(copy);
+        }
+        copies[i] = copy;
+    }
+    root_ = copies[0];
+
+    // Threads write different child links, so sharing a parent is safe
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<char> copied(level.size(), 0);
+    workers.clear();
+    for(unsigned t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            try {
+                for(size_t j = t; j < level.size(); j += threads) {
+                    Node<Key, Value>* copy = cloneSubtree(level[j], slab.begin + offset[j] * stride, stride);
+                    copied[j] = 1;
+                    Node<Key, Value>* parent = copies[levelParent[j]];
+                    copy->setParent(parent);
+                    if(top[levelParent[j]]->getLeft() == level[j]) parent->setLeft(copy);
+                    else                                           parent->setRight(copy);
+                }
+            }
+            catch(...) {
+                errors[t] = std::current_exception();
+            }
+        }));
+    }
+    for(size_t t = 0; t < workers.size(); t++) workers[t].join();
+    for(unsigned t = 0; t < threads; t++) {
+        if(!errors[t]) continue;
+        destroySlots(slab.begin, top.size(), stride);
+        for(size_t j = 0; j < level.size(); j++) {
+            if(copied[j]) destroySlots(slab.begin + offset[j] * stride, offset[j + 1] - offset[j], stride);
+        }
+        root_ = NULL;
+        slabs_.pop_back();
+        ::operator delete(slab.begin);
+        std::rethrow_exception(errors[t]);
+    }
+    size_ = total;
+    findExtremes();
+}
+
+/**
+* Copies the subtree at src into consecutive stride-sized slots from mem,
+* in pre-order, and returns the copy of src (with no parent).
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneSubtree(const Node<Key, Value>* src, char* mem, size_t stride)
+{
+    struct Pending {
+        const Node<Key, Value>* src;
+        Node<Key, Value>* parent;
+        bool asLeft;
+    };
+    Node<Key, Value>* root = NULL;
+    char* start = mem;
+    std::vector<Pending> stack;
+    Pending first = { src, NULL, false };
+    stack.push_back(first);
+    try {
+        while(!stack.empty()) {
+            Pending p = stack.back();
+            stack.pop_back();
+            const Node<Key, Value>* left = p.src->getLeft();
+            const Node<Key, Value>* right = p.src->getRight();
+            // Source nodes are scattered; start loading the children early
+            if(left != NULL)  __builtin_prefetch(left);
+            if(right != NULL) __builtin_prefetch(right);
+            Node<Key, Value>* copy = p.src->cloneAt(mem);
+            mem += stride;
+            copy->setParent(p.parent);
+            copy->setLeft(NULL);
+            copy->setRight(NULL);
+            if(p.parent == NULL)  root = copy;
+            else if(p.asLeft)     p.parent->setLeft(copy);
+            else                  p.parent->setRight(copy);
+            if(right != NULL) {
+                Pending pending = { right, copy, false };
+                stack.push_back(pending);
+            }
+            if(left != NULL) {
+                Pending pending = { left, copy, true };
+                stack.push_back(pending);
+            }
+        }
+    }
+    catch(...) {
+        destroySlots(start, (mem - start) / stride, stride);
+        throw;
+    }
+    return root;
+}
+
+/**
+* Runs the destructors of count nodes copied into consecutive slots.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroySlots(char* mem, size_t count, size_t stride)
+{
+    for(size_t i = 0; i < count; i++)
+        reinterpret_cast<Node<Key, Value>*>(mem + i * stride)->~Node();
+}
+
+template<typename Key, typename Value>
+size_t BinarySearchTree<Key, Value>::countNodes(const Node<Key, Value>* subtree)
+{
+    size_t count = 0;
+    std::vector<const Node<Key, Value>*> stack;
+    if(subtree != NULL) stack.push_back(subtree);
+    while(!stack.empty()) {
+        const Node<Key, Value>* n = stack.back();
+        stack.pop_back();
+        count++;
+        if(n->getRight() != NULL) stack.push_back(n->getRight());
+        if(n->getLeft() != NULL)  stack.push_back(n->getLeft());
+    }
+    return count;
+}
+
+/**
+* The cached ends of the tree, NULL when it is empty.
 */
 template<typename Key, class Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::getSmallestNode() const
 {
-    Node<Key, Value>* current = root_;
-    if(current == NULL) return NULL;
-    while(current->getLeft() != NULL)
-         current = current->getLeft();
-    return current;
+    return smallest_;
+}
+
+template<typename Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::getLargestNode() const
+{
+    return largest_;
 }
 
 /**
@@ -554,16 +1535,26 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::getSmallestNode() const
 template<typename Key, class Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
 {
+    if(hotCache_ != NULL) {
+        Node<Key, Value>* cached = hotCache_->lookup(key);
+        if(cached != NULL) return cached;
+    }
+    if(filter_ != NULL && !filter_->mayContain(key))
+        return NULL;
     Node<Key, Value>* current = root_;
+    size_t depth = 0;
     while(current != NULL) {
+        depth++;
         if(key < current->getKey())
             current = current->getLeft();
         else if(key > current->getKey())
             current = current->getRight();
         else
-            return current;
+            break;
     }
-    return NULL;
+    observeDepth(depth);
+    if(hotCache_ != NULL && current != NULL) hotCache_->remember(current);
+    return current;
 }
 
 /**
@@ -584,6 +1575,124 @@ bool BinarySearchTree<Key, Value>::isBalanced() const
     return (checkHeight(root_) != -1);
 }
 
+/**
+* Day-Stout-Warren rebalance: right rotations straighten the tree into a
+* vine of right children, then rounds of left rotations along the vine fold
+* it into a tree whose levels are all full except perhaps the last. Nodes
+* only change links, so iterators stay valid.
+*/
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::rebalance()
+{
+    rebalanceDebt_ = 0;
+    if(root_ == NULL) return;
+    Node<Key, Value>* rest = root_;
+    while(rest != NULL) {
+        if(rest->getLeft() != NULL) {
+            Node<Key, Value>* left = rest->getLeft();
+            rotateNodeRight(rest);
+            rest = left;
+        }
+        else
+            rest = rest->getRight();
+    }
+    // Fold the nodes beyond the largest perfect tree into its bottom level
+    size_t full = 1;
+    while(2 * full + 1 <= size_) full = 2 * full + 1;
+    compressVine(size_ - full);
+    for(size_t vine = full / 2; vine > 0; vine /= 2)
+        compressVine(vine);
+}
+
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::setAutoRebalance(double factor)
+{
+    autoRebalance_ = factor;
+    rebalanceDebt_ = 0;
+}
+
+/**
+* Helper function: rotateNodeLeft
+*
+* Lifts node's right child into its place, with no other bookkeeping.
+*/
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::rotateNodeLeft(Node<Key, Value>* node)
+{
+    Node<Key, Value>* right = node->getRight();
+    Node<Key, Value>* parent = node->getParent();
+    node->setRight(right->getLeft());
+    if(right->getLeft() != NULL) right->getLeft()->setParent(node);
+    right->setLeft(node);
+    node->setParent(right);
+    right->setParent(parent);
+    if(parent == NULL)                  root_ = right;
+    else if(parent->getLeft() == node)  parent->setLeft(right);
+    else                                parent->setRight(right);
+}
+
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::rotateNodeRight(Node<Key, Value>* node)
+{
+    Node<Key, Value>* left = node->getLeft();
+    Node<Key, Value>* parent = node->getParent();
+    node->setLeft(left->getRight());
+    if(left->getRight() != NULL) left->getRight()->setParent(node);
+    left->setRight(node);
+    node->setParent(left);
+    left->setParent(parent);
+    if(parent == NULL)                  root_ = left;
+    else if(parent->getLeft() == node)  parent->setLeft(left);
+    else                                parent->setRight(left);
+}
+
+/**
+* Helper function: compressVine
+*
+* Rotates every other node of the vine hanging off the root's right side
+* down to the left of its successor, count times, halving that stretch.
+*/
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::compressVine(size_t count)
+{
+    Node<Key, Value>* node = root_;
+    for(size_t i = 0; i < count; i++) {
+        Node<Key, Value>* right = node->getRight();
+        rotateNodeLeft(node);
+        node = right->getRight();
+    }
+}
+
+/**
+* Helper function: observeDepth
+*
+* Counts the levels a search went past factor * log2(size). The count is
+* atomic and nothing else changes, so concurrent lookups stay safe; the
+* rebuild it may call for waits for the next insert or remove.
+*/
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::observeDepth(size_t depth) const
+{
+    if(autoRebalance_ <= 0) return;
+    double limit = autoRebalance_ * std::log2((double)size_ + 1);
+    if(depth <= limit) return;
+    rebalanceDebt_.fetch_add(depth - (size_t)limit, std::memory_order_relaxed);
+}
+
+/**
+* Helper function: payRebalanceDebt
+*
+* Once the levels counted by observeDepth add up to the size of the tree,
+* the extra searching has cost as much as a rebuild, so the tree is
+* rebalanced.
+*/
+template<typename Key, class Value>
+void BinarySearchTree<Key, Value>::payRebalanceDebt()
+{
+    if(autoRebalance_ > 0 && root_ != NULL && rebalanceDebt_.load(std::memory_order_relaxed) >= size_)
+        rebalance();
+}
+
 template<typename Key, class Value>
 void BinarySearchTree<Key, Value>::nodeSwap(Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <map>
+#include <climits>
+#include <limits>
+#include <cstdlib>
+#include "avlbst.h"
+#include "counted-avlbst.h"
+#include "compressed-snapshot.h"
+
+using namespace std;
+
+
+// Every key, the gaps around it and the in-order walk against std::map
+template<typename Key>
+bool matchesMap(const CompressedSnapshot<Key,int>& snapshot, const map<Key,int>& reference)
+{
+    bool ok = snapshot.size() == reference.size();
+    typename CompressedSnapshot<Key,int>::iterator it = snapshot.begin();
+    for(typename map<Key,int>::const_iterator ref = reference.begin(); ok && ref != reference.end(); ++ref, ++it)
+        ok = it != snapshot.end() && it->first == ref->first && it->second == ref->second;
+    ok = ok && it == snapshot.end();
+    for(typename map<Key,int>::const_iterator ref = reference.begin(); ok && ref != reference.end(); ++ref) {
+        ok = snapshot.find(ref->first)->second == ref->second && snapshot[ref->first] == ref->second;
+        if(ok && ref->first != numeric_limits<Key>::max()) {
+            Key above = ref->first + 1;
+            typename map<Key,int>::const_iterator next = reference.lower_bound(above);
+            typename CompressedSnapshot<Key,int>::iterator found = snapshot.lower_bound(above);
+            ok = (next == reference.end()) ? found == snapshot.end() : found->first == next->first;
+            ok = ok && (snapshot.find(above) != snapshot.end()) == (reference.count(above) == 1);
+        }
+    }
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    AVLTree<int,int> tree;
+    int keys[] = { 5, 6, 7, 8, 20, 21, 100, 1000, 1001, 40000 };
+    for(int i = 0; i < 10; i++) tree.insert(std::make_pair(keys[i], i));
+    CompressedSnapshot<int,int> small(tree, 4);
+    cout << "Snapshot:";
+    for(CompressedSnapshot<int,int>::iterator it = small.begin(); it != small.end(); ++it)
+        cout << " " << it->first << ":" << it->second;
+    cout << endl;
+    cout << "find(21): " << small.find(21)->second << ", find(22) is end: " << (small.find(22) == small.end())
+         << ", lower_bound(22): " << small.lower_bound(22)->first << ", lower_bound(9): " << small.lower_bound(9)->first
+         << ", lower_bound(40001) is end: " << (small.lower_bound(40001) == small.end())
+         << ", lower_bound(-3): " << small.lower_bound(-3)->first << endl;
+
+    // Mixed gap widths, negative keys and the extremes, at several block sizes
+    AVLTree<long long,int> wide;
+    map<long long,int> reference;
+    srand(48);
+    for(int i = 0; i < 5000; i++) {
+        long long key;
+        if(i % 4 == 0)      key = i;
+        else if(i % 4 == 1) key = -(long long)rand() * 1000;
+        else if(i % 4 == 2) key = (long long)rand() << 30;
+        else                key = (long long)rand() * rand();
+        wide.insert(std::make_pair(key, i));
+        reference[key] = i;
+    }
+    wide.insert(std::make_pair(LLONG_MIN, -1));
+    wide.insert(std::make_pair(LLONG_MAX, -2));
+    reference[LLONG_MIN] = -1;
+    reference[LLONG_MAX] = -2;
+    bool ok = true;
+    for(size_t blockSize = 1; blockSize <= 512; blockSize *= 8) {
+        CompressedSnapshot<long long,int> snapshot(wide, blockSize);
+        ok = ok && matchesMap(snapshot, reference);
+    }
+    cout << "Randomized 64-bit keys match at block sizes 1 to 512: " << ok << endl;
+
+    // Dense keys take no gap bits at all
+    AVLTree<int,int> dense;
+    for(int i = 0; i < 100000; i++) dense.insert(std::make_pair(i + 7, i));
+    CompressedSnapshot<int,int> packed(dense);
+    cout << "Dense keys: " << (double)packed.keyBytes() / packed.size() << " bytes per key, ["
+         << packed.begin()->first << "] = " << packed[7] << ", [100006] = " << packed[100006] << endl;
+
+    // Copies of a key, in runs that cross blocks, against std::multimap
+    CountedAVLTree<int,int> counted;
+    multimap<int,int> copies;
+    for(int i = 0; i < 3000; i++) {
+        int key = (rand() % 300) * 3;
+        counted.insert(std::make_pair(key, 0));
+        copies.insert(std::make_pair(key, 0));
+    }
+    bool copiesOk = true;
+    for(size_t blockSize = 1; blockSize <= 64; blockSize *= 4) {
+        CompressedSnapshot<int,int> snapshot(counted, blockSize);
+        copiesOk = copiesOk && snapshot.size() == copies.size();
+        multimap<int,int>::const_iterator ref = copies.begin();
+        for(CompressedSnapshot<int,int>::iterator it = snapshot.begin(); copiesOk && it != snapshot.end(); ++it, ++ref)
+            copiesOk = it->first == ref->first;
+        for(int key = -1; copiesOk && key <= 900; key++) {
+            multimap<int,int>::const_iterator next = copies.lower_bound(key);
+            CompressedSnapshot<int,int>::iterator found = snapshot.lower_bound(key);
+            size_t run = 0;
+            for(CompressedSnapshot<int,int>::iterator it = found; it != snapshot.end() && it->first == key; ++it) run++;
+            copiesOk = (next == copies.end()) ? found == snapshot.end() : found->first == next->first;
+            copiesOk = copiesOk && run == copies.count(key);
+        }
+    }
+    cout << "Counted tree with " << counted.size() << " copies of " << counted.distinct()
+         << " keys matches at block sizes 1 to 64: " << copiesOk << endl;
+
+    AVLTree<int,int> none;
+    CompressedSnapshot<int,int> empty(none);
+    cout << "Empty snapshot: " << empty.empty() << ", begin is end: " << (empty.begin() == empty.end())
+         << ", find(1) is end: " << (empty.find(1) == empty.end()) << endl;
+    return 0;
+}
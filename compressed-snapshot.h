@@ -0,0 +1,393 @@
+#ifndef COMPRESSED_SNAPSHOT_H
+#define COMPRESSED_SNAPSHOT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+ * An immutable, compressed copy of a tree with integer keys, for archival
+ * lookups where a node per key costs too much.
+ *
+ * Keys are cut into blocks of blockSize (a power of two). A block keeps
+ * its first key in a sample array and the gaps between the rest,
+ * bit-packed at the width of its largest gap. Dense or evenly spread keys
+ * need a few bits each; the samples, block offsets and widths add about
+ * 17 bytes per block. Values are kept as they are, in key order. A tree
+ * that holds copies of a key, such as a CountedAVLTree, is copied with
+ * every copy; find and lower_bound then land on the first.
+ *
+ * find and lower_bound binary search the samples, then decode the gaps of
+ * one block until they reach the key, so larger blocks trade lookup time
+ * for space. Iteration decodes one gap per step.
+ */
+template <typename Key, typename Value>
+class CompressedSnapshot
+{
+    static_assert(std::is_integral<Key>::value, "CompressedSnapshot needs integer keys");
+
+public:
+    // Copies tree's items in key order; blockSize is rounded up to a power of two.
+    explicit CompressedSnapshot(const BinarySearchTree<Key, Value>& tree, size_t blockSize = 128);
+
+    /**
+    * An iterator over the items in key order. Keys are decoded into the
+    * iterator, so it yields a pair holding the key and a reference to the
+    * value; it->first and it->second work as usual.
+    */
+    class iterator
+    {
+    public:
+        typedef std::pair<Key, const Value&> reference;
+
+        /**
+        * Holds the pair so operator-> has something to point at.
+        */
+        class pointer
+        {
+        public:
+            pointer(const reference& ref) : ref_(ref) { }
+            const reference* operator->() const { return &ref_; }
+        private:
+            reference ref_;
+        };
+
+        iterator();
+        reference operator*() const;
+        pointer operator->() const;
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        iterator& operator++();
+    protected:
+        friend class CompressedSnapshot<Key, Value>;
+        iterator(const CompressedSnapshot<Key, Value>* snapshot, size_t pos, Key key);
+        const CompressedSnapshot<Key, Value>* snapshot_;
+        size_t pos_;    // index in key order, size() past the end
+        Key key_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+    size_t size() const;
+    bool empty() const;
+    size_t blockSize() const;
+    // Bytes for the keys: samples, block offsets and widths, packed gaps.
+    size_t keyBytes() const;
+    // keyBytes() plus the values.
+    size_t bytes() const;
+
+protected:
+    typedef typename std::make_unsigned<Key>::type UKey;
+    // Set in widths_ for a block that holds a repeated key, or starts with
+    // the last key of the block before; its gaps are stored whole.
+    static const uint8_t REPEATS = 0x80;
+
+    // Helper functions
+    void appendBlock(const std::vector<Key>& keys, bool continuesRun);
+    void appendBits(uint64_t value, unsigned bits);
+    uint64_t readBits(uint64_t position, unsigned bits) const;
+    Key keyAfter(size_t pos, Key key) const;
+    uint64_t gapBias(size_t block) const;
+    size_t locate(const Key& key, Key& found) const;
+
+protected:
+    unsigned blockShift_;
+    size_t size_;
+    std::vector<Key> samples_;          // first key of each block
+    std::vector<uint64_t> offsets_;     // bit position of each block's gaps
+    std::vector<uint8_t> widths_;       // bits per gap in each block, with REPEATS
+    std::vector<uint64_t> bits_;        // packed gaps, plus a spare word so reads need no bounds check
+    uint64_t bitCount_;
+    std::vector<Value> values_;
+};
+
+/*
+  ------------------------------------------------------------------
+  Begin implementations for the CompressedSnapshot::iterator class.
+  ------------------------------------------------------------------
+*/
+
+template<typename Key, typename Value>
+CompressedSnapshot<Key, Value>::iterator::iterator() :
+    snapshot_(NULL), pos_(0), key_()
+{
+}
+
+template<typename Key, typename Value>
+CompressedSnapshot<Key, Value>::iterator::iterator(const CompressedSnapshot<Key, Value>* snapshot, size_t pos, Key key) :
+    snapshot_(snapshot), pos_(pos), key_(key)
+{
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator::reference
+CompressedSnapshot<Key, Value>::iterator::operator*() const
+{
+    return reference(key_, snapshot_->values_[pos_]);
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator::pointer
+CompressedSnapshot<Key, Value>::iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<typename Key, typename Value>
+bool CompressedSnapshot<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return pos_ == rhs.pos_;
+}
+
+template<typename Key, typename Value>
+bool CompressedSnapshot<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator&
+CompressedSnapshot<Key, Value>::iterator::operator++()
+{
+    if(++pos_ < snapshot_->size_) key_ = snapshot_->keyAfter(pos_, key_);
+    return *this;
+}
+
+/*
+  ----------------------------------------------------------------
+  End implementations for the CompressedSnapshot::iterator class.
+  ----------------------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the CompressedSnapshot class.
+  ---------------------------------------------------------
+*/
+
+/**
+* One in-order pass over the tree, holding back a single block of keys.
+*/
+template<typename Key, typename Value>
+CompressedSnapshot<Key, Value>::CompressedSnapshot(const BinarySearchTree<Key, Value>& tree, size_t blockSize) :
+    blockShift_(0), size_(tree.size()), bitCount_(0)
+{
+    while(((size_t)1 << blockShift_) < blockSize) blockShift_++;
+    size_t blocks = (size_ + (1 << blockShift_) - 1) >> blockShift_;
+    samples_.reserve(blocks);
+    offsets_.reserve(blocks);
+    widths_.reserve(blocks);
+    values_.reserve(size_);
+    bits_.push_back(0);
+
+    std::vector<Key> block;
+    block.reserve((size_t)1 << blockShift_);
+    Key previous = Key();
+    for(typename BinarySearchTree<Key, Value>::iterator it = tree.begin(); it != tree.end(); ++it) {
+        block.push_back(it->first);
+        values_.push_back(it->second);
+        if(block.size() == ((size_t)1 << blockShift_)) {
+            appendBlock(block, !samples_.empty() && block[0] == previous);
+            previous = block.back();
+            block.clear();
+        }
+    }
+    if(!block.empty()) appendBlock(block, !samples_.empty() && block[0] == previous);
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator CompressedSnapshot<Key, Value>::begin() const
+{
+    return iterator(this, 0, size_ == 0 ? Key() : samples_[0]);
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator CompressedSnapshot<Key, Value>::end() const
+{
+    return iterator(this, size_, Key());
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator CompressedSnapshot<Key, Value>::find(const Key& key) const
+{
+    Key found;
+    size_t pos = locate(key, found);
+    if(pos == size_ || found != key) return end();
+    return iterator(this, pos, found);
+}
+
+template<typename Key, typename Value>
+typename CompressedSnapshot<Key, Value>::iterator CompressedSnapshot<Key, Value>::lower_bound(const Key& key) const
+{
+    Key found;
+    size_t pos = locate(key, found);
+    return iterator(this, pos, found);
+}
+
+template<typename Key, typename Value>
+Value const & CompressedSnapshot<Key, Value>::operator[](const Key& key) const
+{
+    Key found;
+    size_t pos = locate(key, found);
+    if(pos == size_ || found != key) throw std::out_of_range("Invalid key");
+    return values_[pos];
+}
+
+template<typename Key, typename Value>
+size_t CompressedSnapshot<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value>
+bool CompressedSnapshot<Key, Value>::empty() const
+{
+    return size_ == 0;
+}
+
+template<typename Key, typename Value>
+size_t CompressedSnapshot<Key, Value>::blockSize() const
+{
+    return (size_t)1 << blockShift_;
+}
+
+template<typename Key, typename Value>
+size_t CompressedSnapshot<Key, Value>::keyBytes() const
+{
+    return samples_.size() * sizeof(Key) + offsets_.size() * sizeof(uint64_t) + widths_.size() +
+           bits_.size() * sizeof(uint64_t);
+}
+
+template<typename Key, typename Value>
+size_t CompressedSnapshot<Key, Value>::bytes() const
+{
+    return keyBytes() + values_.size() * sizeof(Value);
+}
+
+/**
+* Helper function: appendBlock
+*
+* Stores the gap to the previous key less one while keys are distinct, so
+* runs of consecutive keys take no bits at all. A block with a repeated
+* key stores its gaps whole and is marked REPEATS, as is one that carries
+* on a run of copies from the block before, so locate knows to look back.
+*/
+template<typename Key, typename Value>
+void CompressedSnapshot<Key, Value>::appendBlock(const std::vector<Key>& keys, bool continuesRun)
+{
+    bool repeats = continuesRun;
+    for(size_t i = 1; i < keys.size() && !repeats; i++) repeats = keys[i] == keys[i - 1];
+    uint64_t bias = repeats ? 0 : 1;
+    uint64_t widest = 0;
+    for(size_t i = 1; i < keys.size(); i++)
+        widest |= (uint64_t)((UKey)keys[i] - (UKey)keys[i - 1] - bias);
+    unsigned width = (widest == 0) ? 0 : 64 - __builtin_clzll(widest);
+    samples_.push_back(keys[0]);
+    offsets_.push_back(bitCount_);
+    widths_.push_back((uint8_t)(width | (repeats ? REPEATS : 0)));
+    for(size_t i = 1; i < keys.size(); i++)
+        appendBits((uint64_t)((UKey)keys[i] - (UKey)keys[i - 1] - bias), width);
+}
+
+template<typename Key, typename Value>
+void CompressedSnapshot<Key, Value>::appendBits(uint64_t value, unsigned bits)
+{
+    if(bits == 0) return;
+    size_t word = bitCount_ >> 6;
+    unsigned shift = bitCount_ & 63;
+    while(bits_.size() < word + 2) bits_.push_back(0);
+    bits_[word] |= value << shift;
+    if(shift + bits > 64) bits_[word + 1] |= value >> (64 - shift);
+    bitCount_ += bits;
+}
+
+template<typename Key, typename Value>
+uint64_t CompressedSnapshot<Key, Value>::readBits(uint64_t position, unsigned bits) const
+{
+    size_t word = position >> 6;
+    unsigned shift = position & 63;
+    uint64_t value = bits_[word] >> shift;
+    if(shift + bits > 64) value |= bits_[word + 1] << (64 - shift);
+    return (bits == 64) ? value : value & (((uint64_t)1 << bits) - 1);
+}
+
+/**
+* Helper function: keyAfter
+*
+* The key at pos, given key at pos - 1.
+*/
+template<typename Key, typename Value>
+Key CompressedSnapshot<Key, Value>::keyAfter(size_t pos, Key key) const
+{
+    size_t block = pos >> blockShift_;
+    size_t index = pos & (((size_t)1 << blockShift_) - 1);
+    if(index == 0) return samples_[block];
+    unsigned width = widths_[block] & ~REPEATS;
+    return (Key)((UKey)key + readBits(offsets_[block] + (index - 1) * width, width) + gapBias(block));
+}
+
+/**
+* Helper function: gapBias
+*
+* What was taken off each gap of block when it was stored.
+*/
+template<typename Key, typename Value>
+uint64_t CompressedSnapshot<Key, Value>::gapBias(size_t block) const
+{
+    return (widths_[block] & REPEATS) ? 0 : 1;
+}
+
+/**
+* Helper function: locate
+*
+* The position of the first key not below key, size_ if there is none,
+* with that key in found.
+*/
+template<typename Key, typename Value>
+size_t CompressedSnapshot<Key, Value>::locate(const Key& key, Key& found) const
+{
+    found = Key();
+    if(size_ == 0) return 0;
+    size_t block = std::upper_bound(samples_.begin(), samples_.end(), key) - samples_.begin();
+    if(block == 0) {
+        found = samples_[0];
+        return 0;
+    }
+    block--;
+    // Copies of key may start in an earlier block; decoding one that holds
+    // none runs off its end onto the next sample, which is right.
+    while(block > 0 && samples_[block] == key && (widths_[block] & REPEATS)) block--;
+    size_t first = block << blockShift_;
+    size_t count = std::min((size_t)1 << blockShift_, size_ - first);
+    unsigned width = widths_[block] & ~REPEATS;
+    uint64_t bias = gapBias(block);
+    uint64_t position = offsets_[block];
+    Key current = samples_[block];
+    size_t index = 0;
+    while(current < key) {
+        if(++index == count) {
+            if(block + 1 < samples_.size()) found = samples_[block + 1];
+            return first + count;
+        }
+        current = (Key)((UKey)current + readBits(position, width) + bias);
+        position += width;
+    }
+    found = current;
+    return first + index;
+}
+
+/*
+  -------------------------------------------------------
+  End implementations for the CompressedSnapshot class.
+  -------------------------------------------------------
+*/
+
+#endif
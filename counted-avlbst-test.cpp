@@ -0,0 +1,120 @@
+#include <iostream>
+#include <set>
+#include <string>
+#include <cstdlib>
+#include "counted-avlbst.h"
+#include "tree-finger.h"
+
+using namespace std;
+
+
+// Every copy in order, and the counts, against std::multiset
+bool matchesMultiset(const CountedAVLTree<int,int>& tree, const multiset<int>& reference)
+{
+    bool ok = tree.size() == reference.size();
+    CountedAVLTree<int,int>::iterator it = tree.begin();
+    for(multiset<int>::const_iterator ref = reference.begin(); ok && ref != reference.end(); ++ref, ++it)
+        ok = it != tree.end() && it->first == *ref && tree.count(*ref) == reference.count(*ref);
+    return ok && it == tree.end() && tree.isBalanced();
+}
+
+int main(int argc, char *argv[])
+{
+    // A word frequency table
+    CountedAVLTree<string,int> words;
+    const char* text[] = { "to", "be", "or", "not", "to", "be", "that", "is", "the", "question", "to", "be" };
+    for(int i = 0; i < 12; i++) words.insert(std::make_pair(string(text[i]), i));
+    cout << "Words: " << words.size() << " in " << words.distinct() << " nodes, count(to) = " << words.count("to")
+         << ", count(be) = " << words.count("be") << ", count(xyz) = " << words.count("xyz") << endl;
+    cout << "Expanded:";
+    for(CountedAVLTree<string,int>::iterator it = words.begin(); it != words.end(); ++it) cout << " " << it->first;
+    cout << endl;
+    words.erase_one("to");
+    words.erase_one("is");
+    words.remove("be");
+    cout << "After erase_one(to), erase_one(is), remove(be): " << words.size() << " in " << words.distinct()
+         << " nodes, count(to) = " << words.count("to") << ", has is: " << (words.find("is") != words.end()) << endl;
+
+    // Randomized against std::multiset
+    CountedAVLTree<int,int> tree;
+    multiset<int> reference;
+    srand(49);
+    bool ok = true;
+    for(int i = 0; ok && i < 20000; i++) {
+        int key = rand() % 200;
+        int op = rand() % 10;
+        if(op < 5) {
+            tree.insert(std::make_pair(key, i));
+            reference.insert(key);
+        }
+        else if(op < 7) {
+            bool erased = tree.erase_one(key);
+            multiset<int>::iterator found = reference.find(key);
+            ok = erased == (found != reference.end());
+            if(found != reference.end()) reference.erase(found);
+        }
+        else if(op < 8) {
+            tree.remove(key);
+            reference.erase(key);
+        }
+        else if(!reference.empty()) {
+            if(op == 8) {
+                ok = tree.front().first == *reference.begin();
+                tree.pop_min();
+                reference.erase(reference.begin());
+            }
+            else {
+                ok = tree.back().first == *reference.rbegin();
+                tree.pop_max();
+                reference.erase(--reference.end());
+            }
+        }
+        if(i % 1000 == 0) ok = ok && matchesMultiset(tree, reference);
+    }
+    cout << "Randomized multiset matches: " << (ok && matchesMultiset(tree, reference)) << ", "
+         << tree.size() << " copies in " << tree.distinct() << " nodes" << endl;
+
+    // Copies keep counts; handles and merge move every copy of a key
+    CountedAVLTree<int,int> copy(tree);
+    CountedAVLTree<int,int> other;
+    for(int i = 0; i < 300; i++) other.insert(std::make_pair(i % 250, i));
+    size_t expected = tree.size() + other.size();
+    size_t moved = tree.merge(other);
+    cout << "Copy matches: " << matchesMultiset(copy, reference) << ", merged " << moved << " copies, size "
+         << tree.size() << " (expected " << expected << "), other empty: " << other.empty() << endl;
+    size_t count10 = tree.count(10);
+    AVLTree<int,int>::node_type handle = tree.extract(10);
+    CountedAVLTree<int,int> target;
+    target.insert(std::move(handle));
+    cout << "Handle moved " << target.size() << " of " << count10 << " copies, source has "
+         << tree.count(10) << ", size " << tree.size() << endl;
+
+    // Finger inserts add copies too
+    TreeFinger<int,int> finger(target);
+    for(int i = 0; i < 5; i++) finger.insert(std::make_pair(10, i));
+    finger.insert(std::make_pair(300, 0));
+    cout << "After finger inserts: count(10) = " << target.count(10) << ", size " << target.size() << endl;
+
+    // Through an AVLTree reference every call still counts copies
+    CountedAVLTree<int,int> hidden;
+    AVLTree<int,int>& base = hidden;
+    std::pair<int,int> batch[] = { std::make_pair(3, 0), std::make_pair(1, 0), std::make_pair(3, 1), std::make_pair(1, 1), std::make_pair(2, 0) };
+    base.insert_batch(batch, batch + 5);
+    size_t walked = 0;
+    for(AVLTree<int,int>::iterator it = base.begin(); it != base.end(); ++it) walked++;
+    base.pop_min();
+    cout << "Base batch: size " << base.size() << " after pop_min, walked " << walked << ", count(1) = " << hidden.count(1);
+    AVLTree<int,int>::node_type three = base.extract(3);
+    CountedAVLTree<int,int> elsewhere;
+    AVLTree<int,int>& baseElsewhere = elsewhere;
+    baseElsewhere.insert(std::move(three));
+    cout << ", after moving 3 by handle: " << base.size() << " here, " << baseElsewhere.size() << " there";
+    elsewhere.insert(std::make_pair(2, 5));
+    elsewhere.insert(std::make_pair(2, 6));
+    size_t mergedBack = base.merge(baseElsewhere);
+    cout << ", merged back " << mergedBack << ": " << base.size() << " here, count(2) = " << hidden.count(2)
+         << ", " << baseElsewhere.size() << " there";
+    base.clear();
+    cout << ", after clear: " << base.size() << ", empty: " << base.empty() << endl;
+    return 0;
+}
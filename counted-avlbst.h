@@ -0,0 +1,343 @@
+#ifndef COUNTED_AVLBST_H
+#define COUNTED_AVLBST_H
+
+#include "avlbst.h"
+
+/**
+ * An AVLNode that stands for count copies of its key.
+ */
+template <typename Key, typename Value>
+class CountedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    CountedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~CountedAVLNode();
+
+    size_t getCount() const;
+    void setCount(size_t count);
+    virtual CountedAVLNode<Key, Value>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
+protected:
+    size_t count_;
+};
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the CountedAVLNode class.
+  ----------------------------------------------------
+*/
+
+template<class Key, class Value>
+CountedAVLNode<Key, Value>::CountedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), count_(1)
+{
+}
+
+template<class Key, class Value>
+CountedAVLNode<Key, Value>::~CountedAVLNode()
+{
+}
+
+template<class Key, class Value>
+size_t CountedAVLNode<Key, Value>::getCount() const
+{
+    return count_;
+}
+
+template<class Key, class Value>
+void CountedAVLNode<Key, Value>::setCount(size_t count)
+{
+    count_ = count;
+}
+
+template<class Key, class Value>
+CountedAVLNode<Key, Value>* CountedAVLNode<Key, Value>::cloneAt(void* where) const
+{
+    return new (where) CountedAVLNode<Key, Value>(*this);
+}
+
+template<class Key, class Value>
+size_t CountedAVLNode<Key, Value>::footprint() const
+{
+    return sizeof(*this);
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the CountedAVLNode class.
+  --------------------------------------------------
+*/
+
+/**
+ * An AVLTree in multiset mode: inserting a key that is already present
+ * adds a copy by bumping its node's count instead of linking a new node,
+ * so memory and tree height follow the number of distinct keys. As with
+ * AVLTree::insert, the key's value becomes the one last inserted.
+ *
+ * size() counts every copy and distinct() counts nodes. Iterators visit
+ * each key once per copy. erase_one() and the pops take away one copy,
+ * remove() takes away all of them. Node handles and merge move a key with
+ * all its copies, and merge adds the copies of a key already here to its
+ * count; merge returns the number of copies moved.
+ */
+template <typename Key, typename Value>
+class CountedAVLTree : public AVLTree<Key, Value>
+{
+public:
+    CountedAVLTree();
+    CountedAVLTree(const CountedAVLTree& other);
+    CountedAVLTree(CountedAVLTree&& other) noexcept;
+    CountedAVLTree& operator=(const CountedAVLTree& other);
+    CountedAVLTree& operator=(CountedAVLTree&& other) noexcept;
+
+    using AVLTree<Key, Value>::insert;
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    // Removes one copy of key; returns false if there was none.
+    bool erase_one(const Key& key);
+    virtual void pop_min();
+    virtual void pop_max();
+    virtual void clear();
+
+    // Number of copies of key, 0 if it is absent.
+    size_t count(const Key& key) const;
+    virtual size_t size() const;
+    size_t distinct() const;
+
+protected:
+    typedef CountedAVLNode<Key, Value> CountedNode;
+
+    virtual void insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual Node<Key, Value>* insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item);
+    virtual void assignValue(Node<Key, Value>* node, const Value& value);
+    virtual void eraseNode(Node<Key, Value>* node);
+    virtual typename AVLTree<Key, Value>::node_type extractNode(AVLNode<Key, Value>* node);
+    virtual void adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+    virtual bool absorbNode(AVLNode<Key, Value>* here, const AVLNode<Key, Value>* node);
+    // The base iterators visit each key once per copy.
+    virtual size_t copiesAt(const Node<Key, Value>* node) const;
+
+    // Helper functions
+    void eraseCopy(Node<Key, Value>* node);
+
+protected:
+    size_t total_;  // copies over all nodes
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the CountedAVLTree class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value>
+CountedAVLTree<Key, Value>::CountedAVLTree() :
+    total_(0)
+{
+    this->copiesVary_ = true;
+}
+
+template<class Key, class Value>
+CountedAVLTree<Key, Value>::CountedAVLTree(const CountedAVLTree<Key, Value>& other) :
+    AVLTree<Key, Value>(other), total_(other.total_)
+{
+    this->copiesVary_ = true;
+}
+
+template<class Key, class Value>
+CountedAVLTree<Key, Value>::CountedAVLTree(CountedAVLTree<Key, Value>&& other) noexcept :
+    AVLTree<Key, Value>(std::move(other)), total_(other.total_)
+{
+    this->copiesVary_ = true;
+    other.total_ = 0;
+}
+
+template<class Key, class Value>
+CountedAVLTree<Key, Value>& CountedAVLTree<Key, Value>::operator=(const CountedAVLTree<Key, Value>& other)
+{
+    AVLTree<Key, Value>::operator=(other);
+    total_ = other.total_;
+    return *this;
+}
+
+template<class Key, class Value>
+CountedAVLTree<Key, Value>& CountedAVLTree<Key, Value>::operator=(CountedAVLTree<Key, Value>&& other) noexcept
+{
+    if(this == &other) return *this;
+    AVLTree<Key, Value>::operator=(std::move(other));
+    total_ = other.total_;
+    other.total_ = 0;
+    return *this;
+}
+
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    AVLNode<Key, Value>* parent;
+    bool asLeftChild;
+    AVLNode<Key, Value>* node = this->findSlot(keyValuePair.first, parent, asLeftChild);
+    if(node != NULL)
+        assignValue(node, keyValuePair.second);
+    else
+        insertAt(parent, asLeftChild, keyValuePair);
+}
+
+template<class Key, class Value>
+bool CountedAVLTree<Key, Value>::erase_one(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == NULL) return false;
+    eraseCopy(node);
+    return true;
+}
+
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::pop_min()
+{
+    if(this->smallest_ == NULL) throw std::out_of_range("Empty tree");
+    eraseCopy(this->smallest_);
+}
+
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::pop_max()
+{
+    if(this->largest_ == NULL) throw std::out_of_range("Empty tree");
+    eraseCopy(this->largest_);
+}
+
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    total_ = 0;
+}
+
+template<class Key, class Value>
+size_t CountedAVLTree<Key, Value>::count(const Key& key) const
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    return (node == NULL) ? 0 : static_cast<CountedNode*>(node)->getCount();
+}
+
+template<class Key, class Value>
+size_t CountedAVLTree<Key, Value>::size() const
+{
+    return total_;
+}
+
+template<class Key, class Value>
+size_t CountedAVLTree<Key, Value>::distinct() const
+{
+    return this->size_;
+}
+
+/**
+* Repeated keys must add up rather than overwrite, which the merging
+* rebuild of AVLTree::insertItems does not do, so this inserts one by one.
+*/
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned)
+{
+    for(size_t i = 0; i < batch.size(); i++) insert(batch[i]);
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* CountedAVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new CountedAVLNode<Key, Value>(key, value, parent);
+}
+
+/**
+* Every new key arrives here, from insert() or a TreeFinger, with one copy.
+*/
+template<class Key, class Value>
+Node<Key, Value>* CountedAVLTree<Key, Value>::insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item)
+{
+    total_++;
+    return AVLTree<Key, Value>::insertAt(parent, asLeftChild, item);
+}
+
+/**
+* Every repeated key arrives here, and adds a copy.
+*/
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::assignValue(Node<Key, Value>* node, const Value& value)
+{
+    CountedNode* counted = static_cast<CountedNode*>(node);
+    counted->setCount(counted->getCount() + 1);
+    total_++;
+    AVLTree<Key, Value>::assignValue(node, value);
+}
+
+/**
+* remove() ends here and takes every copy with the node.
+*/
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    total_ -= static_cast<CountedNode*>(node)->getCount();
+    AVLTree<Key, Value>::eraseNode(node);
+}
+
+/**
+* Node handles, and merge, move a key with all its copies.
+*/
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type CountedAVLTree<Key, Value>::extractNode(AVLNode<Key, Value>* node)
+{
+    total_ -= static_cast<CountedNode*>(node)->getCount();
+    return AVLTree<Key, Value>::extractNode(node);
+}
+
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    total_ += static_cast<CountedNode*>(node)->getCount();
+    AVLTree<Key, Value>::adoptNode(parent, asLeftChild, node);
+}
+
+/**
+* merge adds the copies of a key present in both here, keeping this tree's
+* value, and then erases the node from other.
+*/
+template<class Key, class Value>
+bool CountedAVLTree<Key, Value>::absorbNode(AVLNode<Key, Value>* here, const AVLNode<Key, Value>* node)
+{
+    size_t copies = static_cast<const CountedNode*>(node)->getCount();
+    CountedNode* counted = static_cast<CountedNode*>(here);
+    counted->setCount(counted->getCount() + copies);
+    total_ += copies;
+    return true;
+}
+
+template<class Key, class Value>
+size_t CountedAVLTree<Key, Value>::copiesAt(const Node<Key, Value>* node) const
+{
+    return static_cast<const CountedNode*>(node)->getCount();
+}
+
+/**
+* Helper function: eraseCopy
+*
+* Takes one copy away, and the node with its last one.
+*/
+template<class Key, class Value>
+void CountedAVLTree<Key, Value>::eraseCopy(Node<Key, Value>* node)
+{
+    CountedNode* counted = static_cast<CountedNode*>(node);
+    if(counted->getCount() == 1) {
+        eraseNode(node);
+        return;
+    }
+    counted->setCount(counted->getCount() - 1);
+    total_--;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the CountedAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
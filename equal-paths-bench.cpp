@@ -0,0 +1,103 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "equal-paths.h"
+#include "equal-paths-parallel.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+// Nodes live in one pool so building and freeing big trees stays cheap
+vector<Node> pool;
+
+Node* makeNode(int key)
+{
+    pool.push_back(Node(key));
+    return &pool.back();
+}
+
+Node* perfectTree(int height)
+{
+    Node* n = makeNode(height);
+    if(height > 1) {
+        n->left = perfectTree(height - 1);
+        n->right = perfectTree(height - 1);
+    }
+    return n;
+}
+
+// A spine of 'length' nodes, each with a leaf hanging off to the right
+Node* comb(int length)
+{
+    Node* root = makeNode(0);
+    Node* n = root;
+    for(int i = 1; i < length; i++) {
+        n->right = makeNode(-i);
+        n->left = makeNode(i);
+        n = n->left;
+    }
+    return root;
+}
+
+void run(const string& name, Node* root, bool recursive)
+{
+    cout << "  " << left << setw(40) << name << right;
+    if(recursive) {
+        Clock::time_point start = Clock::now();
+        bool ok = equalPaths(root);
+        cout << " recursive " << setw(8) << fixed << setprecision(1)
+             << chrono::duration<double, milli>(Clock::now() - start).count() << " ms (" << ok << ")";
+    }
+    const unsigned threadCounts[] = { 1, 2, 4, 8 };
+    for(unsigned t : threadCounts) {
+        Clock::time_point start = Clock::now();
+        bool ok = equalPathsParallel(root, t);
+        cout << "  " << t << "T " << setw(8) << fixed << setprecision(1)
+             << chrono::duration<double, milli>(Clock::now() - start).count() << " ms (" << ok << ")";
+    }
+    cout << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    int height = (argc > 1) ? atoi(argv[1]) : 22;
+    int length = (argc > 2) ? atoi(argv[2]) : 2000000;
+    pool.reserve((size_t(1) << height) + 3 * (size_t)length);
+
+    cout << "Perfect tree of height " << height << endl;
+    Node* root = perfectTree(height);
+    run("all leaves equal", root, true);
+
+    // Turn the leftmost parent of leaves into a leaf, so the mismatch is
+    // found at once...
+    Node* n = root;
+    while(n->left->left) n = n->left;
+    Node* left = n->left;
+    Node* right = n->right;
+    n->left = n->right = nullptr;
+    run("shallow leaf at the far left", root, true);
+    n->left = left;
+    n->right = right;
+
+    // ...and the rightmost one, so it is found only at the very end
+    n = root;
+    while(n->right->right) n = n->right;
+    n->left = n->right = nullptr;
+    run("shallow leaf at the far right", root, true);
+
+    // Far too deep for the recursive version's call stack
+    cout << "Comb with a spine of " << length << " nodes" << endl;
+    run("depth-1 leaf, seen last in DFS order", comb(length), false);
+    Node* chain = makeNode(0);
+    n = chain;
+    for(int i = 1; i < length; i++) {
+        n->left = makeNode(i);
+        n = n->left;
+    }
+    run("single chain, all leaves equal", chain, false);
+    return 0;
+}
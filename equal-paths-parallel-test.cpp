@@ -0,0 +1,77 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include "equal-paths.h"
+#include "equal-paths-parallel.h"
+using namespace std;
+
+vector<Node*> allocated;
+
+Node* makeNode(int key)
+{
+  allocated.push_back(new Node(key));
+  return allocated.back();
+}
+
+void freeAll()
+{
+  for (size_t i = 0; i < allocated.size(); i++) delete allocated[i];
+  allocated.clear();
+}
+
+// A random tree whose leaves are all at depth 'depth'
+Node* equalDepthTree(int depth)
+{
+  Node* n = makeNode(depth);
+  if (depth == 0) return n;
+  int shape = rand() % 3;
+  if (shape != 1) n->left = equalDepthTree(depth - 1);
+  if (shape != 0) n->right = equalDepthTree(depth - 1);
+  return n;
+}
+
+// A left-leaning chain, far deeper than the recursive version can go
+Node* chain(int length)
+{
+  Node* root = makeNode(0);
+  Node* n = root;
+  for (int i = 1; i < length; i++) {
+    n->left = makeNode(i);
+    n = n->left;
+  }
+  return root;
+}
+
+int main()
+{
+  srand(104);
+  const unsigned threadCounts[] = { 1, 2, 4, 8 };
+  int agree = 0, total = 0;
+  for (int trial = 0; trial < 200; trial++) {
+    Node* root = equalDepthTree(2 + rand() % 12);
+    if (trial % 2 == 1) {
+      // Drop one random leaf, which usually makes its parent a shallower leaf
+      Node* n = root;
+      while (n->left || n->right) {
+        Node** next = (n->left && (!n->right || rand() % 2 == 0)) ? &n->left : &n->right;
+        if (!(*next)->left && !(*next)->right) { *next = nullptr; break; }
+        n = *next;
+      }
+    }
+    bool expected = equalPaths(root);
+    for (unsigned t : threadCounts) {
+      total++;
+      agree += (equalPathsParallel(root, t) == expected);
+    }
+    freeAll();
+  }
+  cout << "Random trees agreeing with equalPaths: " << agree << " of " << total << endl;
+
+  Node* deep = chain(2000000);
+  cout << "Chain of 2000000 nodes: " << equalPathsParallel(deep, 1) << " " << equalPathsParallel(deep, 4) << endl;
+  deep->right = makeNode(-1);
+  cout << "Chain with a shallow leaf: " << equalPathsParallel(deep, 1) << " " << equalPathsParallel(deep, 4) << endl;
+  freeAll();
+  cout << "Empty tree: " << equalPathsParallel(nullptr) << endl;
+  return 0;
+}
@@ -0,0 +1,157 @@
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "equal-paths-parallel.h"
+using namespace std;
+
+namespace {
+
+// A subtree still to be checked and the depth of its root
+struct Task {
+    Node* node;
+    int depth;
+};
+
+// One worker's shared tasks: the owner pops the newest, thieves take the oldest
+struct TaskQueue {
+    mutex lock;
+    deque<Task> tasks;
+};
+
+// How many nodes a worker checks between looks at whether anyone is idle
+const unsigned SHARE_INTERVAL = 256;
+
+struct SharedState {
+    SharedState(unsigned threads) : queues(threads), leafDepth(-1), pending(0), idle(0), failed(false) {}
+    vector<TaskQueue> queues;
+    atomic<int> leafDepth;
+    atomic<size_t> pending;     // tasks queued or running
+    atomic<unsigned> idle;      // workers looking for a task
+    atomic<bool> failed;
+};
+
+// Records a leaf at depth; returns false if it disagrees with an earlier leaf
+bool checkLeaf(atomic<int>& leafDepth, int depth)
+{
+    int expected = -1;
+    if (leafDepth.compare_exchange_strong(expected, depth, memory_order_relaxed))
+        return true;
+    return expected == depth;
+}
+
+// Checks the subtree of task with a local stack, sharing its oldest entries
+// with idle workers. Returns false on the first mismatch.
+bool checkSubtree(SharedState& state, unsigned self, Task task)
+{
+    vector<Task> stack(64);
+    size_t top = 0;
+    stack[top++] = task;
+    int leafDepth = state.leafDepth.load(memory_order_relaxed);
+    unsigned sinceShare = 0;
+    while (top > 0) {
+        Task t = stack[--top];
+        // Follow left children directly and stack only the right ones
+        for (Node* n = t.node; ; sinceShare++) {
+            Node* l = n->left;
+            Node* r = n->right;
+            if (!l && !r) {
+                if (leafDepth == -1) {
+                    if (!checkLeaf(state.leafDepth, t.depth))
+                        return false;
+                    leafDepth = t.depth;
+                }
+                else if (t.depth != leafDepth)
+                    return false;
+                break;
+            }
+            t.depth++;
+            if (l && r) {
+                if (top == stack.size()) stack.resize(2 * top);
+                stack[top++] = Task{r, t.depth};
+            }
+            n = l ? l : r;
+        }
+
+        if (sinceShare < SHARE_INTERVAL)
+            continue;
+        sinceShare = 0;
+        if (state.failed.load(memory_order_relaxed))
+            return true;
+        if (top > 1 && state.idle.load(memory_order_relaxed) > 0) {
+            state.pending++;
+            TaskQueue& q = state.queues[self];
+            lock_guard<mutex> guard(q.lock);
+            q.tasks.push_back(stack[0]);
+            stack.erase(stack.begin());
+            top--;
+        }
+    }
+    return true;
+}
+
+bool takeTask(SharedState& state, unsigned self, Task& task)
+{
+    unsigned n = state.queues.size();
+    for (unsigned i = 0; i < n; i++) {
+        unsigned victim = (self + i) % n;
+        TaskQueue& q = state.queues[victim];
+        lock_guard<mutex> guard(q.lock);
+        if (q.tasks.empty()) continue;
+        if (victim == self) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+        }
+        else {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+void worker(SharedState& state, unsigned self)
+{
+    bool idle = false;
+    while (!state.failed.load(memory_order_relaxed) && state.pending.load() > 0) {
+        Task task;
+        if (!takeTask(state, self, task)) {
+            if (!idle) { state.idle++; idle = true; }
+            this_thread::yield();
+            continue;
+        }
+        if (idle) { state.idle--; idle = false; }
+        if (!checkSubtree(state, self, task))
+            state.failed = true;
+        state.pending--;
+    }
+    if (idle) state.idle--;
+}
+
+}
+
+bool equalPathsParallel(Node * root, unsigned threads)
+{
+    if (root == nullptr)
+        return true;
+    if (threads == 0)
+        threads = thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    SharedState state(threads);
+    if (threads == 1)
+        return checkSubtree(state, 0, Task{root, 0});
+
+    state.pending = 1;
+    state.queues[0].tasks.push_back(Task{root, 0});
+    vector<thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+        workers.push_back(thread(worker, ref(state), i));
+    worker(state, 0);
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    return !state.failed;
+}
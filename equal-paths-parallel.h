@@ -0,0 +1,20 @@
+#ifndef EQUAL_PATHS_PARALLEL_H
+#define EQUAL_PATHS_PARALLEL_H
+
+#include "equal-paths.h"
+
+/**
+ * @brief Same contract as equalPaths, for very large or very deep trees.
+ *
+ *        Walks the tree with an explicit stack, so any depth is fine, and
+ *        returns as soon as a leaf is found at a different depth from the
+ *        first one. With more than one thread the subtrees are spread over
+ *        a work-stealing pool: a busy worker hands the oldest (largest)
+ *        pending subtree of its stack to an idle one.
+ *
+ * @param root Pointer to the root of the tree to check for equal paths
+ * @param threads Number of worker threads; 0 uses one per hardware thread
+ */
+bool equalPathsParallel(Node * root, unsigned threads = 0);
+
+#endif
@@ -0,0 +1,220 @@
+#ifndef HOT_KEY_CACHE_H
+#define HOT_KEY_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "bloom-filter.h"
+
+template <typename Key, typename Value>
+class Node;
+
+/**
+ * A small 2-way set-associative cache from key to tree node, so lookups of
+ * the few keys that get most of the traffic skip the descent.
+ *
+ * Each key hashes to one set of two 16-byte entries. An entry keeps the
+ * node and the full hash as a tag, so a miss rarely has to touch a node.
+ * A new entry replaces the back one and a hit moves its entry to the
+ * front, so a stream of one-off keys cannot push out a key hit twice.
+ *
+ * The cache never owns nodes. The tree must call forget() before a node it
+ * remembered is freed or leaves the tree, and clear() when all of them do.
+ *
+ * lookup() and remember() run inside const finds, so every field is a
+ * relaxed atomic and a hit is always checked against the node's own key:
+ * finds on several threads at once stay as safe as without a cache. They
+ * may then lose an entry or a count, which costs nothing but a descent.
+ * Calls that change the tree still need all finds to have stopped.
+ */
+template <typename Key, typename Value, typename Hash = BloomHash<Key> >
+class HotKeyCache
+{
+public:
+    // Room for at least the given number of nodes, rounded up to a power of two.
+    explicit HotKeyCache(size_t entries);
+
+    // The node with key, or NULL if it is not cached.
+    Node<Key, Value>* lookup(const Key& key);
+    void remember(Node<Key, Value>* node);
+    void forget(const Node<Key, Value>* node);
+    void clear();
+
+    size_t capacity() const;
+    size_t hits() const;
+    size_t misses() const;
+    void resetCounters();
+
+protected:
+    struct Entry
+    {
+        std::atomic<Node<Key, Value>*> node;
+        std::atomic<uint64_t> tag;   // 0 for an empty entry
+    };
+
+    // Helper functions
+    uint64_t hashOf(const Key& key) const;
+    Entry* setFor(uint64_t h);
+    static uint64_t tagOf(uint64_t h);
+    static void store(Entry& entry, Node<Key, Value>* node, uint64_t tag);
+    static void bump(std::atomic<size_t>& counter);
+
+protected:
+    std::vector<Entry> entries_;    // sets of two, front first
+    unsigned setBits_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    Hash hash_;
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the HotKeyCache class.
+  ------------------------------------------------
+*/
+
+template <typename Key, typename Value, typename Hash>
+HotKeyCache<Key, Value, Hash>::HotKeyCache(size_t entries) :
+    setBits_(0), hits_(0), misses_(0)
+{
+    while(((size_t)2 << setBits_) < entries) setBits_++;
+    std::vector<Entry>((size_t)2 << setBits_).swap(entries_);
+    clear();
+}
+
+/**
+* A node is only returned once its own key has been compared, so an entry
+* torn by a concurrent lookup is just a miss.
+*/
+template <typename Key, typename Value, typename Hash>
+Node<Key, Value>* HotKeyCache<Key, Value, Hash>::lookup(const Key& key)
+{
+    uint64_t h = hashOf(key);
+    uint64_t tag = tagOf(h);
+    Entry* set = setFor(h);
+    for(int way = 0; way < 2; way++) {
+        if(set[way].tag.load(std::memory_order_relaxed) != tag) continue;
+        Node<Key, Value>* node = set[way].node.load(std::memory_order_relaxed);
+        if(node == NULL || node->getKey() != key) continue;
+        if(way == 1) {
+            store(set[1], set[0].node.load(std::memory_order_relaxed), set[0].tag.load(std::memory_order_relaxed));
+            store(set[0], node, tag);
+        }
+        bump(hits_);
+        return node;
+    }
+    bump(misses_);
+    return NULL;
+}
+
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::remember(Node<Key, Value>* node)
+{
+    uint64_t h = hashOf(node->getKey());
+    Entry* set = setFor(h);
+    if(set[0].node.load(std::memory_order_relaxed) == node || set[1].node.load(std::memory_order_relaxed) == node)
+        return;
+    store(set[1], node, tagOf(h));
+}
+
+/**
+* Drops the node's entries, if it has any; racing promotions may have left
+* it in both ways. The node must still be alive, as its key locates the set.
+*/
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::forget(const Node<Key, Value>* node)
+{
+    Entry* set = setFor(hashOf(node->getKey()));
+    for(int way = 0; way < 2; way++) {
+        if(set[way].node.load(std::memory_order_relaxed) == node)
+            store(set[way], NULL, 0);
+    }
+    if(set[0].node.load(std::memory_order_relaxed) == NULL) {
+        store(set[0], set[1].node.load(std::memory_order_relaxed), set[1].tag.load(std::memory_order_relaxed));
+        store(set[1], NULL, 0);
+    }
+}
+
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::clear()
+{
+    for(size_t i = 0; i < entries_.size(); i++)
+        store(entries_[i], NULL, 0);
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t HotKeyCache<Key, Value, Hash>::capacity() const
+{
+    return entries_.size();
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t HotKeyCache<Key, Value, Hash>::hits() const
+{
+    return hits_;
+}
+
+template <typename Key, typename Value, typename Hash>
+size_t HotKeyCache<Key, Value, Hash>::misses() const
+{
+    return misses_;
+}
+
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::resetCounters()
+{
+    hits_ = 0;
+    misses_ = 0;
+}
+
+/**
+* Helper function: hashOf
+*
+* std::hash is the identity for integers, so the result is multiplied by a
+* 64-bit odd constant; sets come from the high bits of the product.
+*/
+template <typename Key, typename Value, typename Hash>
+uint64_t HotKeyCache<Key, Value, Hash>::hashOf(const Key& key) const
+{
+    return (uint64_t)hash_(key) * 0x9e3779b97f4a7c15ULL;
+}
+
+template <typename Key, typename Value, typename Hash>
+typename HotKeyCache<Key, Value, Hash>::Entry* HotKeyCache<Key, Value, Hash>::setFor(uint64_t h)
+{
+    size_t set = (setBits_ == 0) ? 0 : (size_t)(h >> (64 - setBits_));
+    return &entries_[2 * set];
+}
+
+template <typename Key, typename Value, typename Hash>
+uint64_t HotKeyCache<Key, Value, Hash>::tagOf(uint64_t h)
+{
+    return h | 1;
+}
+
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::store(Entry& entry, Node<Key, Value>* node, uint64_t tag)
+{
+    entry.node.store(node, std::memory_order_relaxed);
+    entry.tag.store(tag, std::memory_order_relaxed);
+}
+
+/**
+* Helper function: bump
+*
+* A load and a store rather than an atomic increment, so a find pays no
+* locked instruction; concurrent finds may lose a few counts.
+*/
+template <typename Key, typename Value, typename Hash>
+void HotKeyCache<Key, Value, Hash>::bump(std::atomic<size_t>& counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the HotKeyCache class.
+  ----------------------------------------------
+*/
+
+#endif
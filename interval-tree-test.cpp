@@ -0,0 +1,71 @@
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include "interval-tree.h"
+
+using namespace std;
+
+typedef vector<pair<Interval<int>, int> > Hits;
+
+void printHits(const string& label, const Hits& hits)
+{
+    cout << label << ":";
+    for(size_t i = 0; i < hits.size(); i++)
+        cout << " " << hits[i].first;
+    cout << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    IntervalTree<int,int> it;
+    const int spans[][2] = { {15, 20}, {10, 30}, {17, 19}, {5, 20}, {12, 15}, {30, 40}, {5, 8} };
+    for(int i = 0; i < 7; i++) it.insert(spans[i][0], spans[i][1], i);
+
+    Hits hits;
+    it.stab(18, hits);
+    printHits("Containing 18", hits);
+    hits.clear();
+    it.overlap(21, 31, hits);
+    printHits("Overlapping [21,31]", hits);
+    it.remove(10, 30);
+    hits.clear();
+    it.overlap(21, 31, hits);
+    printHits("After removing [10,30]", hits);
+
+    // Randomized against a brute force scan
+    IntervalTree<int,int> rt;
+    rt.attachFilter(20000);
+    vector<pair<int,int> > live;
+    srand(104);
+    bool ok = true;
+    for(int i = 0; ok && i < 20000; i++) {
+        if(!live.empty() && rand() % 3 == 0) {
+            size_t victim = rand() % live.size();
+            rt.remove(live[victim].first, live[victim].second);
+            live[victim] = live.back();
+            live.pop_back();
+        }
+        else {
+            int start = rand() % 10000;
+            int end = start + rand() % 300;
+            bool known = false;
+            for(size_t j = 0; j < live.size() && !known; j++)
+                known = live[j] == make_pair(start, end);
+            if(!known) live.push_back(make_pair(start, end));
+            rt.insert(start, end, i);
+        }
+        int lo = rand() % 10000;
+        int hi = lo + rand() % 50;
+        hits.clear();
+        rt.overlap(lo, hi, hits);
+        size_t expected = 0;
+        for(size_t j = 0; j < live.size(); j++)
+            expected += (live[j].first <= hi && lo <= live[j].second);
+        ok = hits.size() == expected && rt.isBalanced();
+        for(size_t j = 0; ok && j < hits.size(); j++)
+            ok = hits[j].first.overlaps(lo, hi) &&
+                 (j == 0 || hits[j - 1].first < hits[j].first);
+    }
+    cout << "Randomized queries match: " << ok << endl;
+    return 0;
+}
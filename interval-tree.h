@@ -0,0 +1,161 @@
+#ifndef INTERVAL_TREE_H
+#define INTERVAL_TREE_H
+
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "aggregate-avlbst.h"
+
+/**
+ * A closed interval [start, end], ordered by start and then by end.
+ */
+template <typename T>
+struct Interval
+{
+    Interval() : start(), end() { }
+    Interval(const T& s, const T& e) : start(s), end(e) { }
+
+    bool contains(const T& point) const { return !(point < start) && !(end < point); }
+    bool overlaps(const T& lo, const T& hi) const { return !(hi < start) && !(end < lo); }
+
+    friend bool operator<(const Interval& a, const Interval& b)
+    {
+        return a.start < b.start || (!(b.start < a.start) && a.end < b.end);
+    }
+    friend bool operator>(const Interval& a, const Interval& b) { return b < a; }
+    friend bool operator==(const Interval& a, const Interval& b) { return !(a < b) && !(b < a); }
+    friend bool operator!=(const Interval& a, const Interval& b) { return !(a == b); }
+    friend std::ostream& operator<<(std::ostream& os, const Interval& i)
+    {
+        return os << "[" << i.start << "," << i.end << "]";
+    }
+
+    T start;
+    T end;
+};
+
+namespace std {
+template <typename T>
+struct hash<Interval<T> >
+{
+    size_t operator()(const Interval<T>& i) const
+    {
+        size_t h = hash<T>()(i.start);
+        return h ^ (hash<T>()(i.end) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+    }
+};
+}
+
+/**
+ * Aggregate policy for IntervalTree: the largest interval end in a subtree.
+ */
+template <typename T, typename Value>
+struct MaxEndAggregate
+{
+    typedef T summary_type;
+    static summary_type identity() { return std::numeric_limits<T>::lowest(); }
+    static summary_type lift(const Interval<T>& interval, const Value&) { return interval.end; }
+    static summary_type combine(const summary_type& a, const summary_type& b) { return a < b ? b : a; }
+};
+
+/**
+ * A set of closed intervals with a value each, ordered by start (then end)
+ * and augmented with the maximum end of every subtree.
+ *
+ * A query skips any subtree whose maximum end lies before it and, once a
+ * node starts after it, that node's whole right subtree, so stabbing and
+ * overlap queries cost O((k + 1) log n) for k results: each result may
+ * take a descent of its own, plus one down to where starts pass the
+ * query. The maximum ends are kept by AggregateAVLTree through the
+ * rotation and retrace hooks of AVLTree.
+ */
+template <typename T, typename Value>
+class IntervalTree : public AggregateAVLTree<Interval<T>, Value, MaxEndAggregate<T, Value> >
+{
+public:
+    typedef Interval<T> interval_type;
+    typedef AggregateAVLTree<interval_type, Value, MaxEndAggregate<T, Value> > base_type;
+
+    using base_type::insert;
+    using base_type::remove;
+    void insert(const T& start, const T& end, const Value& value);
+    void remove(const T& start, const T& end);
+
+    // Appends every item whose interval contains point, in start order.
+    void stab(const T& point, std::vector<std::pair<interval_type, Value> >& out) const;
+    // Appends every item whose interval overlaps [lo, hi], in start order.
+    void overlap(const T& lo, const T& hi, std::vector<std::pair<interval_type, Value> >& out) const;
+
+protected:
+    // Helper functions
+    void collect(Node<interval_type, Value>* node, const T& lo, const T& hi,
+                 std::vector<std::pair<interval_type, Value> >& out) const;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the IntervalTree class.
+  --------------------------------------------------
+*/
+
+/**
+* Inserts [start, end]; an identical interval has its value overwritten.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::insert(const T& start, const T& end, const Value& value)
+{
+    base_type::insert(std::make_pair(interval_type(start, end), value));
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::remove(const T& start, const T& end)
+{
+    base_type::remove(interval_type(start, end));
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::stab(const T& point, std::vector<std::pair<interval_type, Value> >& out) const
+{
+    overlap(point, point, out);
+}
+
+template<class T, class Value>
+void IntervalTree<T, Value>::overlap(const T& lo, const T& hi, std::vector<std::pair<interval_type, Value> >& out) const
+{
+    this->refresh();
+    collect(this->root_, lo, hi, out);
+}
+
+/**
+* Helper function: collect
+*
+* In-order walk of the subtree at node that prunes on the cached maximum
+* end (nothing below ends at or after lo) and on start (nothing to the
+* right starts at or before hi). A subtree is only entered when something
+* in it ends late enough, but the results can be spread across it, so the
+* walk visits O(log n) nodes per result rather than O(log n) in all.
+*/
+template<class T, class Value>
+void IntervalTree<T, Value>::collect(Node<interval_type, Value>* node, const T& lo, const T& hi,
+                                     std::vector<std::pair<interval_type, Value> >& out) const
+{
+    while(node != NULL && !(this->summaryOf(node) < lo)) {
+        collect(node->getLeft(), lo, hi, out);
+        const interval_type& interval = node->getKey();
+        if(hi < interval.start)
+            return;
+        if(!(interval.end < lo))
+            out.push_back(std::make_pair(interval, node->getValue()));
+        node = node->getRight();
+    }
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the IntervalTree class.
+  ------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <map>
+#include <vector>
+#include <cstdlib>
+#include <stdexcept>
+#include "lsm-store.h"
+
+using namespace std;
+
+
+int main(int argc, char *argv[])
+{
+    // Small memtable so the test exercises freezing, runs and compaction
+    LsmStore<int,int> store(".", 64, 8, 4);
+    map<int,int> reference;
+
+    srand(104);
+    for(int i = 0; i < 5000; i++) {
+        int key = rand() % 2000;
+        if(rand() % 4 == 0) {
+            store.remove(key);
+            reference.erase(key);
+        }
+        else {
+            store.insert(make_pair(key, i));
+            reference[key] = i;
+        }
+    }
+
+    int mismatches = 0;
+    for(int key = 0; key < 2000; key++) {
+        int value;
+        bool found = store.find(key, value);
+        map<int,int>::iterator it = reference.find(key);
+        if(found != (it != reference.end()) || (found && value != it->second))
+            mismatches++;
+    }
+    cout << "Point lookup mismatches: " << mismatches << endl;
+
+    store.flush();
+    cout << "Runs after flush: " << store.runCount() << endl;
+
+    vector<pair<int,int> > out;
+    store.range(500, 600, out);
+    map<int,int>::iterator lo = reference.lower_bound(500);
+    map<int,int>::iterator hi = reference.upper_bound(600);
+    vector<pair<int,int> > expected(lo, hi);
+    cout << "Range [500,600] matches: " << (out == expected) << endl;
+    cout << "Range [500,600] items: " << out.size() << endl;
+
+    // A store that cannot write its runs reports it and keeps the data
+    LsmStore<int,int> broken("./no-such-directory", 4, 2, 4);
+    for(int i = 0; i < 4; i++) broken.insert(make_pair(i, i * 10));
+    try {
+        broken.flush();
+        cout << "Flush into a missing directory succeeded" << endl;
+    }
+    catch(runtime_error& e) {
+        cout << "Flush failed: " << e.what() << endl;
+    }
+    int value = -1;
+    bool kept = broken.find(3, value);
+    cout << "Unwritten data still found: " << (kept && value == 30) << endl;
+
+    return 0;
+}
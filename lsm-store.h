@@ -0,0 +1,677 @@
+#ifndef LSM_STORE_H
+#define LSM_STORE_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include "avlbst.h"
+
+/**
+ * An ordered key/value store that uses an AVLTree as its mutable write
+ * buffer (the "memtable").
+ *
+ * Writes go into the active tree. Once it holds memtableLimit entries it
+ * is frozen and a worker thread streams it, in order, into an immutable
+ * sorted run file. Every indexStride-th key of a run is kept in memory as
+ * a sparse index, so memory use is bounded by two memtables plus
+ * size/indexStride keys no matter how much data the store holds.
+ *
+ * Lookups merge the active tree, the frozen tree and the runs from newest
+ * to oldest. Removes are recorded as tombstones so they shadow older runs.
+ * Runs are size tiered: when compactionFanIn adjacent runs share a tier the
+ * worker merges them into one run of the next tier.
+ *
+ * Key and Value must be trivially copyable since runs store them as raw
+ * bytes. Run files are scratch files owned by the store and are deleted
+ * when it is destroyed.
+ *
+ * If the worker cannot write a run, the frozen tree or the runs it was
+ * merging stay where they are, so no data is lost, and the error is thrown
+ * as a std::runtime_error from the next insert, remove or flush. The worker
+ * retries once that error has been reported.
+ */
+template <typename Key, typename Value>
+class LsmStore
+{
+public:
+    LsmStore(const std::string& dir, size_t memtableLimit = 65536,
+             size_t indexStride = 64, size_t compactionFanIn = 4);
+    ~LsmStore();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    void range(const Key& lo, const Key& hi, std::vector<std::pair<Key, Value> >& out) const;
+
+    // Freezes the active tree and blocks until every frozen tree is on disk
+    // and no compaction is pending. Throws if the worker failed to write.
+    void flush();
+
+    size_t runCount() const;
+    size_t memtableSize() const;
+
+protected:
+    /**
+     * A memtable slot: the value plus a flag marking the key as deleted.
+     */
+    struct Slot {
+        Value value;
+        bool tombstone;
+
+        // Needed by BinarySearchTree::printRoot
+        friend std::ostream& operator<<(std::ostream& out, const Slot& slot)
+        {
+            if(slot.tombstone) return out << "<deleted>";
+            return out << slot.value;
+        }
+    };
+    typedef AVLTree<Key, Slot> Memtable;
+
+    /**
+     * An immutable sorted run on disk together with its sparse index.
+     */
+    struct Run {
+        std::string path;
+        int fd;
+        size_t count;
+        size_t level;               // number of merges that produced the run
+        std::vector<Key> index;     // key of every indexStride-th record
+        ~Run();
+    };
+    typedef std::shared_ptr<Run> RunPtr;
+
+    static const size_t RECORD_SIZE = sizeof(Key) + 1 + sizeof(Value);
+
+    /**
+     * A forward cursor over one source (a memtable or a run) positioned
+     * at its first key that is not less than a start key.
+     */
+    class Cursor
+    {
+    public:
+        virtual ~Cursor() { }
+        virtual bool valid() const = 0;
+        virtual const Key& key() const = 0;
+        virtual const Slot& slot() const = 0;
+        virtual void next() = 0;
+    };
+    class MemtableCursor;
+    class RunCursor;
+
+    // Helper functions
+    RunPtr writeRun(std::vector<Cursor*>& sources, bool dropTombstones);
+    static void readRecord(const Run& run, size_t pos, Key& key, Slot& slot);
+    static bool findInRun(const Run& run, size_t stride, const Key& key, Slot& slot);
+    static size_t seekRun(const Run& run, size_t stride, const Key& key);
+    static void mergeNext(std::vector<Cursor*>& sources, Key& key, Slot& slot);
+    static void deleteCursors(std::vector<Cursor*>& sources);
+    void throwIfFailedLocked();
+    bool pickCompaction(size_t& first) const;
+    void freezeLocked(std::unique_lock<std::mutex>& lock);
+    void worker();
+    void work(std::unique_lock<std::mutex>& lock, size_t first);
+
+protected:
+    std::string dir_;
+    size_t memtableLimit_;
+    size_t indexStride_;
+    size_t fanIn_;
+    size_t nextRunId_;
+
+    Memtable* active_;
+    Memtable* frozen_;
+    std::vector<RunPtr> runs_;  // newest first
+
+    mutable std::mutex mutex_;
+    std::condition_variable workAvailable_;
+    std::condition_variable workDone_;
+    bool busy_;
+    bool stopping_;
+    std::string error_;         // last worker failure not yet reported
+    std::thread worker_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the LsmStore cursors.
+  --------------------------------------------------
+*/
+
+template <typename Key, typename Value>
+class LsmStore<Key, Value>::MemtableCursor : public LsmStore<Key, Value>::Cursor
+{
+public:
+    MemtableCursor(const Memtable& tree, const Key& start) :
+        it_(tree.lower_bound(start)), end_(tree.end())
+    {
+    }
+    explicit MemtableCursor(const Memtable& tree) :
+        it_(tree.begin()), end_(tree.end())
+    {
+    }
+    virtual bool valid() const { return it_ != end_; }
+    virtual const Key& key() const { return it_->first; }
+    virtual const Slot& slot() const { return it_->second; }
+    virtual void next() { ++it_; }
+private:
+    typename Memtable::iterator it_;
+    typename Memtable::iterator end_;
+};
+
+/**
+ * Streams a run from disk, reading one sparse-index block at a time.
+ */
+template <typename Key, typename Value>
+class LsmStore<Key, Value>::RunCursor : public LsmStore<Key, Value>::Cursor
+{
+public:
+    RunCursor(const Run& run, size_t stride, const Key& start) :
+        run_(run), stride_(stride), pos_(LsmStore<Key, Value>::seekRun(run, stride, start))
+    {
+        load();
+        while(valid() && key_ < start)
+            next();
+    }
+    RunCursor(const Run& run, size_t stride) :
+        run_(run), stride_(stride), pos_(0)
+    {
+        load();
+    }
+    virtual bool valid() const { return pos_ < run_.count; }
+    virtual const Key& key() const { return key_; }
+    virtual const Slot& slot() const { return slot_; }
+    virtual void next()
+    {
+        pos_++;
+        load();
+    }
+private:
+    void load()
+    {
+        if(pos_ < run_.count)
+            LsmStore<Key, Value>::readRecord(run_, pos_, key_, slot_);
+    }
+    const Run& run_;
+    size_t stride_;
+    size_t pos_;
+    Key key_;
+    Slot slot_;
+};
+
+/*
+  ------------------------------------------------
+  End implementations for the LsmStore cursors.
+  ------------------------------------------------
+*/
+
+/*
+  -------------------------------------------
+  Begin implementations for the LsmStore class.
+  -------------------------------------------
+*/
+
+template <typename Key, typename Value>
+LsmStore<Key, Value>::Run::~Run()
+{
+    if(fd >= 0)
+        close(fd);
+    std::remove(path.c_str());
+}
+
+/**
+* Constructs an empty store whose runs will be written into dir.
+*/
+template <typename Key, typename Value>
+LsmStore<Key, Value>::LsmStore(const std::string& dir, size_t memtableLimit,
+                               size_t indexStride, size_t compactionFanIn) :
+    dir_(dir),
+    memtableLimit_(memtableLimit > 0 ? memtableLimit : 1),
+    indexStride_(indexStride > 0 ? indexStride : 1),
+    fanIn_(compactionFanIn > 1 ? compactionFanIn : 2),
+    nextRunId_(0),
+    active_(new Memtable()),
+    frozen_(NULL),
+    busy_(false),
+    stopping_(false)
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "LsmStore keys must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "LsmStore values must be trivially copyable");
+    worker_ = std::thread(&LsmStore<Key, Value>::worker, this);
+}
+
+/**
+* Stops the worker and discards the memtables and run files.
+*/
+template <typename Key, typename Value>
+LsmStore<Key, Value>::~LsmStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    workAvailable_.notify_all();
+    worker_.join();
+    delete active_;
+    delete frozen_;
+}
+
+/**
+* Inserts or overwrites a key, freezing the active tree first if it is full.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailedLocked();
+    if(active_->size() >= memtableLimit_)
+        freezeLocked(lock);
+    Slot slot;
+    slot.value = keyValuePair.second;
+    slot.tombstone = false;
+    active_->insert(std::make_pair(keyValuePair.first, slot));
+}
+
+/**
+* Records a tombstone for key so older copies in runs are shadowed.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::remove(const Key& key)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailedLocked();
+    if(active_->size() >= memtableLimit_)
+        freezeLocked(lock);
+    Slot slot = Slot();
+    slot.tombstone = true;
+    active_->insert(std::make_pair(key, slot));
+}
+
+/**
+* Looks key up from the newest source to the oldest.
+* Returns true and sets value if the key is live.
+*/
+template <typename Key, typename Value>
+bool LsmStore<Key, Value>::find(const Key& key, Value& value) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Slot* found = NULL;
+    typename Memtable::iterator it = active_->find(key);
+    if(it != active_->end())
+        found = &it->second;
+    else if(frozen_ != NULL && (it = frozen_->find(key)) != frozen_->end())
+        found = &it->second;
+    if(found != NULL) {
+        if(found->tombstone) return false;
+        value = found->value;
+        return true;
+    }
+    Slot slot;
+    for(size_t i = 0; i < runs_.size(); i++) {
+        if(findInRun(*runs_[i], indexStride_, key, slot)) {
+            if(slot.tombstone) return false;
+            value = slot.value;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+* Appends every live item with lo <= key <= hi to out, in key order.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::range(const Key& lo, const Key& hi, std::vector<std::pair<Key, Value> >& out) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Cursor*> sources;
+    sources.push_back(new MemtableCursor(*active_, lo));
+    if(frozen_ != NULL)
+        sources.push_back(new MemtableCursor(*frozen_, lo));
+    for(size_t i = 0; i < runs_.size(); i++)
+        sources.push_back(new RunCursor(*runs_[i], indexStride_, lo));
+
+    Key key;
+    Slot slot;
+    try {
+        while(true) {
+            mergeNext(sources, key, slot);
+            if(sources.empty() || hi < key)
+                break;
+            if(!slot.tombstone)
+                out.push_back(std::make_pair(key, slot.value));
+        }
+    }
+    catch(...) {
+        deleteCursors(sources);
+        throw;
+    }
+    deleteCursors(sources);
+}
+
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::flush()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    throwIfFailedLocked();
+    if(!active_->empty())
+        freezeLocked(lock);
+    size_t first;
+    while(busy_ || frozen_ != NULL || pickCompaction(first)) {
+        workDone_.wait(lock);
+        throwIfFailedLocked();
+    }
+}
+
+template <typename Key, typename Value>
+size_t LsmStore<Key, Value>::runCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return runs_.size();
+}
+
+template <typename Key, typename Value>
+size_t LsmStore<Key, Value>::memtableSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return active_->size() + (frozen_ != NULL ? frozen_->size() : 0);
+}
+
+/**
+* Helper function: pickCompaction
+*
+* Looks for compactionFanIn adjacent runs of the same tier, oldest first,
+* and sets first to the index of the newest of them.
+*/
+template <typename Key, typename Value>
+bool LsmStore<Key, Value>::pickCompaction(size_t& first) const
+{
+    size_t end = runs_.size();
+    while(end >= fanIn_) {
+        size_t begin = end - 1;
+        while(begin > 0 && runs_[begin - 1]->level == runs_[end - 1]->level)
+            begin--;
+        if(end - begin >= fanIn_) {
+            first = end - fanIn_;
+            return true;
+        }
+        end = begin;
+    }
+    return false;
+}
+
+/**
+* Helper function: freezeLocked
+*
+* Moves the active tree into the frozen slot, waiting for the worker to
+* finish the previous one if necessary (this is the write backpressure).
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::freezeLocked(std::unique_lock<std::mutex>& lock)
+{
+    while(frozen_ != NULL) {
+        workDone_.wait(lock);
+        throwIfFailedLocked();
+    }
+    frozen_ = active_;
+    active_ = new Memtable();
+    workAvailable_.notify_one();
+}
+
+/**
+* Helper function: mergeNext
+*
+* Pops the smallest key across sources. Sources are ordered newest first,
+* so on equal keys the first one wins and the rest are skipped.
+* Exhausted cursors are deleted and dropped from sources.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::mergeNext(std::vector<Cursor*>& sources, Key& key, Slot& slot)
+{
+    for(size_t i = 0; i < sources.size(); ) {
+        if(!sources[i]->valid()) {
+            delete sources[i];
+            sources.erase(sources.begin() + i);
+        }
+        else i++;
+    }
+    if(sources.empty()) return;
+    size_t best = 0;
+    for(size_t i = 1; i < sources.size(); i++) {
+        if(sources[i]->key() < sources[best]->key())
+            best = i;
+    }
+    key = sources[best]->key();
+    slot = sources[best]->slot();
+    for(size_t i = 0; i < sources.size(); i++) {
+        if(!(key < sources[i]->key()) && !(sources[i]->key() < key))
+            sources[i]->next();
+    }
+}
+
+/**
+* Helper function: deleteCursors
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::deleteCursors(std::vector<Cursor*>& sources)
+{
+    for(size_t i = 0; i < sources.size(); i++)
+        delete sources[i];
+    sources.clear();
+}
+
+/**
+* Helper function: throwIfFailedLocked
+*
+* Reports a worker failure once, then lets the worker try again.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::throwIfFailedLocked()
+{
+    if(error_.empty()) return;
+    std::string error;
+    error.swap(error_);
+    workAvailable_.notify_one();
+    throw std::runtime_error(error);
+}
+
+/**
+* Helper function: writeRun
+*
+* Streams the merge of sources into a new run file and builds its sparse
+* index. Consumes (deletes) the cursors. Throws if the run cannot be
+* written, leaving no file behind.
+*/
+template <typename Key, typename Value>
+typename LsmStore<Key, Value>::RunPtr LsmStore<Key, Value>::writeRun(std::vector<Cursor*>& sources, bool dropTombstones)
+{
+    RunPtr run(new Run());
+    run->fd = -1;
+    run->count = 0;
+    run->level = 0;
+    run->path = dir_ + "/run-" + std::to_string(nextRunId_++) + ".sst";
+    FILE* out = std::fopen(run->path.c_str(), "wb");
+    if(out == NULL) {
+        deleteCursors(sources);
+        throw std::runtime_error("LsmStore: cannot create " + run->path);
+    }
+
+    // run removes its file if anything below throws
+    unsigned char record[RECORD_SIZE];
+    Key key;
+    Slot slot;
+    bool written = true;
+    try {
+        while(written) {
+            mergeNext(sources, key, slot);
+            if(sources.empty()) break;
+            if(dropTombstones && slot.tombstone) continue;
+            if(run->count % indexStride_ == 0)
+                run->index.push_back(key);
+            std::memcpy(record, &key, sizeof(Key));
+            record[sizeof(Key)] = slot.tombstone ? 1 : 0;
+            std::memcpy(record + sizeof(Key) + 1, &slot.value, sizeof(Value));
+            written = std::fwrite(record, RECORD_SIZE, 1, out) == 1;
+            run->count++;
+        }
+    }
+    catch(...) {
+        std::fclose(out);
+        deleteCursors(sources);
+        throw;
+    }
+    deleteCursors(sources);
+    if(std::fclose(out) != 0 || !written)
+        throw std::runtime_error("LsmStore: cannot write " + run->path);
+    run->fd = open(run->path.c_str(), O_RDONLY);
+    if(run->fd < 0)
+        throw std::runtime_error("LsmStore: cannot reopen " + run->path);
+    return run;
+}
+
+/**
+* Helper function: readRecord
+*
+* Reads record pos of a run with a positional read, so several threads
+* may read the same run at once. Throws if the record cannot be read, since
+* every pos below run.count was written.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::readRecord(const Run& run, size_t pos, Key& key, Slot& slot)
+{
+    unsigned char record[RECORD_SIZE];
+    if(pread(run.fd, record, RECORD_SIZE, pos * RECORD_SIZE) != (ssize_t)RECORD_SIZE)
+        throw std::runtime_error("LsmStore: cannot read " + run.path);
+    std::memcpy(&key, record, sizeof(Key));
+    slot.tombstone = record[sizeof(Key)] != 0;
+    std::memcpy(&slot.value, record + sizeof(Key) + 1, sizeof(Value));
+}
+
+/**
+* Helper function: seekRun
+*
+* Returns the position of the first record of the index block that could
+* hold key.
+*/
+template <typename Key, typename Value>
+size_t LsmStore<Key, Value>::seekRun(const Run& run, size_t stride, const Key& key)
+{
+    typename std::vector<Key>::const_iterator it =
+        std::upper_bound(run.index.begin(), run.index.end(), key);
+    if(it == run.index.begin()) return 0;
+    return (size_t)(it - run.index.begin() - 1) * stride;
+}
+
+/**
+* Helper function: findInRun
+*
+* Scans the single index block of a run that could contain key.
+*/
+template <typename Key, typename Value>
+bool LsmStore<Key, Value>::findInRun(const Run& run, size_t stride, const Key& key, Slot& slot)
+{
+    if(run.count == 0 || key < run.index.front()) return false;
+    size_t pos = seekRun(run, stride, key);
+    size_t end = std::min(pos + stride, run.count);
+    Key current;
+    for(; pos < end; pos++) {
+        readRecord(run, pos, current, slot);
+        if(key < current) return false;
+        if(!(current < key)) return true;
+    }
+    return false;
+}
+
+/**
+* Helper function: worker
+*
+* Background thread that writes frozen trees to runs and compacts runs
+* once compactionFanIn of them exist. A failed write leaves its inputs in
+* place and parks the worker until the error has been reported.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t first = 0;
+    while(true) {
+        while(!stopping_ && (!error_.empty() || (frozen_ == NULL && !pickCompaction(first))))
+            workAvailable_.wait(lock);
+        if(stopping_) break;
+        busy_ = true;
+
+        try {
+            work(lock, first);
+        }
+        catch(std::exception& e) {
+            if(!lock.owns_lock()) lock.lock();
+            error_ = e.what();
+        }
+        busy_ = false;
+        workDone_.notify_all();
+    }
+}
+
+/**
+* Helper function: work
+*
+* One step of the worker: writes the frozen tree, or else merges the runs
+* from first on. Called and returns with the lock held.
+*/
+template <typename Key, typename Value>
+void LsmStore<Key, Value>::work(std::unique_lock<std::mutex>& lock, size_t first)
+{
+    if(frozen_ != NULL) {
+        // The frozen tree is never written again, so it can be read
+        // without the lock while readers keep using it.
+        Memtable* frozen = frozen_;
+        lock.unlock();
+        std::vector<Cursor*> sources(1, new MemtableCursor(*frozen));
+        RunPtr run = writeRun(sources, false);
+        lock.lock();
+        runs_.insert(runs_.begin(), run);
+        frozen_ = NULL;
+        delete frozen;
+    }
+    else {
+        // Runs only ever get prepended while we work, so the victims
+        // keep their distance from the back of runs_. Tombstones can
+        // be dropped when nothing older than the victims remains.
+        size_t fromBack = runs_.size() - first;
+        std::vector<RunPtr> victims(runs_.begin() + first, runs_.begin() + first + fanIn_);
+        bool oldest = (first + fanIn_ == runs_.size());
+        lock.unlock();
+        std::vector<Cursor*> sources;
+        try {
+            for(size_t i = 0; i < victims.size(); i++)
+                sources.push_back(new RunCursor(*victims[i], indexStride_));
+        }
+        catch(...) {
+            deleteCursors(sources);
+            throw;
+        }
+        RunPtr merged = writeRun(sources, oldest);
+        merged->level = victims.front()->level + 1;
+        lock.lock();
+        first = runs_.size() - fromBack;
+        runs_.erase(runs_.begin() + first, runs_.begin() + first + fanIn_);
+        runs_.insert(runs_.begin() + first, merged);
+    }
+}
+
+/*
+  -----------------------------------------
+  End implementations for the LsmStore class.
+  -----------------------------------------
+*/
+
+#endif
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "ordered-cache.h"
+
+using namespace std;
+
+
+// A clock the test moves by hand
+struct FakeClock
+{
+    typedef std::chrono::milliseconds duration;
+    typedef duration::rep rep;
+    typedef duration::period period;
+    typedef std::chrono::time_point<FakeClock> time_point;
+    static const bool is_steady = true;
+    static time_point now() { return current; }
+    static time_point current;
+};
+FakeClock::time_point FakeClock::current;
+
+typedef OrderedCache<int, int, FakeClock> Cache;
+
+void printKeys(const string& label, Cache& cache)
+{
+    cout << label << ":";
+    for(Cache::iterator it = cache.begin(); it != cache.end(); ++it) cout << " " << it->first;
+    cout << endl;
+}
+
+// Random inserts, gets and removes against a list-and-map LRU model
+bool matchesModel(Cache& cache, size_t capacity, unsigned seed)
+{
+    list<int> recency;      // most recent first
+    map<int, pair<int, list<int>::iterator> > model;
+    srand(seed);
+    bool ok = true;
+    for(int i = 0; ok && i < 20000; i++) {
+        int key = rand() % 300;
+        int op = rand() % 10;
+        map<int, pair<int, list<int>::iterator> >::iterator found = model.find(key);
+        if(op < 5) {
+            cache.insert(std::make_pair(key, i));
+            if(found != model.end()) recency.erase(found->second.second);
+            recency.push_front(key);
+            model[key] = std::make_pair(i, recency.begin());
+            if(model.size() > capacity) {
+                model.erase(recency.back());
+                recency.pop_back();
+            }
+        }
+        else if(op < 9) {
+            Cache::iterator it = cache.get(key);
+            if(found == model.end()) ok = (it == cache.end());
+            else {
+                ok = (it != cache.end() && it->second == found->second.first);
+                recency.erase(found->second.second);
+                recency.push_front(key);
+                found->second.second = recency.begin();
+            }
+        }
+        else {
+            cache.remove(key);
+            if(found != model.end()) {
+                recency.erase(found->second.second);
+                model.erase(found);
+            }
+        }
+        if(i == 10000) cache.compactLayout();
+    }
+    return ok && cache.size() == model.size() && cache.isBalanced();
+}
+
+int main(int argc, char *argv[])
+{
+    // Least recently used entries go first
+    Cache lru(3);
+    lru.insert(std::make_pair(1, 10));
+    lru.insert(std::make_pair(2, 20));
+    lru.insert(std::make_pair(3, 30));
+    lru.get(1);
+    lru.insert(std::make_pair(4, 40));
+    printKeys("After using 1 and adding 4", lru);
+    lru.insert(std::make_pair(3, 33));
+    lru.insert(std::make_pair(5, 50));
+    printKeys("After overwriting 3 and adding 5", lru);
+    cout << "Evictions: " << lru.evictions() << endl;
+
+    // A byte budget with entries charged by value length
+    OrderedCache<int, string, FakeClock> pages(0, 20);
+    pages.setSizer([](const int&, const string& value) { return value.size(); });
+    pages.insert(std::make_pair(1, string("aaaaaaaa")));
+    pages.insert(std::make_pair(2, string("bbbbbbbb")));
+    pages.insert(std::make_pair(3, string("cccc")));
+    pages.insert(std::make_pair(1, string("a")));
+    pages.insert(std::make_pair(4, string("dddddddddd")));
+    cout << "Byte budget keeps " << pages.size() << " entries, " << pages.bytes() << " bytes, has 2: "
+         << (pages.find(2) != pages.end()) << ", has 1: " << (pages.find(1) != pages.end()) << endl;
+
+    // Expiry in batches as the cache is used
+    Cache timed(0);
+    timed.setDefaultTtl(FakeClock::duration(1000));
+    for(int i = 0; i < 20; i++) timed.insert(std::make_pair(i, i));
+    timed.insert(std::make_pair(100, 100), FakeClock::duration(5000));
+    timed.insert(std::make_pair(200, 200), FakeClock::duration::zero());
+    FakeClock::current += FakeClock::duration(1500);
+    cout << "After 1.5 s, get(3) is end: " << (timed.get(3) == timed.end()) << ", size " << timed.size();
+    timed.get(100);
+    cout << ", then " << timed.size() << ", purged " << timed.purgeExpired() << ", left " << timed.size() << endl;
+    FakeClock::current += FakeClock::duration(5000);
+    cout << "After 6.5 s, get(100) is end: " << (timed.get(100) == timed.end()) << ", get(200): "
+         << timed.get(200)->second << ", expirations: " << timed.expirations() << endl;
+
+    // Ordered scans see every entry and do not count as uses
+    Cache scanned(5);
+    for(int i = 0; i < 5; i++) scanned.insert(std::make_pair(i * 10, i));
+    int sum = 0;
+    for(Cache::iterator it = scanned.lower_bound(15); it != scanned.end() && it->first <= 35; ++it) sum += it->second;
+    scanned.insert(std::make_pair(50, 5));
+    cout << "Range 15..35 sums to " << sum << "; scanning did not save 0: " << (scanned.find(0) == scanned.end()) << endl;
+
+    // Against a model, with a relayout moving every node half way through
+    Cache random(100);
+    bool ok = matchesModel(random, 100, 45);
+    cout << "Randomized LRU matches: " << ok << ", evictions: " << random.evictions() << endl;
+
+    // Copies keep recency; handles and merges arrive as the newest entries
+    Cache copy(random);
+    copy.insert(std::make_pair(1000, 0));
+    random.insert(std::make_pair(1000, 0));
+    bool same = copy.size() == random.size();
+    for(Cache::iterator a = copy.begin(), b = random.begin(); same && a != copy.end(); ++a, ++b)
+        same = (a->first == b->first);
+    cout << "Copy evicts the same entry as the original: " << same << endl;
+    Cache target(4);
+    for(int i = 0; i < 4; i++) target.insert(std::make_pair(i, i));
+    target.get(0);
+    target.insert(lru.extract(5));
+    printKeys("After linking handle 5", target);
+    Cache source(10);
+    source.insert(std::make_pair(7, 7));
+    source.insert(std::make_pair(8, 8));
+    source.insert(std::make_pair(9, 9));
+    source.get(7);
+    cout << "Merged " << target.merge(source);
+    printKeys(", target now", target);
+
+    // The same through the AVLTree interface
+    AVLTree<int,int>& base = target;
+    AVLTree<int,int>::node_type handle = base.extract(9);
+    target.insert(std::make_pair(10, 10));
+    target.insert(std::make_pair(11, 11));
+    Cache spare(4);
+    AVLTree<int,int>& spareBase = spare;
+    spareBase.insert(std::move(handle));
+    for(int i = 20; i < 22; i++) spare.insert(std::make_pair(i, i));
+    cout << "Base merge moved " << base.merge(spareBase);
+    printKeys(", target now", target);
+    cout << "Spare size " << spare.size() << ", bytes charged for "
+         << spare.bytes() / sizeof(CacheAVLNode<int,int,FakeClock>) << " entries" << endl;
+
+    // Batches through the AVLTree interface keep the budget, on any number
+    // of threads, and clear through it leaves a usable cache
+    Cache batched(8);
+    AVLTree<int,int>& tree = batched;
+    std::vector<std::pair<int,int> > batch;
+    for(int i = 0; i < 100; i++) batch.push_back(std::make_pair(i, i));
+    tree.insert_batch(batch.begin(), batch.end(), 4);
+    printKeys("Batch of 100 into 8", batched);
+    tree.clear();
+    batched.insert(std::make_pair(1, 1));
+    batched.insert(std::make_pair(2, 2));
+    cout << "After clear: size " << batched.size() << ", bytes charged for "
+         << batched.bytes() / sizeof(CacheAVLNode<int,int,FakeClock>) << " entries" << endl;
+    return 0;
+}
@@ -0,0 +1,596 @@
+#ifndef ORDERED_CACHE_H
+#define ORDERED_CACHE_H
+
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "avlbst.h"
+
+template <typename Key, typename Value, typename Clock>
+class OrderedCache;
+
+/**
+ * An AVLNode that is also an entry of an OrderedCache: a link in its
+ * recency list, a slot in its expiry heap, and the bytes it is charged.
+ */
+template <typename Key, typename Value, typename Clock>
+class CacheAVLNode : public AVLNode<Key, Value>
+{
+public:
+    CacheAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~CacheAVLNode();
+
+    virtual CacheAVLNode<Key, Value, Clock>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
+protected:
+    friend class OrderedCache<Key, Value, Clock>;
+
+    CacheAVLNode<Key, Value, Clock>* newer_;    // towards the most recently used
+    CacheAVLNode<Key, Value, Clock>* older_;
+    typename Clock::time_point expiresAt_;      // time_point::max() if never
+    size_t heapIndex_;                          // NOT_IN_HEAP unless it expires
+    size_t charge_;                             // bytes counted against the budget
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the CacheAVLNode class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value, class Clock>
+CacheAVLNode<Key, Value, Clock>::CacheAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), newer_(NULL), older_(NULL),
+    expiresAt_(Clock::time_point::max()), heapIndex_((size_t)-1), charge_(0)
+{
+}
+
+template<class Key, class Value, class Clock>
+CacheAVLNode<Key, Value, Clock>::~CacheAVLNode()
+{
+}
+
+template<class Key, class Value, class Clock>
+CacheAVLNode<Key, Value, Clock>* CacheAVLNode<Key, Value, Clock>::cloneAt(void* where) const
+{
+    return new (where) CacheAVLNode<Key, Value, Clock>(*this);
+}
+
+template<class Key, class Value, class Clock>
+size_t CacheAVLNode<Key, Value, Clock>::footprint() const
+{
+    return sizeof(*this);
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the CacheAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+ * An AVLTree used as a bounded cache. Every entry is also on an intrusive
+ * recency list, and entries with a time to live sit in a binary min-heap
+ * by expiry time, all inside the tree nodes themselves.
+ *
+ * insert() and get() count as uses. Once the tree holds more than
+ * maxEntries entries or more than maxBytes bytes (either limit is off when
+ * 0), the least recently used entries are removed, O(log n) each. Bytes
+ * are the node's footprint unless a sizer says otherwise.
+ *
+ * Expiry needs no timers: every insert() and get() first removes up to
+ * EXPIRY_BATCH entries whose time has passed, and get() never returns an
+ * expired entry. Iteration, find and lower_bound are those of the tree, so
+ * ordered scans work as before and do not count as uses; they may still
+ * see expired entries that no batch has reached, which purgeExpired()
+ * removes all at once.
+ */
+template <typename Key, typename Value, typename Clock = std::chrono::steady_clock>
+class OrderedCache : public AVLTree<Key, Value>
+{
+public:
+    typedef typename Clock::duration duration;
+    typedef typename Clock::time_point time_point;
+    typedef std::function<size_t(const Key&, const Value&)> Sizer;
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    static const size_t EXPIRY_BATCH = 8;
+
+    explicit OrderedCache(size_t maxEntries, size_t maxBytes = 0);
+    OrderedCache(const OrderedCache& other);
+    OrderedCache(OrderedCache&& other) noexcept;
+    OrderedCache& operator=(const OrderedCache& other);
+    OrderedCache& operator=(OrderedCache&& other) noexcept;
+
+    // Time to live for entries inserted without one; zero (the default)
+    // means they never expire.
+    void setDefaultTtl(duration ttl);
+    void setSizer(const Sizer& sizer);
+
+    using AVLTree<Key, Value>::insert;
+    // Inserts or overwrites, restarting the entry's time to live.
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    void insert(const std::pair<const Key, Value>& keyValuePair, duration ttl);
+    // find() that counts as a use and never returns an expired entry.
+    iterator get(const Key& key);
+    virtual void clear();
+    // Removes every expired entry; returns how many there were.
+    size_t purgeExpired();
+
+    size_t bytes() const;
+    size_t evictions() const;
+    size_t expirations() const;
+
+protected:
+    typedef CacheAVLNode<Key, Value, Clock> CacheNode;
+    static const size_t NOT_IN_HEAP = (size_t)-1;
+
+    // insert_batch inserts one at a time on the calling thread, so that each
+    // entry is charged and the budget holds throughout; threads is ignored.
+    virtual void insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual void assignValue(Node<Key, Value>* node, const Value& value);
+    virtual void nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to);
+    // remove() and the pops end here, which unlist the entry first.
+    virtual void eraseNode(Node<Key, Value>* node);
+    // Node handles and merge leave through extractNode and arrive through
+    // adoptNode. An arriving node counts as just used and keeps its expiry
+    // time, so merge adds other's entries as the newest, in key order.
+    virtual typename AVLTree<Key, Value>::node_type extractNode(AVLNode<Key, Value>* node);
+    virtual void adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+
+    // Helper functions
+    void linkEntry(CacheNode* node);
+    void unlinkEntry(CacheNode* node);
+    void pushFront(CacheNode* node);
+    void unlist(CacheNode* node);
+    void setExpiry(CacheNode* node, duration ttl, time_point now);
+    size_t chargeFor(const CacheNode* node) const;
+    void evict(CacheNode* node);
+    size_t expireSome(time_point now, size_t limit);
+    void enforceBudget();
+    void relinkFrom(const OrderedCache& other);
+    void heapPush(CacheNode* node);
+    void heapErase(CacheNode* node);
+    void heapPlace(CacheNode* node, size_t i);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+
+protected:
+    size_t maxEntries_;
+    size_t maxBytes_;
+    duration defaultTtl_;
+    duration nextTtl_;          // for the node createNode makes next
+    Sizer sizer_;
+    CacheNode* newest_;
+    CacheNode* oldest_;
+    std::vector<CacheNode*> heap_;
+    size_t bytes_;
+    size_t evictions_;
+    size_t expirations_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the OrderedCache class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value, class Clock>
+OrderedCache<Key, Value, Clock>::OrderedCache(size_t maxEntries, size_t maxBytes) :
+    maxEntries_(maxEntries), maxBytes_(maxBytes), defaultTtl_(duration::zero()), nextTtl_(duration::zero()),
+    newest_(NULL), oldest_(NULL), bytes_(0), evictions_(0), expirations_(0)
+{
+}
+
+/**
+* The copied nodes still point at other's list and heap, so both are
+* rebuilt, finding each entry's copy by key: O(n log n).
+*/
+template<class Key, class Value, class Clock>
+OrderedCache<Key, Value, Clock>::OrderedCache(const OrderedCache& other) :
+    AVLTree<Key, Value>(other), maxEntries_(other.maxEntries_), maxBytes_(other.maxBytes_),
+    defaultTtl_(other.defaultTtl_), nextTtl_(other.defaultTtl_), sizer_(other.sizer_),
+    newest_(NULL), oldest_(NULL), bytes_(0), evictions_(0), expirations_(0)
+{
+    relinkFrom(other);
+}
+
+template<class Key, class Value, class Clock>
+OrderedCache<Key, Value, Clock>::OrderedCache(OrderedCache&& other) noexcept :
+    AVLTree<Key, Value>(std::move(other)), maxEntries_(other.maxEntries_), maxBytes_(other.maxBytes_),
+    defaultTtl_(other.defaultTtl_), nextTtl_(other.defaultTtl_), sizer_(std::move(other.sizer_)),
+    newest_(other.newest_), oldest_(other.oldest_), heap_(std::move(other.heap_)), bytes_(other.bytes_),
+    evictions_(other.evictions_), expirations_(other.expirations_)
+{
+    other.newest_ = other.oldest_ = NULL;
+    other.heap_.clear();
+    other.bytes_ = 0;
+}
+
+template<class Key, class Value, class Clock>
+OrderedCache<Key, Value, Clock>& OrderedCache<Key, Value, Clock>::operator=(const OrderedCache& other)
+{
+    if(this == &other) return *this;
+    AVLTree<Key, Value>::operator=(other);
+    maxEntries_ = other.maxEntries_;
+    maxBytes_ = other.maxBytes_;
+    defaultTtl_ = nextTtl_ = other.defaultTtl_;
+    sizer_ = other.sizer_;
+    relinkFrom(other);
+    return *this;
+}
+
+template<class Key, class Value, class Clock>
+OrderedCache<Key, Value, Clock>& OrderedCache<Key, Value, Clock>::operator=(OrderedCache&& other) noexcept
+{
+    if(this == &other) return *this;
+    AVLTree<Key, Value>::operator=(std::move(other));
+    maxEntries_ = other.maxEntries_;
+    maxBytes_ = other.maxBytes_;
+    defaultTtl_ = nextTtl_ = other.defaultTtl_;
+    sizer_ = std::move(other.sizer_);
+    newest_ = other.newest_;
+    oldest_ = other.oldest_;
+    heap_ = std::move(other.heap_);
+    bytes_ = other.bytes_;
+    evictions_ = other.evictions_;
+    expirations_ = other.expirations_;
+    other.newest_ = other.oldest_ = NULL;
+    other.heap_.clear();
+    other.bytes_ = 0;
+    return *this;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::setDefaultTtl(duration ttl)
+{
+    defaultTtl_ = nextTtl_ = ttl;
+}
+
+/**
+* Entries already in the cache keep their charge until they are
+* overwritten.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::setSizer(const Sizer& sizer)
+{
+    sizer_ = sizer;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    insert(keyValuePair, defaultTtl_);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::insert(const std::pair<const Key, Value>& keyValuePair, duration ttl)
+{
+    time_point now = Clock::now();
+    expireSome(now, EXPIRY_BATCH);
+    AVLNode<Key, Value>* parent;
+    bool asLeftChild;
+    AVLNode<Key, Value>* node = this->findSlot(keyValuePair.first, parent, asLeftChild);
+    if(node != NULL) {
+        assignValue(node, keyValuePair.second);
+        setExpiry(static_cast<CacheNode*>(node), ttl, now);
+    }
+    else {
+        nextTtl_ = ttl;
+        this->linkNewNode(parent, asLeftChild, keyValuePair);
+        nextTtl_ = defaultTtl_;
+    }
+    enforceBudget();
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads)
+{
+    for(size_t i = 0; i < batch.size(); i++)
+        insert(std::pair<const Key, Value>(batch[i].first, batch[i].second));
+}
+
+template<class Key, class Value, class Clock>
+typename OrderedCache<Key, Value, Clock>::iterator OrderedCache<Key, Value, Clock>::get(const Key& key)
+{
+    time_point now = Clock::now();
+    expireSome(now, EXPIRY_BATCH);
+    CacheNode* node = static_cast<CacheNode*>(this->internalFind(key));
+    if(node == NULL) return this->end();
+    if(node->expiresAt_ <= now) {
+        evict(node);
+        expirations_++;
+        return this->end();
+    }
+    unlist(node);
+    pushFront(node);
+    return BinarySearchTree<Key, Value>::iteratorAt(node);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::eraseNode(Node<Key, Value>* node)
+{
+    evict(static_cast<CacheNode*>(node));
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::clear()
+{
+    AVLTree<Key, Value>::clear();
+    newest_ = oldest_ = NULL;
+    heap_.clear();
+    bytes_ = 0;
+}
+
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::purgeExpired()
+{
+    return expireSome(Clock::now(), (size_t)-1);
+}
+
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::bytes() const
+{
+    return bytes_;
+}
+
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::evictions() const
+{
+    return evictions_;
+}
+
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::expirations() const
+{
+    return expirations_;
+}
+
+/**
+* Every path that adds an item creates its node here, so this is where new
+* entries join the list, the heap and the byte count. insertItems keeps
+* the parallel batch merge, which calls this from worker threads, away.
+*/
+template<class Key, class Value, class Clock>
+AVLNode<Key, Value>* OrderedCache<Key, Value, Clock>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    CacheNode* node = new CacheNode(key, value, parent);
+    if(nextTtl_ != duration::zero()) node->expiresAt_ = Clock::now() + nextTtl_;
+    linkEntry(node);
+    return node;
+}
+
+/**
+* An overwrite is a use, and the new value may be charged differently.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::assignValue(Node<Key, Value>* node, const Value& value)
+{
+    AVLTree<Key, Value>::assignValue(node, value);
+    CacheNode* entry = static_cast<CacheNode*>(node);
+    bytes_ -= entry->charge_;
+    entry->charge_ = chargeFor(entry);
+    bytes_ += entry->charge_;
+    unlist(entry);
+    pushFront(entry);
+}
+
+template<class Key, class Value, class Clock>
+typename AVLTree<Key, Value>::node_type OrderedCache<Key, Value, Clock>::extractNode(AVLNode<Key, Value>* node)
+{
+    unlinkEntry(static_cast<CacheNode*>(node));
+    return AVLTree<Key, Value>::extractNode(node);
+}
+
+/**
+* The budget is enforced once the node is linked, so an arriving entry may
+* push out the oldest ones.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    AVLTree<Key, Value>::adoptNode(parent, asLeftChild, node);
+    linkEntry(static_cast<CacheNode*>(node));
+    enforceBudget();
+}
+
+/**
+* A relaid out node takes its place on the list and in the heap. One that
+* is leaving the cache has been unlinked from both already.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::nodeMoved(Node<Key, Value>* from, Node<Key, Value>* to)
+{
+    CacheNode* entry = static_cast<CacheNode*>(to);
+    if(entry->newer_ == NULL && newest_ != from) return;
+    if(entry->newer_ != NULL) entry->newer_->older_ = entry;
+    else                      newest_ = entry;
+    if(entry->older_ != NULL) entry->older_->newer_ = entry;
+    else                      oldest_ = entry;
+    if(entry->heapIndex_ != NOT_IN_HEAP) heap_[entry->heapIndex_] = entry;
+}
+
+/**
+* Helper function: linkEntry
+*
+* Makes a node entering the cache its newest entry, charges it, and adds
+* it to the heap if it has an expiry time.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::linkEntry(CacheNode* node)
+{
+    pushFront(node);
+    node->charge_ = chargeFor(node);
+    bytes_ += node->charge_;
+    node->heapIndex_ = NOT_IN_HEAP;
+    if(node->expiresAt_ != time_point::max()) heapPush(node);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::unlinkEntry(CacheNode* node)
+{
+    unlist(node);
+    heapErase(node);
+    bytes_ -= node->charge_;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::pushFront(CacheNode* node)
+{
+    node->newer_ = NULL;
+    node->older_ = newest_;
+    if(newest_ != NULL) newest_->newer_ = node;
+    else                oldest_ = node;
+    newest_ = node;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::unlist(CacheNode* node)
+{
+    if(node->newer_ != NULL) node->newer_->older_ = node->older_;
+    else                     newest_ = node->older_;
+    if(node->older_ != NULL) node->older_->newer_ = node->newer_;
+    else                     oldest_ = node->newer_;
+    node->newer_ = node->older_ = NULL;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::setExpiry(CacheNode* node, duration ttl, time_point now)
+{
+    if(ttl == duration::zero()) {
+        node->expiresAt_ = time_point::max();
+        heapErase(node);
+        return;
+    }
+    node->expiresAt_ = now + ttl;
+    if(node->heapIndex_ == NOT_IN_HEAP) {
+        heapPush(node);
+        return;
+    }
+    siftUp(node->heapIndex_);
+    siftDown(node->heapIndex_);
+}
+
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::chargeFor(const CacheNode* node) const
+{
+    return sizer_ ? sizer_(node->getKey(), node->getValue()) : node->footprint();
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::evict(CacheNode* node)
+{
+    unlinkEntry(node);
+    this->removeNode(node);
+}
+
+/**
+* Helper function: expireSome
+*
+* Removes up to limit entries, earliest expiry first, whose time is up.
+*/
+template<class Key, class Value, class Clock>
+size_t OrderedCache<Key, Value, Clock>::expireSome(time_point now, size_t limit)
+{
+    size_t expired = 0;
+    for(; expired < limit && !heap_.empty() && heap_[0]->expiresAt_ <= now; expired++)
+        evict(heap_[0]);
+    expirations_ += expired;
+    return expired;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::enforceBudget()
+{
+    while(oldest_ != NULL && ((maxEntries_ != 0 && this->size_ > maxEntries_) ||
+                              (maxBytes_ != 0 && bytes_ > maxBytes_))) {
+        evict(oldest_);
+        evictions_++;
+    }
+}
+
+/**
+* Helper function: relinkFrom
+*
+* Rebuilds the list and heap of a fresh copy of other, oldest entry first.
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::relinkFrom(const OrderedCache& other)
+{
+    newest_ = oldest_ = NULL;
+    heap_.clear();
+    bytes_ = 0;
+    for(const CacheNode* entry = other.oldest_; entry != NULL; entry = entry->newer_)
+        linkEntry(static_cast<CacheNode*>(this->internalFind(entry->getKey())));
+}
+
+/**
+* Helper function: heapPush / heapErase
+*
+* The heap is an array of nodes with the earliest expiry first; each node
+* knows its index, so any entry can be taken out in O(log n).
+*/
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::heapPush(CacheNode* node)
+{
+    heap_.push_back(NULL);
+    heapPlace(node, heap_.size() - 1);
+    siftUp(node->heapIndex_);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::heapErase(CacheNode* node)
+{
+    size_t i = node->heapIndex_;
+    if(i == NOT_IN_HEAP) return;
+    node->heapIndex_ = NOT_IN_HEAP;
+    CacheNode* last = heap_.back();
+    heap_.pop_back();
+    if(last == node) return;
+    heapPlace(last, i);
+    siftUp(i);
+    siftDown(last->heapIndex_);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::heapPlace(CacheNode* node, size_t i)
+{
+    heap_[i] = node;
+    node->heapIndex_ = i;
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::siftUp(size_t i)
+{
+    CacheNode* node = heap_[i];
+    while(i > 0 && node->expiresAt_ < heap_[(i - 1) / 2]->expiresAt_) {
+        heapPlace(heap_[(i - 1) / 2], i);
+        i = (i - 1) / 2;
+    }
+    heapPlace(node, i);
+}
+
+template<class Key, class Value, class Clock>
+void OrderedCache<Key, Value, Clock>::siftDown(size_t i)
+{
+    CacheNode* node = heap_[i];
+    for(;;) {
+        size_t child = 2 * i + 1;
+        if(child >= heap_.size()) break;
+        if(child + 1 < heap_.size() && heap_[child + 1]->expiresAt_ < heap_[child]->expiresAt_) child++;
+        if(!(heap_[child]->expiresAt_ < node->expiresAt_)) break;
+        heapPlace(heap_[child], i);
+        i = child;
+    }
+    heapPlace(node, i);
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the OrderedCache class.
+  -------------------------------------------------
+*/
+
+#endif
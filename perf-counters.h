@@ -0,0 +1,189 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * Hardware event counters for the calling thread, read through the Linux
+ * perf_event_open system call.
+ *
+ * Each event is opened on its own, so an event the CPU, the kernel or a
+ * virtual machine does not provide is just reported as unavailable while
+ * the rest still count. Elsewhere than Linux nothing is available. When
+ * the kernel has to multiplex more events than there are hardware
+ * counters, values are scaled up by the fraction of time each one ran.
+ * Only user-space work is counted.
+ */
+class PerfCounters
+{
+public:
+    enum Event { CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, DTLB_MISSES, BRANCH_MISSES, NUM_EVENTS };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool available(Event e) const;
+    bool anyAvailable() const;
+    // Why the first unavailable event could not be opened
+    const std::string& unavailableReason() const;
+
+    // Zeroes and starts every available counter
+    void start();
+    void stop();
+    // Count between the last start() and stop()
+    uint64_t value(Event e) const;
+
+    static const char* name(Event e);
+
+protected:
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+    // Helper functions
+    void open(Event e, uint32_t type, uint64_t config);
+
+protected:
+    int fds_[NUM_EVENTS];
+    uint64_t values_[NUM_EVENTS];
+    std::string reason_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the PerfCounters class.
+  ------------------------------------------------------
+*/
+
+inline PerfCounters::PerfCounters()
+{
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        fds_[e] = -1;
+        values_[e] = 0;
+    }
+#ifdef __linux__
+    const uint64_t l1dReadMiss = PERF_COUNT_HW_CACHE_L1D |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    const uint64_t dtlbReadMiss = PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    open(CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open(INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open(L1D_MISSES, PERF_TYPE_HW_CACHE, l1dReadMiss);
+    open(LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    open(DTLB_MISSES, PERF_TYPE_HW_CACHE, dtlbReadMiss);
+    open(BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#else
+    reason_ = "perf_event_open needs Linux";
+#endif
+}
+
+inline PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        if(fds_[e] >= 0) close(fds_[e]);
+    }
+#endif
+}
+
+inline bool PerfCounters::available(Event e) const
+{
+    return fds_[e] >= 0;
+}
+
+inline bool PerfCounters::anyAvailable() const
+{
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        if(fds_[e] >= 0) return true;
+    }
+    return false;
+}
+
+inline const std::string& PerfCounters::unavailableReason() const
+{
+    return reason_;
+}
+
+inline void PerfCounters::start()
+{
+#ifdef __linux__
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        if(fds_[e] < 0) continue;
+        ioctl(fds_[e], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds_[e], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+/**
+* Disables every counter, then reads them, scaling multiplexed ones.
+*/
+inline void PerfCounters::stop()
+{
+#ifdef __linux__
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        if(fds_[e] >= 0) ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for(int e = 0; e < NUM_EVENTS; e++) {
+        values_[e] = 0;
+        uint64_t data[3];   // value, time enabled, time running
+        if(fds_[e] < 0 || read(fds_[e], data, sizeof(data)) != (ssize_t)sizeof(data)) continue;
+        if(data[2] == 0) continue;
+        values_[e] = (data[2] < data[1]) ? (uint64_t)((double)data[0] * data[1] / data[2]) : data[0];
+    }
+#endif
+}
+
+inline uint64_t PerfCounters::value(Event e) const
+{
+    return values_[e];
+}
+
+inline const char* PerfCounters::name(Event e)
+{
+    static const char* names[NUM_EVENTS] = { "cycles", "instr", "L1d-miss", "LLC-miss", "dTLB-miss", "br-miss" };
+    return names[e];
+}
+
+/**
+* Helper function: open
+*
+* Opens one disabled counter for this thread on any CPU, remembering the
+* error of the first one that fails.
+*/
+inline void PerfCounters::open(Event e, uint32_t type, uint64_t config)
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if(fds_[e] < 0 && reason_.empty())
+        reason_ = std::string("perf_event_open(") + name(e) + "): " + std::strerror(errno);
+#else
+    (void)e; (void)type; (void)config;
+#endif
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the PerfCounters class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include <cmath>
+#include "scapegoat-bst.h"
+
+using namespace std;
+
+
+// Depth of the deepest node, 1 for a single node
+size_t height(const Node<int,int>* node)
+{
+    if(node == NULL) return 0;
+    return 1 + max(height(node->getLeft()), height(node->getRight()));
+}
+
+int main(int argc, char *argv[])
+{
+    ScapegoatTree<int,int> st;
+    st.insert(std::make_pair(2, 20));
+    st.insert(std::make_pair(1, 10));
+    st.insert(std::make_pair(3, 30));
+    cout << "Scapegoat tree contents:" << endl;
+    for(ScapegoatTree<int,int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    cout << "Node size: " << sizeof(Node<int,int>) << " bytes, same as a plain BST node" << endl;
+
+    // Sorted inserts stay within the height bound
+    ScapegoatTree<int,int> sorted;
+    for(int i = 0; i < 100000; i++) sorted.insert(std::make_pair(i, i));
+    double bound = std::log(100000.0) / std::log(1.5) + 1;
+    cout << "Sorted inserts: height " << height(sorted.getRoot()) << " (bound " << (int)bound << "), "
+         << sorted.rebuilds() << " rebuilds" << endl;
+
+    // Randomized inserts and removes against std::map
+    ScapegoatTree<int,int> rt(0.6);
+    map<int,int> reference;
+    srand(105);
+    bool ok = true;
+    for(int i = 0; i < 50000 && ok; i++) {
+        int key = rand() % 5000;
+        if(rand() % 3 == 0) {
+            rt.remove(key);
+            reference.erase(key);
+        }
+        else {
+            rt.insert(std::make_pair(key, i));
+            reference[key] = i;
+        }
+        if(i % 1000 == 0)
+            ok = height(rt.getRoot()) <= std::log((double)rt.size() + 1) / std::log(1 / 0.6) + 2;
+    }
+    ok = ok && rt.size() == reference.size();
+    map<int,int>::iterator ref = reference.begin();
+    for(ScapegoatTree<int,int>::iterator it = rt.begin(); ok && it != rt.end(); ++it, ++ref) {
+        ok = (it->first == ref->first && it->second == ref->second);
+    }
+    cout << "Randomized contents and heights match: " << ok << endl;
+
+    // Removing most keys triggers full rebuilds
+    size_t before = sorted.rebuilds();
+    for(int i = 0; i < 90000; i++) sorted.remove(i);
+    cout << "After removing 90000: size " << sorted.size() << ", height " << height(sorted.getRoot())
+         << ", full rebuilds " << sorted.rebuilds() - before << endl;
+
+    ScapegoatTree<int,int> copy(sorted);
+    copy.insert(std::make_pair(-1, -1));
+    cout << "Copy size: " << copy.size() << ", original size: " << sorted.size() << endl;
+
+    // Clearing through the base class forgets the old largest size, so
+    // the next removes do not set off full rebuilds
+    BinarySearchTree<int,int>& base = copy;
+    base.clear();
+    for(int i = 0; i < 10; i++) copy.insert(std::make_pair(i, i));
+    before = copy.rebuilds();
+    copy.remove(0);
+    copy.remove(1);
+    cout << "Rebuilds after clear through the base class: " << copy.rebuilds() - before << endl;
+    return 0;
+}
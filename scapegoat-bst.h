@@ -0,0 +1,232 @@
+#ifndef SCAPEGOAT_BST_H
+#define SCAPEGOAT_BST_H
+
+#include <cmath>
+#include <vector>
+#include "bst.h"
+
+/**
+ * A balanced BinarySearchTree whose nodes are plain Nodes: no balance
+ * factor, no color, no subtree size.
+ *
+ * An insert that lands deeper than log(n) / log(1 / alpha) walks back up,
+ * counting subtree sizes, to the first ancestor with a child holding more
+ * than alpha of its nodes (the scapegoat), and rebuilds that subtree into
+ * a perfectly balanced one in linear time. Removals do no work of their
+ * own until the tree has shrunk below alpha times its largest size since
+ * the last full rebuild; then the whole tree is rebuilt. Both are O(log n)
+ * amortized, and the height stays within log(n) / log(1 / alpha) + 1.
+ *
+ * alpha lies strictly between 0.5 and 1: lower keeps the tree shallower at
+ * the price of more frequent rebuilds.
+ */
+template <typename Key, typename Value>
+class ScapegoatTree : public BinarySearchTree<Key, Value>
+{
+public:
+    ScapegoatTree(double alpha = 2.0 / 3);
+
+    virtual void insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void rebalance();
+    virtual void clear();
+
+    double alpha() const;
+    // Number of subtree rebuilds so far, the full ones included.
+    size_t rebuilds() const;
+
+protected:
+    virtual Node<Key, Value>* insertAt(Node<Key, Value>* parent, bool asLeftChild, const std::pair<const Key, Value>& item);
+    virtual void eraseNode(Node<Key, Value>* node);
+
+    // Helper functions
+    void linkChecked(Node<Key, Value>* node, size_t depth);
+    Node<Key, Value>* findScapegoat(Node<Key, Value>* node, size_t& subtreeSize) const;
+    void rebuildSubtree(Node<Key, Value>* top, size_t subtreeSize);
+    static Node<Key, Value>* linkBalanced(const std::vector<Node<Key, Value>*>& nodes,
+                                          size_t lo, size_t hi, Node<Key, Value>* parent);
+
+protected:
+    double alpha_;
+    double logInverseAlpha_;
+    size_t maxSize_;    // largest size since the last full rebuild
+    size_t rebuilds_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the ScapegoatTree class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value>
+ScapegoatTree<Key, Value>::ScapegoatTree(double alpha) :
+    alpha_(alpha), logInverseAlpha_(std::log(1 / alpha)), maxSize_(0), rebuilds_(0)
+{
+}
+
+/**
+* Plain BST insert that counts the depth of the new node and, if it is too
+* deep, rebuilds below the scapegoat on its path.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* parent = NULL;
+    Node<Key, Value>* current = this->root_;
+    size_t depth = 0;
+    while(current != NULL) {
+        parent = current;
+        depth++;
+        if(keyValuePair.first < current->getKey())
+            current = current->getLeft();
+        else if(current->getKey() < keyValuePair.first)
+            current = current->getRight();
+        else {
+            current->setValue(keyValuePair.second);
+            return;
+        }
+    }
+    bool asLeftChild = (parent != NULL && keyValuePair.first < parent->getKey());
+    linkChecked(BinarySearchTree<Key, Value>::insertAt(parent, asLeftChild, keyValuePair), depth);
+}
+
+/**
+* An insert at a position found elsewhere still needs the depth check; the
+* depth comes from walking back up.
+*/
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::insertAt(Node<Key, Value>* parent, bool asLeftChild,
+                                                      const std::pair<const Key, Value>& item)
+{
+    size_t depth = 0;
+    for(Node<Key, Value>* n = parent; n != NULL; n = n->getParent()) depth++;
+    Node<Key, Value>* node = BinarySearchTree<Key, Value>::insertAt(parent, asLeftChild, item);
+    linkChecked(node, depth);
+    return node;
+}
+
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    BinarySearchTree<Key, Value>::eraseNode(node);
+    if(this->size_ < alpha_ * maxSize_)
+        rebalance();
+}
+
+/**
+* A full rebuild, which also resets the shrink count for removals.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebalance()
+{
+    BinarySearchTree<Key, Value>::rebalance();
+    maxSize_ = this->size_;
+    rebuilds_++;
+}
+
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    maxSize_ = 0;
+}
+
+template<class Key, class Value>
+double ScapegoatTree<Key, Value>::alpha() const
+{
+    return alpha_;
+}
+
+template<class Key, class Value>
+size_t ScapegoatTree<Key, Value>::rebuilds() const
+{
+    return rebuilds_;
+}
+
+/**
+* Helper function: linkChecked
+*
+* Bookkeeping after a new node was linked at the given depth (the number of
+* its ancestors), rebuilding below the scapegoat if it is too deep.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::linkChecked(Node<Key, Value>* node, size_t depth)
+{
+    maxSize_ = std::max(maxSize_, this->size_);
+    if(depth > std::log((double)this->size_) / logInverseAlpha_) {
+        size_t subtreeSize;
+        Node<Key, Value>* scapegoat = findScapegoat(node, subtreeSize);
+        if(scapegoat != NULL) rebuildSubtree(scapegoat, subtreeSize);
+    }
+}
+
+/**
+* Helper function: findScapegoat
+*
+* Walks up from a new leaf, sizing each ancestor from the child it came
+* from plus a count of the other child's subtree, and returns the first
+* ancestor that is not alpha-weight-balanced (NULL if none is). The
+* counting costs O(size of the scapegoat's subtree), which the rebuild
+* costs anyway.
+*/
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::findScapegoat(Node<Key, Value>* node, size_t& subtreeSize) const
+{
+    size_t size = 1;
+    for(Node<Key, Value>* parent = node->getParent(); parent != NULL; node = parent, parent = parent->getParent()) {
+        Node<Key, Value>* sibling = (parent->getLeft() == node) ? parent->getRight() : parent->getLeft();
+        size_t parentSize = size + 1 + BinarySearchTree<Key, Value>::countNodes(sibling);
+        if(size > alpha_ * parentSize) {
+            subtreeSize = parentSize;
+            return parent;
+        }
+        size = parentSize;
+    }
+    return NULL;
+}
+
+/**
+* Helper function: rebuildSubtree
+*
+* Collects the subtree's nodes in order and relinks them with the median
+* of each range on top. The nodes themselves do not move.
+*/
+template<class Key, class Value>
+void ScapegoatTree<Key, Value>::rebuildSubtree(Node<Key, Value>* top, size_t subtreeSize)
+{
+    Node<Key, Value>* parent = top->getParent();
+    bool asLeftChild = (parent != NULL && parent->getLeft() == top);
+    std::vector<Node<Key, Value>*> nodes;
+    nodes.reserve(subtreeSize);
+    Node<Key, Value>* n = top;
+    while(n->getLeft() != NULL) n = n->getLeft();
+    for(size_t i = 0; i < subtreeSize; i++, n = BinarySearchTree<Key, Value>::successor(n))
+        nodes.push_back(n);
+
+    Node<Key, Value>* rebuilt = linkBalanced(nodes, 0, nodes.size(), parent);
+    if(parent == NULL)      this->root_ = rebuilt;
+    else if(asLeftChild)    parent->setLeft(rebuilt);
+    else                    parent->setRight(rebuilt);
+    rebuilds_++;
+}
+
+template<class Key, class Value>
+Node<Key, Value>* ScapegoatTree<Key, Value>::linkBalanced(const std::vector<Node<Key, Value>*>& nodes,
+                                                          size_t lo, size_t hi, Node<Key, Value>* parent)
+{
+    if(lo >= hi) return NULL;
+    size_t mid = lo + (hi - lo) / 2;
+    Node<Key, Value>* node = nodes[mid];
+    node->setParent(parent);
+    node->setLeft(linkBalanced(nodes, lo, mid, node));
+    node->setRight(linkBalanced(nodes, mid + 1, hi, node));
+    return node;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the ScapegoatTree class.
+  -------------------------------------------------
+*/
+
+#endif
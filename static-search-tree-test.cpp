@@ -0,0 +1,85 @@
+#include <iostream>
+#include <stdexcept>
+#include "static-search-tree.h"
+
+using namespace std;
+
+
+enum Opcode { NOP, LOAD, STORE, ADD, JUMP, HALT };
+
+constexpr std::pair<int, Opcode> opcodeBytes[] = {
+    { 0x00, NOP }, { 0x10, LOAD }, { 0x11, STORE }, { 0x20, ADD }, { 0x40, JUMP }, { 0xff, HALT }
+};
+constexpr auto opcodes = makeStaticSearchTree(opcodeBytes);
+static_assert(opcodes.size() == 6, "built at compile time");
+
+// Keys 0, 3, 6, ... with squared indices as values, generated at compile time
+template<typename List>
+struct SquareTable;
+
+template<size_t... Is>
+struct SquareTable<StaticIndexList<Is...> >
+{
+    static constexpr std::pair<int,int> items[sizeof...(Is)] = { std::pair<int,int>(3 * (int)Is, (int)(Is * Is))... };
+};
+
+template<size_t... Is>
+constexpr std::pair<int,int> SquareTable<StaticIndexList<Is...> >::items[sizeof...(Is)];
+
+// Every hit, miss, lower bound and the in-order walk for one size
+template<size_t N>
+bool checkSize()
+{
+    constexpr StaticSearchTree<int,int,N> tree(SquareTable<typename MakeStaticIndexList<N>::type>::items);
+    bool ok = tree.lower_bound(-1)->first == 0 && tree.find(-3) == tree.end();
+    for(int i = 0; ok && i < (int)N; i++) {
+        typename StaticSearchTree<int,int,N>::iterator next = tree.lower_bound(3 * i + 1);
+        ok = tree.find(3 * i)->second == i * i && tree[3 * i] == i * i && tree.find(3 * i + 2) == tree.end() &&
+             (i + 1 == (int)N ? next == tree.end() : next->first == 3 * i + 3);
+    }
+    int expected = 0;
+    for(typename StaticSearchTree<int,int,N>::iterator it = tree.begin(); ok && it != tree.end(); ++it, expected++)
+        ok = (it->first == 3 * expected);
+    return ok && expected == (int)N;
+}
+
+template<size_t N>
+bool checkSizesUpTo()
+{
+    return checkSizesUpTo<N - 1>() && checkSize<N>();
+}
+
+template<>
+bool checkSizesUpTo<0>()
+{
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    cout << "Opcodes in key order:";
+    for(auto it = opcodes.begin(); it != opcodes.end(); ++it) cout << " " << hex << it->first << ":" << it->second;
+    cout << dec << endl;
+    cout << "opcodes[0x20] = " << opcodes[0x20] << ", find(0x30) is end: " << (opcodes.find(0x30) == opcodes.end())
+         << ", lower_bound(0x30): " << hex << opcodes.lower_bound(0x30)->first << dec << endl;
+    try {
+        opcodes[0x12];
+    }
+    catch(std::out_of_range&) {
+        cout << "opcodes[0x12] throws out_of_range" << endl;
+    }
+
+    // Complete, partial and single-level layouts
+    cout << "Sizes 1 to 70 match: " << checkSizesUpTo<70>() << ", size 1000 matches: " << checkSize<1000>() << endl;
+
+    // Outside a constant expression a bad key list throws instead of failing to compile
+    std::pair<int,int> unsorted[] = { { 1, 1 }, { 3, 3 }, { 2, 2 } };
+    try {
+        StaticSearchTree<int,int,3> bad(unsorted);
+        cout << "Unsorted keys accepted, size " << bad.size() << endl;
+    }
+    catch(std::invalid_argument& e) {
+        cout << "Unsorted keys: " << e.what() << endl;
+    }
+    return 0;
+}
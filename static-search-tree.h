@@ -0,0 +1,370 @@
+#ifndef STATIC_SEARCH_TREE_H
+#define STATIC_SEARCH_TREE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+/**
+ * The indices 0..N-1 as a parameter pack, for building an array one
+ * element per index inside a constant expression. MakeStaticIndexList
+ * splits N in halves, so instantiation depth grows with log N only.
+ */
+template <size_t... Is>
+struct StaticIndexList
+{
+};
+
+template <typename Low, typename High>
+struct ConcatStaticIndexLists;
+
+template <size_t... Is, size_t... Js>
+struct ConcatStaticIndexLists<StaticIndexList<Is...>, StaticIndexList<Js...> >
+{
+    typedef StaticIndexList<Is..., (sizeof...(Is) + Js)...> type;
+};
+
+template <size_t N>
+struct MakeStaticIndexList
+{
+    typedef typename ConcatStaticIndexLists<typename MakeStaticIndexList<N / 2>::type,
+                                            typename MakeStaticIndexList<N - N / 2>::type>::type type;
+};
+
+template <>
+struct MakeStaticIndexList<0>
+{
+    typedef StaticIndexList<> type;
+};
+
+template <>
+struct MakeStaticIndexList<1>
+{
+    typedef StaticIndexList<0> type;
+};
+
+template <size_t N>
+struct StaticTreeLog2
+{
+    static const size_t value = 1 + StaticTreeLog2<N / 2>::value;
+};
+
+template <>
+struct StaticTreeLog2<1>
+{
+    static const size_t value = 0;
+};
+
+/**
+ * The descent through the full levels of an Eytzinger array, one
+ * instantiation per level so it is unrolled whatever the optimizer
+ * decides. Each level is a compare and a shift, with no branch.
+ */
+template <typename Key, typename Item, size_t Levels>
+struct StaticTreeDescent
+{
+    static size_t run(const Item* items, const Key& key, size_t slot)
+    {
+        return StaticTreeDescent<Key, Item, Levels - 1>::run(items, key, 2 * slot + (items[slot - 1].first < key));
+    }
+};
+
+template <typename Key, typename Item>
+struct StaticTreeDescent<Key, Item, 0>
+{
+    static size_t run(const Item*, const Key&, size_t slot)
+    {
+        return slot;
+    }
+};
+
+/**
+ * A read-only search tree over a key set fixed at compile time, such as an
+ * opcode or enum table. The constructor is constexpr: from N items sorted
+ * by key it lays them out in Eytzinger order, the implicit layout of a
+ * complete binary tree where slot k has children 2k and 2k + 1. A tree
+ * declared constexpr is built by the compiler and costs nothing at
+ * startup.
+ *
+ * Lookups index the array instead of chasing pointers, and the top levels
+ * share a few cache lines. Every full level of the descent is unrolled;
+ * only the last, partial level needs a bounds check.
+ *
+ * Key and Value must be literal types, and Key's operator< must work in
+ * constant expressions (integers, enums, ...). Unsorted or repeated keys
+ * fail to compile when the tree is constexpr and throw
+ * std::invalid_argument otherwise.
+ *
+ * Offers the find/lower_bound/iterator/operator[] surface of
+ * BinarySearchTree; the items are const.
+ */
+template <typename Key, typename Value, size_t N>
+class StaticSearchTree
+{
+    static_assert(N > 0, "StaticSearchTree needs at least one item");
+
+public:
+    typedef std::pair<Key, Value> value_type;
+    typedef value_type Items[N];
+
+    constexpr StaticSearchTree(const Items& sorted);
+
+    /**
+    * An iterator over the items in key order.
+    */
+    class iterator
+    {
+    public:
+        iterator();
+        const value_type& operator*() const;
+        const value_type* operator->() const;
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        iterator& operator++();
+    protected:
+        friend class StaticSearchTree<Key, Value, N>;
+        iterator(const StaticSearchTree<Key, Value, N>* tree, size_t slot);
+        const StaticSearchTree<Key, Value, N>* tree_;
+        size_t slot_;   // 1-based, 0 past the end
+    };
+
+    constexpr size_t size() const;
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    template <size_t... Is>
+    constexpr StaticSearchTree(const Items& sorted, StaticIndexList<Is...>);
+
+    // Helper functions
+    static constexpr const Items& requireSorted(const Items& items);
+    static constexpr bool isSorted(const Items& items, size_t lo, size_t hi);
+    static constexpr size_t levelCount(size_t first, size_t width);
+    static constexpr size_t inorderRank(size_t slot);
+    size_t lowerBoundSlot(const Key& key) const;
+
+protected:
+    value_type items_[N];   // items_[k - 1] holds slot k
+};
+
+// Deduces N from the array.
+template <typename Key, typename Value, size_t N>
+constexpr StaticSearchTree<Key, Value, N> makeStaticSearchTree(const std::pair<Key, Value> (&sorted)[N])
+{
+    return StaticSearchTree<Key, Value, N>(sorted);
+}
+
+/*
+  ----------------------------------------------------------------
+  Begin implementations for the StaticSearchTree::iterator class.
+  ----------------------------------------------------------------
+*/
+
+template<typename Key, typename Value, size_t N>
+StaticSearchTree<Key, Value, N>::iterator::iterator() :
+    tree_(NULL), slot_(0)
+{
+}
+
+template<typename Key, typename Value, size_t N>
+StaticSearchTree<Key, Value, N>::iterator::iterator(const StaticSearchTree<Key, Value, N>* tree, size_t slot) :
+    tree_(tree), slot_(slot)
+{
+}
+
+template<typename Key, typename Value, size_t N>
+const typename StaticSearchTree<Key, Value, N>::value_type&
+StaticSearchTree<Key, Value, N>::iterator::operator*() const
+{
+    return tree_->items_[slot_ - 1];
+}
+
+template<typename Key, typename Value, size_t N>
+const typename StaticSearchTree<Key, Value, N>::value_type*
+StaticSearchTree<Key, Value, N>::iterator::operator->() const
+{
+    return &tree_->items_[slot_ - 1];
+}
+
+template<typename Key, typename Value, size_t N>
+bool StaticSearchTree<Key, Value, N>::iterator::operator==(const iterator& rhs) const
+{
+    return slot_ == rhs.slot_;
+}
+
+template<typename Key, typename Value, size_t N>
+bool StaticSearchTree<Key, Value, N>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The in-order successor by index arithmetic: the leftmost slot under the
+* right child, or else the first ancestor reached from a left child.
+*/
+template<typename Key, typename Value, size_t N>
+typename StaticSearchTree<Key, Value, N>::iterator&
+StaticSearchTree<Key, Value, N>::iterator::operator++()
+{
+    if(2 * slot_ + 1 <= N) {
+        slot_ = 2 * slot_ + 1;
+        while(2 * slot_ <= N) slot_ *= 2;
+    }
+    else {
+        while(slot_ & 1) slot_ >>= 1;
+        slot_ >>= 1;
+    }
+    return *this;
+}
+
+/*
+  --------------------------------------------------------------
+  End implementations for the StaticSearchTree::iterator class.
+  --------------------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the StaticSearchTree class.
+  -------------------------------------------------------
+*/
+
+template<typename Key, typename Value, size_t N>
+constexpr StaticSearchTree<Key, Value, N>::StaticSearchTree(const Items& sorted) :
+    StaticSearchTree(requireSorted(sorted), typename MakeStaticIndexList<N>::type())
+{
+}
+
+/**
+* Slot k takes the item whose position in key order is the number of
+* slots before k in an in-order walk.
+*/
+template<typename Key, typename Value, size_t N>
+template<size_t... Is>
+constexpr StaticSearchTree<Key, Value, N>::StaticSearchTree(const Items& sorted, StaticIndexList<Is...>) :
+    items_{ sorted[inorderRank(Is + 1)]... }
+{
+}
+
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::size() const
+{
+    return N;
+}
+
+/**
+* The leftmost slot is the first of the last full level.
+*/
+template<typename Key, typename Value, size_t N>
+typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::begin() const
+{
+    return iterator(this, (size_t)1 << StaticTreeLog2<N>::value);
+}
+
+template<typename Key, typename Value, size_t N>
+typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::end() const
+{
+    return iterator(this, 0);
+}
+
+template<typename Key, typename Value, size_t N>
+typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::find(const Key& key) const
+{
+    size_t slot = lowerBoundSlot(key);
+    if(slot == 0 || key < items_[slot - 1].first) return end();
+    return iterator(this, slot);
+}
+
+template<typename Key, typename Value, size_t N>
+typename StaticSearchTree<Key, Value, N>::iterator StaticSearchTree<Key, Value, N>::lower_bound(const Key& key) const
+{
+    return iterator(this, lowerBoundSlot(key));
+}
+
+template<typename Key, typename Value, size_t N>
+Value const & StaticSearchTree<Key, Value, N>::operator[](const Key& key) const
+{
+    size_t slot = lowerBoundSlot(key);
+    if(slot == 0 || key < items_[slot - 1].first) throw std::out_of_range("Invalid key");
+    return items_[slot - 1].second;
+}
+
+/**
+* Helper function: requireSorted
+*
+* Passes items through, or throws if a key is not above the one before
+* it; in a constant expression the throw is a compile error.
+*/
+template<typename Key, typename Value, size_t N>
+constexpr const typename StaticSearchTree<Key, Value, N>::Items&
+StaticSearchTree<Key, Value, N>::requireSorted(const Items& items)
+{
+    return isSorted(items, 0, N) ? items : throw std::invalid_argument("StaticSearchTree keys must be sorted and distinct");
+}
+
+/**
+* Splits in halves rather than walking the array, so the recursion is
+* log N deep and stays within the compiler's constexpr depth limit.
+*/
+template<typename Key, typename Value, size_t N>
+constexpr bool StaticSearchTree<Key, Value, N>::isSorted(const Items& items, size_t lo, size_t hi)
+{
+    return hi - lo < 2 ||
+           (items[lo + (hi - lo) / 2 - 1].first < items[lo + (hi - lo) / 2].first &&
+            isSorted(items, lo, lo + (hi - lo) / 2) && isSorted(items, lo + (hi - lo) / 2, hi));
+}
+
+/**
+* Helper function: levelCount
+*
+* The number of slots up to N in [first, first + width) and the matching
+* ranges of the levels below, i.e. the size of the subtree under slot
+* first when width is 1.
+*/
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::levelCount(size_t first, size_t width)
+{
+    return first > N ? 0 : (N - first + 1 < width ? N - first + 1 : width) + levelCount(2 * first, 2 * width);
+}
+
+/**
+* Helper function: inorderRank
+*
+* The root comes right after its left subtree. A left child is followed
+* by its own right subtree and then its parent; a right child follows its
+* parent and then its own left subtree.
+*/
+template<typename Key, typename Value, size_t N>
+constexpr size_t StaticSearchTree<Key, Value, N>::inorderRank(size_t slot)
+{
+    return slot == 1 ? levelCount(2, 1) :
+           slot % 2 == 0 ? inorderRank(slot / 2) - levelCount(2 * slot + 1, 1) - 1 :
+                           inorderRank(slot / 2) + 1 + levelCount(2 * slot, 1);
+}
+
+/**
+* Helper function: lowerBoundSlot
+*
+* Descends to past the leaves, recording the path in the slot number's
+* bits: a 0 for every step left. The lower bound is where the path last
+* went left, so the trailing 1s (steps right) and that 0 are shifted off.
+* A path that only went right leaves 0, past the end.
+*/
+template<typename Key, typename Value, size_t N>
+size_t StaticSearchTree<Key, Value, N>::lowerBoundSlot(const Key& key) const
+{
+    size_t slot = StaticTreeDescent<Key, value_type, StaticTreeLog2<N>::value>::run(items_, key, 1);
+    if(slot <= N) slot = 2 * slot + (items_[slot - 1].first < key);
+    return slot >> __builtin_ffsll(~(long long)slot);
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the StaticSearchTree class.
+  -----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include "string-avlbst.h"
+
+using namespace std;
+
+
+// Builds path-like keys with long shared prefixes, short keys and
+// embedded NUL bytes so every comparison path gets exercised
+string makeKey(int i)
+{
+    switch(i % 4) {
+    case 0: return "/usr/share/doc/package-" + to_string(i % 97) + "/file" + to_string(i);
+    case 1: return to_string(i % 50);
+    case 2: return string("ab\0c", 4) + to_string(i % 13);
+    default: return "https://example.com/api/v1/users/" + to_string(i % 211);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    StringAVLTree<int> st;
+    st.insert(std::make_pair(string("/home/a"), 1));
+    st.insert(std::make_pair(string("/home/b"), 2));
+    cout << "String AVLTree contents:" << endl;
+    for(StringAVLTree<int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << it->first << " " << it->second << endl;
+    }
+    cout << "st[\"/home/b\"] = " << st["/home/b"] << endl;
+
+    StringAVLTree<int> skipping(true);
+    StringAVLTree<int> plain(false);
+    map<string,int> reference;
+    srand(104);
+    for(int i = 0; i < 20000; i++) {
+        string key = makeKey(rand() % 4000);
+        if(rand() % 3 == 0) {
+            skipping.remove(key);
+            plain.remove(key);
+            reference.erase(key);
+        }
+        else {
+            skipping.insert(std::make_pair(key, i));
+            plain.insert(std::make_pair(key, i));
+            reference[key] = i;
+        }
+    }
+
+    bool inOrder = skipping.size() == reference.size();
+    map<string,int>::iterator ref = reference.begin();
+    for(StringAVLTree<int>::iterator it = skipping.begin(); inOrder && it != skipping.end(); ++it, ++ref) {
+        inOrder = (it->first == ref->first && it->second == ref->second);
+    }
+    cout << "Randomized contents match: " << inOrder << endl;
+
+    int agree = 0;
+    for(int i = 0; i < 4000; i++) {
+        string key = makeKey(i);
+        bool expected = reference.count(key) == 1;
+        if((skipping.find(key) != skipping.end()) == expected &&
+           (plain.find(key) != plain.end()) == expected)
+            agree++;
+    }
+    cout << "Lookups agreeing with std::map: " << agree << " of 4000" << endl;
+    cout << "Balanced: " << skipping.isBalanced() << endl;
+    return 0;
+}
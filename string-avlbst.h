@@ -0,0 +1,247 @@
+#ifndef STRING_AVLBST_H
+#define STRING_AVLBST_H
+
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include "avlbst.h"
+
+/**
+ * An AVLNode for std::string keys that also caches the first 8 bytes of the
+ * key as a big-endian integer (zero padded). Comparing two cached prefixes
+ * orders most key pairs without touching the strings' heap buffers.
+ */
+template <typename Value>
+class StringAVLNode : public AVLNode<std::string, Value>
+{
+public:
+    StringAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent);
+    virtual ~StringAVLNode();
+
+    uint64_t getPrefix() const;
+    virtual StringAVLNode<Value>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
+    static uint64_t computePrefix(const std::string& key);
+
+protected:
+    uint64_t prefix_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the StringAVLNode class.
+  ---------------------------------------------------
+*/
+
+template<class Value>
+StringAVLNode<Value>::StringAVLNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent) :
+    AVLNode<std::string, Value>(key, value, parent), prefix_(computePrefix(key))
+{
+}
+
+template<class Value>
+StringAVLNode<Value>::~StringAVLNode()
+{
+}
+
+template<class Value>
+uint64_t StringAVLNode<Value>::getPrefix() const
+{
+    return prefix_;
+}
+
+template<class Value>
+StringAVLNode<Value>* StringAVLNode<Value>::cloneAt(void* where) const
+{
+    return new (where) StringAVLNode<Value>(*this);
+}
+
+template<class Value>
+size_t StringAVLNode<Value>::footprint() const
+{
+    return sizeof(*this);
+}
+
+/**
+* Packs the first 8 bytes of key, most significant first, so that integer
+* order on prefixes matches byte-wise string order.
+*/
+template<class Value>
+uint64_t StringAVLNode<Value>::computePrefix(const std::string& key)
+{
+    uint64_t prefix = 0;
+    size_t len = key.size() < 8 ? key.size() : 8;
+    for(size_t i = 0; i < len; i++)
+        prefix |= (uint64_t)(unsigned char)key[i] << (56 - 8 * i);
+    return prefix;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the StringAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+ * An AVLTree keyed by std::string whose lookups first compare the cached
+ * 8-byte key prefixes held in the nodes.
+ *
+ * The descent also tracks how many leading bytes the search key shares with
+ * the nearest smaller and nearest larger keys seen so far. Every key in the
+ * current subtree lies between those two, so it shares at least the smaller
+ * of the two counts with the search key and comparisons start after it.
+ * That pays off on URL- and path-like keys with long common prefixes.
+ * Set skipSharedPrefix to false to disable it.
+ */
+template <typename Value>
+class StringAVLTree : public AVLTree<std::string, Value>
+{
+public:
+    StringAVLTree(bool skipSharedPrefix = true);
+    using AVLTree<std::string, Value>::insert;
+    virtual void insert(const std::pair<const std::string, Value>& new_item);
+
+protected:
+    virtual AVLNode<std::string, Value>* createNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent);
+    virtual Node<std::string, Value>* internalFind(const std::string& key) const;
+
+    // Helper functions
+    StringAVLNode<Value>* descend(const std::string& key, StringAVLNode<Value>*& parent, bool& asLeftChild) const;
+    static int compare(const std::string& key, uint64_t keyPrefix, const StringAVLNode<Value>* node,
+                       size_t from, size_t& common);
+
+protected:
+    bool skipSharedPrefix_;
+};
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the StringAVLTree class.
+  ---------------------------------------------------
+*/
+
+template<class Value>
+StringAVLTree<Value>::StringAVLTree(bool skipSharedPrefix) :
+    skipSharedPrefix_(skipSharedPrefix)
+{
+}
+
+template<class Value>
+void StringAVLTree<Value>::insert(const std::pair<const std::string, Value>& new_item)
+{
+    StringAVLNode<Value>* parent = NULL;
+    bool asLeftChild = false;
+    StringAVLNode<Value>* found = descend(new_item.first, parent, asLeftChild);
+    if(found != NULL) {
+        found->setValue(new_item.second);
+        return;
+    }
+    this->linkNewNode(parent, asLeftChild, new_item);
+}
+
+template<class Value>
+AVLNode<std::string, Value>* StringAVLTree<Value>::createNode(const std::string& key, const Value& value, AVLNode<std::string, Value>* parent)
+{
+    return new StringAVLNode<Value>(key, value, parent);
+}
+
+template<class Value>
+Node<std::string, Value>* StringAVLTree<Value>::internalFind(const std::string& key) const
+{
+    if(this->hotCache_ != NULL) {
+        Node<std::string, Value>* cached = this->hotCache_->lookup(key);
+        if(cached != NULL) return cached;
+    }
+    if(this->filter_ != NULL && !this->filter_->mayContain(key))
+        return NULL;
+    StringAVLNode<Value>* parent;
+    bool asLeftChild;
+    StringAVLNode<Value>* node = descend(key, parent, asLeftChild);
+    if(this->hotCache_ != NULL && node != NULL) this->hotCache_->remember(node);
+    return node;
+}
+
+/**
+* Helper function: descend
+*
+* Returns the node holding key, or NULL with parent/asLeftChild set to
+* where a node for key would be attached.
+*/
+template<class Value>
+StringAVLNode<Value>* StringAVLTree<Value>::descend(const std::string& key, StringAVLNode<Value>*& parent, bool& asLeftChild) const
+{
+    uint64_t keyPrefix = StringAVLNode<Value>::computePrefix(key);
+    size_t lowCommon = 0;   // bytes shared with the nearest smaller key on the path
+    size_t highCommon = 0;  // bytes shared with the nearest larger key on the path
+    StringAVLNode<Value>* current = static_cast<StringAVLNode<Value>*>(this->root_);
+    parent = NULL;
+    asLeftChild = false;
+    while(current != NULL) {
+        size_t from = skipSharedPrefix_ ? std::min(lowCommon, highCommon) : 0;
+        size_t common;
+        int order = compare(key, keyPrefix, current, from, common);
+        if(order == 0)
+            return current;
+        parent = current;
+        if(order < 0) {
+            highCommon = common;
+            current = static_cast<StringAVLNode<Value>*>(current->getLeft());
+            asLeftChild = true;
+        }
+        else {
+            lowCommon = common;
+            current = static_cast<StringAVLNode<Value>*>(current->getRight());
+            asLeftChild = false;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Helper function: compare
+*
+* Three-way compares key with node's key, assuming their first 'from' bytes
+* are already known to match. Sets common to the length of their common
+* prefix. Falls back to the heap bytes only when the cached prefixes cannot
+* decide.
+*/
+template<class Value>
+int StringAVLTree<Value>::compare(const std::string& key, uint64_t keyPrefix, const StringAVLNode<Value>* node,
+                                  size_t from, size_t& common)
+{
+    const std::string& other = node->getKey();
+    size_t minLen = std::min(key.size(), other.size());
+    if(from < 8) {
+        uint64_t diff = keyPrefix ^ node->getPrefix();
+        if(diff != 0) {
+            common = (size_t)__builtin_clzll(diff) / 8;
+            return keyPrefix < node->getPrefix() ? -1 : 1;
+        }
+        from = std::min<size_t>(8, minLen);
+    }
+    const char* a = key.data();
+    const char* b = other.data();
+    size_t i = from;
+    // Skip matching bytes a word at a time
+    for(; i + 8 <= minLen; i += 8) {
+        uint64_t wa, wb;
+        std::memcpy(&wa, a + i, 8);
+        std::memcpy(&wb, b + i, 8);
+        if(wa != wb) break;
+    }
+    for(; i < minLen && a[i] == b[i]; i++) { }
+    common = i;
+    if(i < minLen)
+        return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+    if(key.size() == other.size()) return 0;
+    return key.size() < other.size() ? -1 : 1;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the StringAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
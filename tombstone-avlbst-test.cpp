@@ -0,0 +1,118 @@
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include "tombstone-avlbst.h"
+
+using namespace std;
+
+
+int main(int argc, char *argv[])
+{
+    TombstoneAVLTree<int,int> tt(0.5);
+    for(int i = 0; i < 10; i++) tt.insert(std::make_pair(i, i * i));
+    tt.remove(3);
+    tt.remove(4);
+    cout << "Live items: " << tt.size() << ", tombstones: " << tt.tombstones() << endl;
+    cout << "Contents:";
+    for(TombstoneAVLTree<int,int>::iterator it = tt.begin(); it != tt.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+    cout << "Found 3: " << (tt.find(3) != tt.end()) << endl;
+    cout << "lower_bound(3): " << tt.lower_bound(3)->first << endl;
+    tt.insert(std::make_pair(3, 33));
+    cout << "Revived 3: " << tt[3] << ", tombstones: " << tt.tombstones() << endl;
+    cout << "Compacted: " << tt.compact() << ", balanced: " << tt.isBalanced() << endl;
+
+    // Randomized against std::map, with a filter attached
+    TombstoneAVLTree<int,int> rt(0.3);
+    rt.attachFilter(2000);
+    map<int,int> reference;
+    srand(104);
+    for(int i = 0; i < 50000; i++) {
+        int key = rand() % 2000;
+        if(rand() % 2 == 0) {
+            rt.remove(key);
+            reference.erase(key);
+        }
+        else {
+            rt.insert(std::make_pair(key, i));
+            reference[key] = i;
+        }
+    }
+    bool ok = rt.size() == reference.size();
+    map<int,int>::iterator ref = reference.begin();
+    for(TombstoneAVLTree<int,int>::iterator it = rt.begin(); ok && it != rt.end(); ++it, ++ref) {
+        ok = (it->first == ref->first && it->second == ref->second);
+    }
+    for(int key = 0; ok && key < 2000; key++) {
+        ok = (rt.find(key) != rt.end()) == (reference.count(key) == 1);
+    }
+    cout << "Randomized contents match: " << ok << endl;
+
+    TombstoneAVLTree<int,int> copy(rt);
+    TombstoneAVLTree<int,int> moved(std::move(rt));
+    cout << "Copy size: " << copy.size() << ", tombstones: " << copy.tombstones()
+         << ", moved size: " << moved.size() << ", source size: " << rt.size() << endl;
+
+    // A handle replaces a tombstone with its key; merge skips the dead
+    TombstoneAVLTree<int,int> a, b;
+    for(int i = 0; i < 10; i++) { a.insert(std::make_pair(i, i)); b.insert(std::make_pair(i + 5, -i)); }
+    a.remove(3);
+    b.remove(12);
+    AVLTree<int,int>::node_type handle = b.extract(5);
+    handle.mapped() = 500;
+    a.remove(5);
+    bool linked = a.insert(std::move(handle));
+    size_t merged = a.merge(b);
+    cout << "Handle over tombstone: " << linked << ", a[5] = " << a[5] << ", merged " << merged
+         << ", a size: " << a.size() << ", has 12: " << (a.find(12) != a.end()) << ", b size: " << b.size() << endl;
+
+    // The ends skip tombstones, and the pops free the ones they pass
+    TombstoneAVLTree<int,int> ends;
+    for(int i = 0; i < 10; i++) ends.insert(std::make_pair(i, i));
+    ends.remove(0);
+    ends.remove(1);
+    ends.remove(9);
+    cout << "Live ends: " << ends.front().first << " and " << ends.back().first << ", tombstones: " << ends.tombstones();
+    ends.pop_min();
+    ends.pop_max();
+    cout << "; after popping both: " << ends.front().first << " and " << ends.back().first << ", size "
+         << ends.size() << ", tombstones: " << ends.tombstones() << endl;
+
+    // The same through a reference to the base class
+    TombstoneAVLTree<int,int> viaBase;
+    BinarySearchTree<int,int>& base = viaBase;
+    for(int i = 0; i < 6; i++) viaBase.insert(std::make_pair(i, i));
+    viaBase.remove(0);
+    viaBase.remove(5);
+    int walked = 0;
+    for(BinarySearchTree<int,int>::iterator it = base.begin(); it != base.end(); ++it) walked++;
+    cout << "Base view: front " << base.front().first << ", back " << base.back().first << ", size " << base.size()
+         << ", walked " << walked << ", finds 0: " << (base.find(0) != base.end());
+    base.pop_min();
+    base.pop_max();
+    cout << "; after popping both: size " << base.size() << ", tombstones: " << viaBase.tombstones();
+    base.clear();
+    cout << "; after clear: size " << base.size() << ", tombstones: " << viaBase.tombstones() << endl;
+
+    // Handles and merge through an AVLTree reference keep the counts right
+    TombstoneAVLTree<int,int> target(1.0), source(1.0);
+    AVLTree<int,int>& baseTarget = target;
+    for(int i = 0; i < 10; i++) { target.insert(std::make_pair(i, i)); source.insert(std::make_pair(i + 3, i)); }
+    target.remove(2);
+    target.remove(4);
+    target.remove(8);
+    source.remove(8);
+    source.remove(11);
+    AVLTree<int,int>::node_type four = source.extract(4);
+    bool overDead = baseTarget.insert(std::move(four));
+    size_t fromBase = baseTarget.merge(source);
+    size_t liveTarget = 0, liveSource = 0;
+    for(AVLTree<int,int>::iterator it = baseTarget.begin(); it != baseTarget.end(); ++it) liveTarget++;
+    for(AVLTree<int,int>::iterator it = source.begin(); it != source.end(); ++it) liveSource++;
+    cout << "Base merge: moved " << fromBase << ", target size " << target.size() << " (walked " << liveTarget
+         << ", tombstones " << target.tombstones() << "), source size " << source.size() << " (walked " << liveSource
+         << ", tombstones " << source.tombstones() << "), handle over tombstone: " << overDead << endl;
+    return 0;
+}
@@ -0,0 +1,373 @@
+#ifndef TOMBSTONE_AVLBST_H
+#define TOMBSTONE_AVLBST_H
+
+#include <vector>
+#include "avlbst.h"
+
+/**
+ * An AVLNode with a flag marking it as deleted. The flag fits in the tail
+ * padding after the balance byte, so the node is no bigger than an AVLNode.
+ */
+template <typename Key, typename Value>
+class TombstoneAVLNode : public AVLNode<Key, Value>
+{
+public:
+    TombstoneAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual ~TombstoneAVLNode();
+
+    bool isDead() const;
+    void setDead(bool dead);
+    virtual TombstoneAVLNode<Key, Value>* cloneAt(void* where) const;
+    virtual size_t footprint() const;
+
+protected:
+    bool dead_;
+};
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the TombstoneAVLNode class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value>
+TombstoneAVLNode<Key, Value>::TombstoneAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent) :
+    AVLNode<Key, Value>(key, value, parent), dead_(false)
+{
+}
+
+template<class Key, class Value>
+TombstoneAVLNode<Key, Value>::~TombstoneAVLNode()
+{
+}
+
+template<class Key, class Value>
+bool TombstoneAVLNode<Key, Value>::isDead() const
+{
+    return dead_;
+}
+
+template<class Key, class Value>
+void TombstoneAVLNode<Key, Value>::setDead(bool dead)
+{
+    dead_ = dead;
+}
+
+template<class Key, class Value>
+TombstoneAVLNode<Key, Value>* TombstoneAVLNode<Key, Value>::cloneAt(void* where) const
+{
+    return new (where) TombstoneAVLNode<Key, Value>(*this);
+}
+
+template<class Key, class Value>
+size_t TombstoneAVLNode<Key, Value>::footprint() const
+{
+    return sizeof(*this);
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the TombstoneAVLNode class.
+  ----------------------------------------------------
+*/
+
+/**
+ * An AVLTree in lazy-delete mode.
+ *
+ * remove() only marks the node as a tombstone: no node swap, no free and no
+ * rebalancing. Lookups and iterators skip tombstones, and inserting a
+ * tombstoned key revives its node. Once tombstones make up more than
+ * compactThreshold of the nodes, compact() frees them and relinks the live
+ * nodes into a perfectly balanced tree in a single O(n) pass.
+ *
+ * A tombstoned key stays in the membership filter, if one is attached,
+ * until compaction frees its node.
+ */
+template <typename Key, typename Value>
+class TombstoneAVLTree : public AVLTree<Key, Value>
+{
+public:
+    TombstoneAVLTree(double compactThreshold = 0.5);
+    TombstoneAVLTree(const TombstoneAVLTree& other);
+    TombstoneAVLTree(TombstoneAVLTree&& other) noexcept;
+    TombstoneAVLTree& operator=(const TombstoneAVLTree& other);
+    TombstoneAVLTree& operator=(TombstoneAVLTree&& other) noexcept;
+
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void remove(const Key& key);
+    using AVLTree<Key, Value>::insert;
+    virtual void clear();
+    // The number of live items.
+    virtual size_t size() const;
+    size_t tombstones() const;
+    void setCompactThreshold(double compactThreshold);
+
+    // Frees every tombstone and rebuilds the tree; returns the number freed.
+    size_t compact();
+
+    // front(), back() and the iterators skip tombstones, since copiesAt
+    // says they hold nothing. The pops free their node outright, along
+    // with any tombstones in front of it: an end node needs no swap to
+    // come out.
+    virtual void pop_min();
+    virtual void pop_max();
+
+protected:
+    // Compacts first so the merge only sees live nodes.
+    virtual void insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads);
+    virtual AVLNode<Key, Value>* createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    virtual Node<Key, Value>* internalFind(const Key& key) const;
+    // Frees a node, live or not, keeping the tombstone count right.
+    virtual void eraseNode(Node<Key, Value>* node);
+    // Handles and merge carry a tombstone's count with it, and a node that
+    // arrives frees a tombstone holding its key. merge leaves the tombstones
+    // of the other tree where they are.
+    virtual typename AVLTree<Key, Value>::node_type extractNode(AVLNode<Key, Value>* node);
+    virtual void adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node);
+    virtual AVLNode<Key, Value>* adoptSlot(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& parent, bool& asLeftChild);
+    virtual size_t copiesAt(const Node<Key, Value>* node) const;
+    static bool isDead(const Node<Key, Value>* node);
+
+protected:
+    double compactThreshold_;
+    size_t tombstones_;
+};
+
+/*
+  -----------------------------------------------------
+  Begin implementations for the TombstoneAVLTree class.
+  -----------------------------------------------------
+*/
+
+template<class Key, class Value>
+TombstoneAVLTree<Key, Value>::TombstoneAVLTree(double compactThreshold) :
+    compactThreshold_(compactThreshold), tombstones_(0)
+{
+    this->copiesVary_ = true;
+}
+
+template<class Key, class Value>
+TombstoneAVLTree<Key, Value>::TombstoneAVLTree(const TombstoneAVLTree<Key, Value>& other) :
+    AVLTree<Key, Value>(other), compactThreshold_(other.compactThreshold_), tombstones_(other.tombstones_)
+{
+    this->copiesVary_ = true;
+}
+
+template<class Key, class Value>
+TombstoneAVLTree<Key, Value>::TombstoneAVLTree(TombstoneAVLTree<Key, Value>&& other) noexcept :
+    AVLTree<Key, Value>(std::move(other)), compactThreshold_(other.compactThreshold_), tombstones_(other.tombstones_)
+{
+    this->copiesVary_ = true;
+    other.tombstones_ = 0;
+}
+
+template<class Key, class Value>
+TombstoneAVLTree<Key, Value>& TombstoneAVLTree<Key, Value>::operator=(const TombstoneAVLTree<Key, Value>& other)
+{
+    AVLTree<Key, Value>::operator=(other);
+    compactThreshold_ = other.compactThreshold_;
+    tombstones_ = other.tombstones_;
+    return *this;
+}
+
+/**
+* Leaves other empty, with no tombstones.
+*/
+template<class Key, class Value>
+TombstoneAVLTree<Key, Value>& TombstoneAVLTree<Key, Value>::operator=(TombstoneAVLTree<Key, Value>&& other) noexcept
+{
+    if(this == &other) return *this;
+    AVLTree<Key, Value>::operator=(std::move(other));
+    compactThreshold_ = other.compactThreshold_;
+    tombstones_ = other.tombstones_;
+    other.tombstones_ = 0;
+    return *this;
+}
+
+/**
+* Inserts or overwrites an item, reviving the key's node if it is a tombstone.
+*/
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& new_item)
+{
+    TombstoneAVLNode<Key, Value>* node =
+        static_cast<TombstoneAVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::internalFind(new_item.first));
+    if(node != NULL && node->isDead()) {
+        node->setValue(new_item.second);
+        node->setDead(false);
+        tombstones_--;
+        return;
+    }
+    AVLTree<Key, Value>::insert(new_item);
+}
+
+/**
+* Marks the key's node as a tombstone, compacting if that pushes the
+* tombstone ratio past the threshold.
+*/
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::remove(const Key& key)
+{
+    TombstoneAVLNode<Key, Value>* node = static_cast<TombstoneAVLNode<Key, Value>*>(internalFind(key));
+    if(node == NULL) return;
+    node->setDead(true);
+    tombstones_++;
+    if(tombstones_ > compactThreshold_ * this->size_)
+        compact();
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::insertItems(std::vector<std::pair<Key, Value> >& batch, unsigned threads)
+{
+    compact();
+    AVLTree<Key, Value>::insertItems(batch, threads);
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::clear()
+{
+    BinarySearchTree<Key, Value>::clear();
+    tombstones_ = 0;
+}
+
+/**
+* Returns the number of live items.
+*/
+template<class Key, class Value>
+size_t TombstoneAVLTree<Key, Value>::size() const
+{
+    return this->size_ - tombstones_;
+}
+
+template<class Key, class Value>
+size_t TombstoneAVLTree<Key, Value>::tombstones() const
+{
+    return tombstones_;
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::setCompactThreshold(double compactThreshold)
+{
+    compactThreshold_ = compactThreshold;
+}
+
+/**
+* Walks the tree in order once, frees the tombstones and rebuilds the
+* remaining nodes into a balanced tree.
+*/
+template<class Key, class Value>
+size_t TombstoneAVLTree<Key, Value>::compact()
+{
+    if(tombstones_ == 0) return 0;
+    std::vector<AVLNode<Key, Value>*> live;
+    std::vector<TombstoneAVLNode<Key, Value>*> dead;
+    live.reserve(this->size_ - tombstones_);
+    dead.reserve(tombstones_);
+    for(Node<Key, Value>* n = this->getSmallestNode(); n != NULL; n = BinarySearchTree<Key, Value>::successor(n)) {
+        TombstoneAVLNode<Key, Value>* t = static_cast<TombstoneAVLNode<Key, Value>*>(n);
+        if(t->isDead()) dead.push_back(t);
+        else            live.push_back(t);
+    }
+    for(size_t i = 0; i < dead.size(); i++) {
+        if(this->filter_ != NULL) this->filter_->remove(dead[i]->getKey());
+        this->destroyNode(dead[i]);
+    }
+
+    int h;
+    this->root_ = this->buildBalanced(live, 0, live.size(), NULL, h);
+    this->size_ = live.size();
+    this->findExtremes();
+    tombstones_ = 0;
+    return dead.size();
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::pop_min()
+{
+    if(this->empty()) throw std::out_of_range("Empty tree");
+    while(isDead(this->smallest_))
+        eraseNode(this->smallest_);
+    eraseNode(this->smallest_);
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::pop_max()
+{
+    if(this->empty()) throw std::out_of_range("Empty tree");
+    while(isDead(this->largest_))
+        eraseNode(this->largest_);
+    eraseNode(this->largest_);
+}
+
+template<class Key, class Value>
+AVLNode<Key, Value>* TombstoneAVLTree<Key, Value>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+    return new TombstoneAVLNode<Key, Value>(key, value, parent);
+}
+
+/**
+* Finds the key's node, treating tombstones as absent.
+*/
+template<class Key, class Value>
+Node<Key, Value>* TombstoneAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+    Node<Key, Value>* node = BinarySearchTree<Key, Value>::internalFind(key);
+    if(node != NULL && isDead(node))
+        return NULL;
+    return node;
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::eraseNode(Node<Key, Value>* node)
+{
+    if(isDead(node)) tombstones_--;
+    AVLTree<Key, Value>::eraseNode(node);
+}
+
+template<class Key, class Value>
+typename AVLTree<Key, Value>::node_type TombstoneAVLTree<Key, Value>::extractNode(AVLNode<Key, Value>* node)
+{
+    if(isDead(node)) tombstones_--;
+    return AVLTree<Key, Value>::extractNode(node);
+}
+
+template<class Key, class Value>
+void TombstoneAVLTree<Key, Value>::adoptNode(AVLNode<Key, Value>* parent, bool asLeftChild, AVLNode<Key, Value>* node)
+{
+    if(isDead(node)) tombstones_++;
+    AVLTree<Key, Value>::adoptNode(parent, asLeftChild, node);
+}
+
+/**
+* A tombstone never moves in, so merge skips the other tree's; one here
+* with the node's key is freed to make room.
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>* TombstoneAVLTree<Key, Value>::adoptSlot(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& parent, bool& asLeftChild)
+{
+    if(isDead(node)) return node;
+    AVLNode<Key, Value>* here = this->findSlot(node->getKey(), parent, asLeftChild);
+    if(here == NULL || !isDead(here)) return here;
+    eraseNode(here);
+    return this->findSlot(node->getKey(), parent, asLeftChild);
+}
+
+template<class Key, class Value>
+size_t TombstoneAVLTree<Key, Value>::copiesAt(const Node<Key, Value>* node) const
+{
+    return isDead(node) ? 0 : 1;
+}
+
+template<class Key, class Value>
+bool TombstoneAVLTree<Key, Value>::isDead(const Node<Key, Value>* node)
+{
+    return static_cast<const TombstoneAVLNode<Key, Value>*>(node)->isDead();
+}
+
+/*
+  ---------------------------------------------------
+  End implementations for the TombstoneAVLTree class.
+  ---------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,183 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include "bst.h"
+#include "avlbst.h"
+#include "scapegoat-bst.h"
+#include "tombstone-avlbst.h"
+#include "counted-avlbst.h"
+#include "tree-trace.h"
+
+using namespace std;
+
+typedef TraceRecord<int,int> Record;
+
+// One call every microsecond of trace time
+static const uint64_t tick = 1000;
+
+// Uniform in [0, 1) from the engine alone, so a seed gives the same trace
+// with every standard library
+double unitDraw(mt19937& rng)
+{
+    return (rng() + 0.5) / 4294967296.0;
+}
+
+vector<int> shuffledKeys(size_t n, mt19937& rng)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; i++) keys[i] = (int)(2 * i);
+    for(size_t i = n; i > 1; i--) swap(keys[i - 1], keys[rng() % i]);
+    return keys;
+}
+
+void loadKeys(vector<Record>& trace, const vector<int>& keys)
+{
+    for(size_t i = 0; i < keys.size(); i++)
+        trace.push_back(Record(TRACE_INSERT, trace.size() * tick, keys[i], (int)i));
+}
+
+/**
+ * n inserts in ascending key order, as from a bulk import, then one full
+ * walk: the worst case for an unbalanced tree.
+ */
+vector<Record> sortedIngestTrace(size_t n)
+{
+    vector<Record> trace;
+    for(size_t i = 0; i < n; i++) trace.push_back(Record(TRACE_INSERT, i * tick, (int)i, (int)i));
+    if(n > 0) trace.push_back(Record(TRACE_WALK, n * tick, 0, 0, n - 1));
+    return trace;
+}
+
+/**
+ * n shuffled inserts, then 4n reads with Zipf s = 0.99 popularity: mostly
+ * find, one operator[] in ten, one miss in twenty and a 64 step walk every
+ * thousand calls.
+ */
+vector<Record> zipfReadTrace(size_t n)
+{
+    mt19937 rng(50);
+    vector<int> keys = shuffledKeys(n, rng);
+    vector<Record> trace;
+    loadKeys(trace, keys);
+    vector<double> cdf(n);
+    double total = 0;
+    for(size_t i = 0; i < n; i++) cdf[i] = (total += 1.0 / pow((double)(i + 1), 0.99));
+    for(size_t i = 0; i < 4 * n; i++) {
+        int key = keys[lower_bound(cdf.begin(), cdf.end(), unitDraw(rng) * total) - cdf.begin()];
+        uint64_t time = trace.size() * tick;
+        if(i % 1000 == 999)       trace.push_back(Record(TRACE_WALK, time, key, 0, 64));
+        else if(i % 20 == 19)     trace.push_back(Record(TRACE_FIND, time, key + 1));
+        else if(i % 10 == 9)      trace.push_back(Record(TRACE_AT, time, key));
+        else                      trace.push_back(Record(TRACE_FIND, time, key));
+    }
+    return trace;
+}
+
+/**
+ * n shuffled inserts, then 4n calls on 2n even keys: 40% inserts and 40%
+ * removes of uniformly random keys, which hold the size near n, and 20%
+ * finds.
+ */
+vector<Record> churnTrace(size_t n)
+{
+    mt19937 rng(51);
+    vector<Record> trace;
+    loadKeys(trace, shuffledKeys(n, rng));
+    for(size_t i = 0; i < 4 * n; i++) {
+        int key = (int)(unitDraw(rng) * 2 * n) * 2;
+        double op = unitDraw(rng);
+        uint64_t time = trace.size() * tick;
+        if(op < 0.4)      trace.push_back(Record(TRACE_INSERT, time, key, (int)i));
+        else if(op < 0.8) trace.push_back(Record(TRACE_REMOVE, time, key));
+        else              trace.push_back(Record(TRACE_FIND, time, key));
+    }
+    return trace;
+}
+
+template<typename Tree>
+void replay(const string& name, const vector<Record>& trace, size_t threads, double speed)
+{
+    vector<Tree> shards(threads);
+    ReplayStats stats = replayTrace(shards, trace, speed);
+    size_t items = 0;
+    for(size_t t = 0; t < threads; t++) items += shards[t].size();
+    cout << name << ", " << threads << " thread(s), speed " << speed << ": " << items << " items left" << endl;
+    cout << stats;
+}
+
+void usage()
+{
+    cerr << "usage: trace-replay --generate sorted|zipf|churn <trace> [n]" << endl
+         << "       trace-replay <trace> [bst|avl|scapegoat|tombstone|counted] [threads] [speed]" << endl
+         << "speed 0 (the default) replays as fast as possible, 1 at the recorded pace" << endl;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 2) {
+        usage();
+        return 1;
+    }
+    string first = argv[1];
+    if(first == "--generate") {
+        if(argc < 4) {
+            usage();
+            return 1;
+        }
+        string kind = argv[2];
+        size_t n = (argc > 4) ? strtoul(argv[4], NULL, 10) : 100000;
+        vector<Record> trace;
+        if(kind == "sorted")     trace = sortedIngestTrace(n);
+        else if(kind == "zipf")  trace = zipfReadTrace(n);
+        else if(kind == "churn") trace = churnTrace(n);
+        else {
+            usage();
+            return 1;
+        }
+        ofstream out(argv[3], ios::binary);
+        try {
+            writeTrace(out, trace);
+            out.flush();
+            if(!out) throw runtime_error("Cannot write trace");
+        }
+        catch(runtime_error& e) {
+            cerr << argv[3] << ": " << e.what() << endl;
+            return 1;
+        }
+        cout << "Wrote " << trace.size() << " records to " << argv[3] << endl;
+        return 0;
+    }
+
+    string tree = (argc > 2) ? argv[2] : "avl";
+    size_t threads = (argc > 3) ? max(strtoul(argv[3], NULL, 10), 1ul) : 1;
+    double speed = (argc > 4) ? atof(argv[4]) : 0.0;
+    ifstream in(first.c_str(), ios::binary);
+    if(!in) {
+        cerr << "Cannot open " << first << endl;
+        return 1;
+    }
+    vector<Record> trace;
+    try {
+        trace = readTrace<int,int>(in);
+    }
+    catch(runtime_error& e) {
+        cerr << first << ": " << e.what() << endl;
+        return 1;
+    }
+
+    if(tree == "bst")            replay<BinarySearchTree<int,int> >("BinarySearchTree", trace, threads, speed);
+    else if(tree == "avl")       replay<AVLTree<int,int> >("AVLTree", trace, threads, speed);
+    else if(tree == "scapegoat") replay<ScapegoatTree<int,int> >("ScapegoatTree", trace, threads, speed);
+    else if(tree == "tombstone") replay<TombstoneAVLTree<int,int> >("TombstoneAVLTree", trace, threads, speed);
+    else if(tree == "counted")   replay<CountedAVLTree<int,int> >("CountedAVLTree", trace, threads, speed);
+    else {
+        usage();
+        return 1;
+    }
+    return 0;
+}
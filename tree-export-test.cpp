@@ -0,0 +1,54 @@
+#include <iostream>
+#include <limits>
+#include <string>
+#include "bst.h"
+#include "avlbst.h"
+#include "tree-export.h"
+
+using namespace std;
+
+
+int main(int argc, char *argv[])
+{
+    AVLTree<int,string> tree;
+    const char* names[] = { "zero", "one", "two \"2\"", "three", "four", "five", "six", "seven", "eight", "nine" };
+    for(int i = 0; i < 10; i++) tree.insert(std::make_pair(i, string(names[i])));
+
+    cout << "Text:" << endl;
+    TreeExporter<int,string> text(cout, TreeExporter<int,string>::TEXT);
+    text.write(tree);
+
+    cout << "Text, depth <= 1:" << endl;
+    text.setMaxDepth(1);
+    text.write(tree);
+
+    cout << "JSON lines, keys 2..6:" << endl;
+    TreeExporter<int,string> json(cout, TreeExporter<int,string>::JSON_LINES);
+    json.setKeyRange(2, 6);
+    size_t written = json.write(tree);
+    cout << "Nodes written: " << written << endl;
+
+    cout << "DOT, keys 4..9, depth <= 2:" << endl;
+    TreeExporter<int,string> dot(cout, TreeExporter<int,string>::DOT);
+    dot.setKeyRange(4, 9);
+    dot.setMaxDepth(2);
+    dot.write(tree);
+
+    // Quotes, backslashes and control characters in labels, and numbers JSON cannot hold
+    AVLTree<string,double> awkward;
+    awkward.insert(std::make_pair(string("say \"hi\"\\now"), numeric_limits<double>::quiet_NaN()));
+    awkward.insert(std::make_pair(string("two\nlines\tand tab"), numeric_limits<double>::infinity()));
+    awkward.insert(std::make_pair(string("plain"), 1.5));
+    cout << "Awkward labels as DOT and JSON lines:" << endl;
+    TreeExporter<string,double>(cout, TreeExporter<string,double>::DOT).write(awkward);
+    TreeExporter<string,double>(cout, TreeExporter<string,double>::JSON_LINES).write(awkward);
+
+    // Sorted inserts into a BinarySearchTree make a chain as deep as the tree
+    BinarySearchTree<int,int> chain;
+    for(int i = 0; i < 20000; i++) chain.insert(std::make_pair(i, i));
+    TreeExporter<int,int> counter(cout, TreeExporter<int,int>::JSON_LINES);
+    counter.setKeyRange(19998, 40000);
+    cout << "Deep chain, last keys:" << endl;
+    counter.write(chain);
+    return 0;
+}
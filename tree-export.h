@@ -0,0 +1,289 @@
+#ifndef TREE_EXPORT_H
+#define TREE_EXPORT_H
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "bst.h"
+
+/**
+ * Writes a tree, a subtree, or a depth- or key-range-limited slice of one
+ * to a stream as Graphviz DOT, JSON lines or indented text.
+ *
+ * Nodes are written in pre-order as they are visited. The only state is a
+ * stack of right children still to visit along the current path, so
+ * memory is O(height) whatever the size of the tree, and nothing is held
+ * back until the end.
+ *
+ * Nodes outside the key range are not written. A written node's parent is
+ * its nearest written ancestor, so the slice stays one connected tree.
+ * Nodes at the depth limit whose children were cut off are marked as
+ * truncated.
+ */
+template <typename Key, typename Value>
+class TreeExporter
+{
+public:
+    enum Format { DOT, JSON_LINES, TEXT };
+
+    TreeExporter(std::ostream& out, Format format);
+
+    // Only write nodes at most maxDepth edges below the starting node; -1 for no limit.
+    void setMaxDepth(int maxDepth);
+    // Only write nodes with lo <= key <= hi.
+    void setKeyRange(const Key& lo, const Key& hi);
+    void clearKeyRange();
+
+    // Write the whole tree, or the subtree at node; return the number of nodes written.
+    size_t write(const BinarySearchTree<Key, Value>& tree);
+    size_t write(const Node<Key, Value>* subtree);
+
+protected:
+    struct Pending {
+        const Node<Key, Value>* node;
+        int depth;
+        size_t parentId;    // 0 when no ancestor has been written
+        char side;          // 'L' or 'R' below that ancestor, ' ' for the top
+    };
+
+    // Helper functions
+    bool inRange(const Key& key) const;
+    void writeNode(const Node<Key, Value>* node, size_t id, const Pending& at, bool truncated);
+    template<typename T>
+    void writeLabel(const T& value, std::true_type);
+    template<typename T>
+    void writeLabel(const T& value, std::false_type);
+    template<typename T>
+    void writeJsonValue(const T& value, std::true_type);
+    template<typename T>
+    void writeJsonValue(const T& value, std::false_type);
+    void writeEscaped(const std::string& text);
+    template<typename T>
+    static std::string toText(const T& value);
+
+protected:
+    std::ostream& out_;
+    Format format_;
+    int maxDepth_;
+    bool hasRange_;
+    Key lo_;
+    Key hi_;
+};
+
+/*
+  --------------------------------------------------
+  Begin implementations for the TreeExporter class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value>
+TreeExporter<Key, Value>::TreeExporter(std::ostream& out, Format format) :
+    out_(out), format_(format), maxDepth_(-1), hasRange_(false), lo_(), hi_()
+{
+}
+
+template<class Key, class Value>
+void TreeExporter<Key, Value>::setMaxDepth(int maxDepth)
+{
+    maxDepth_ = maxDepth;
+}
+
+template<class Key, class Value>
+void TreeExporter<Key, Value>::setKeyRange(const Key& lo, const Key& hi)
+{
+    hasRange_ = true;
+    lo_ = lo;
+    hi_ = hi;
+}
+
+template<class Key, class Value>
+void TreeExporter<Key, Value>::clearKeyRange()
+{
+    hasRange_ = false;
+}
+
+template<class Key, class Value>
+size_t TreeExporter<Key, Value>::write(const BinarySearchTree<Key, Value>& tree)
+{
+    return write(tree.getRoot());
+}
+
+/**
+* Pre-order walk that skips subtrees lying wholly outside the key range or
+* below the depth limit.
+*/
+template<class Key, class Value>
+size_t TreeExporter<Key, Value>::write(const Node<Key, Value>* subtree)
+{
+    if(format_ == DOT)
+        out_ << "digraph tree {\n  node [shape=box];\n";
+    size_t written = 0;
+    std::vector<Pending> stack;
+    if(subtree != NULL) {
+        Pending top = { subtree, 0, 0, ' ' };
+        stack.push_back(top);
+    }
+    while(!stack.empty()) {
+        Pending at = stack.back();
+        stack.pop_back();
+        const Node<Key, Value>* n = at.node;
+        const Node<Key, Value>* left = n->getLeft();
+        const Node<Key, Value>* right = n->getRight();
+        // Smaller keys are all on the left, larger ones on the right
+        if(hasRange_ && n->getKey() < lo_) left = NULL;
+        if(hasRange_ && hi_ < n->getKey()) right = NULL;
+        bool atLimit = (maxDepth_ >= 0 && at.depth >= maxDepth_);
+
+        size_t parentId = at.parentId;
+        char leftSide = 'L', rightSide = 'R';
+        if(inRange(n->getKey())) {
+            parentId = ++written;
+            writeNode(n, parentId, at, atLimit && (left != NULL || right != NULL));
+        }
+        else {
+            // Children hang off the nearest written ancestor, on its side
+            leftSide = rightSide = at.side;
+        }
+        if(atLimit) continue;
+        if(right != NULL) {
+            Pending p = { right, at.depth + 1, parentId, rightSide };
+            stack.push_back(p);
+        }
+        if(left != NULL) {
+            Pending p = { left, at.depth + 1, parentId, leftSide };
+            stack.push_back(p);
+        }
+    }
+    if(format_ == DOT)
+        out_ << "}\n";
+    else if(format_ == TEXT && written == 0)
+        out_ << "<empty tree>\n";
+    return written;
+}
+
+template<class Key, class Value>
+bool TreeExporter<Key, Value>::inRange(const Key& key) const
+{
+    return !hasRange_ || (!(key < lo_) && !(hi_ < key));
+}
+
+/**
+* Helper function: writeNode
+*
+* DOT: a box per node and a labelled edge from its parent; truncated nodes
+* are dashed.
+* JSON lines: {"id", "parent", "side", "depth", "key", "value", "truncated"}
+* with parent 0 for the top node.
+* Text: two spaces per depth, the side, then "key: value".
+*/
+template<class Key, class Value>
+void TreeExporter<Key, Value>::writeNode(const Node<Key, Value>* node, size_t id, const Pending& at, bool truncated)
+{
+    if(format_ == DOT) {
+        out_ << "  n" << id << " [label=\"";
+        writeLabel(node->getKey(), std::integral_constant<bool, std::is_arithmetic<Key>::value>());
+        out_ << ": ";
+        writeLabel(node->getValue(), std::integral_constant<bool, std::is_arithmetic<Value>::value>());
+        out_ << "\"" << (truncated ? ", style=dashed" : "") << "];\n";
+        if(at.parentId != 0)
+            out_ << "  n" << at.parentId << " -> n" << id << " [label=\"" << at.side << "\"];\n";
+    }
+    else if(format_ == JSON_LINES) {
+        out_ << "{\"id\":" << id << ",\"parent\":" << at.parentId << ",\"side\":\"";
+        if(at.side != ' ') out_ << at.side;
+        out_ << "\",\"depth\":" << at.depth << ",\"key\":";
+        writeJsonValue(node->getKey(), std::integral_constant<bool, std::is_arithmetic<Key>::value>());
+        out_ << ",\"value\":";
+        writeJsonValue(node->getValue(), std::integral_constant<bool, std::is_arithmetic<Value>::value>());
+        out_ << ",\"truncated\":" << (truncated ? "true" : "false") << "}\n";
+    }
+    else {
+        static const char spaces[] = "                                                                ";
+        for(size_t indent = 2 * (size_t)at.depth; indent > 0; ) {
+            size_t chunk = std::min(indent, sizeof(spaces) - 1);
+            out_.write(spaces, chunk);
+            indent -= chunk;
+        }
+        if(at.side != ' ') out_ << at.side << " ";
+        out_ << node->getKey() << ": " << node->getValue() << (truncated ? " ..." : "") << "\n";
+    }
+}
+
+// Numbers need no escaping inside a DOT label
+template<class Key, class Value>
+template<typename T>
+void TreeExporter<Key, Value>::writeLabel(const T& value, std::true_type)
+{
+    out_ << value;
+}
+
+template<class Key, class Value>
+template<typename T>
+void TreeExporter<Key, Value>::writeLabel(const T& value, std::false_type)
+{
+    writeEscaped(toText(value));
+}
+
+// Numbers are written as JSON numbers, everything else as JSON strings.
+// JSON has no NaN or infinity, so those are written as null.
+template<class Key, class Value>
+template<typename T>
+void TreeExporter<Key, Value>::writeJsonValue(const T& value, std::true_type)
+{
+    if(std::isfinite(+value)) out_ << +value;
+    else                      out_ << "null";
+}
+
+template<class Key, class Value>
+template<typename T>
+void TreeExporter<Key, Value>::writeJsonValue(const T& value, std::false_type)
+{
+    out_ << '"';
+    writeEscaped(toText(value));
+    out_ << '"';
+}
+
+/**
+* Helper function: writeEscaped
+*
+* Escapes text for a double-quoted DOT label or JSON string. DOT has no
+* numeric escapes: a newline becomes the label's own \n line break and
+* other control characters become spaces.
+*/
+template<class Key, class Value>
+void TreeExporter<Key, Value>::writeEscaped(const std::string& text)
+{
+    static const char* hex = "0123456789abcdef";
+    for(size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        if(c == '"' || c == '\\')
+            out_ << '\\' << (char)c;
+        else if(c >= 0x20 && c != 0x7f)
+            out_ << (char)c;
+        else if(format_ != DOT)
+            out_ << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+        else
+            out_ << (c == '\n' ? "\\n" : " ");
+    }
+}
+
+template<class Key, class Value>
+template<typename T>
+std::string TreeExporter<Key, Value>::toText(const T& value)
+{
+    std::ostringstream os;
+    os << value;
+    return os.str();
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the TreeExporter class.
+  ------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include "tree-finger.h"
+#include "avlbst.h"
+#include "scapegoat-bst.h"
+#include "aggregate-avlbst.h"
+
+using namespace std;
+
+
+// Mixed finds, lower_bounds, inserts and removes on clustered, drifting keys,
+// checked against std::map
+template<typename Tree>
+bool matchesMap(Tree& tree, unsigned seed)
+{
+    TreeFinger<int,int> finger(tree);
+    map<int,int> reference;
+    srand(seed);
+    int center = 0;
+    bool ok = true;
+    for(int i = 0; ok && i < 30000; i++) {
+        if(i % 200 == 0) center = rand() % 5000;
+        int key = center + (i % 200) / 2 + rand() % 8;
+        int op = rand() % 10;
+        if(op < 4) {
+            // Some inserts bypass the finger, landing next to it
+            if(op < 2) finger.insert(std::make_pair(key, i));
+            else tree.insert(std::make_pair(key, i));
+            reference[key] = i;
+        }
+        else if(op < 5) {
+            tree.remove(key);
+            reference.erase(key);
+        }
+        else if(op < 8) {
+            typename Tree::iterator it = finger.find(key);
+            map<int,int>::iterator ref = reference.find(key);
+            ok = (ref == reference.end()) ? it == tree.end() : (it != tree.end() && it->second == ref->second);
+        }
+        else {
+            typename Tree::iterator it = finger.lower_bound(key);
+            map<int,int>::iterator ref = reference.lower_bound(key);
+            ok = (ref == reference.end()) ? it == tree.end() : (it != tree.end() && it->first == ref->first);
+        }
+    }
+    return ok && tree.size() == reference.size();
+}
+
+int main(int argc, char *argv[])
+{
+    AVLTree<int,int> at;
+    for(int i = 0; i < 100; i++) at.insert(std::make_pair(2 * i, i));
+    TreeFinger<int,int> finger(at);
+    cout << "find(40): " << finger.find(40)->second << ", find(42): " << finger.find(42)->second
+         << ", find(43) is end: " << (finger.find(43) == at.end()) << endl;
+    cout << "lower_bound(43): " << finger.lower_bound(43)->first << ", lower_bound(-5): "
+         << finger.lower_bound(-5)->first << ", lower_bound(199) is end: " << (finger.lower_bound(199) == at.end()) << endl;
+    finger.insert(std::make_pair(41, -1));
+    finger.insert(std::make_pair(44, -2));
+    cout << "After finger inserts: at[41] = " << at[41] << ", at[44] = " << at[44] << ", size " << at.size()
+         << ", balanced " << at.isBalanced() << endl;
+
+    // Walking in key order costs a few steps per key, not a root-to-leaf path
+    AVLTree<int,int> big;
+    for(int i = 0; i < 100000; i++) big.insert(std::make_pair(i, i));
+    TreeFinger<int,int> walker(big);
+    for(int i = 0; i < 100000; i++) walker.find(i);
+    cout << "Sequential finds over 100000 keys: " << (double)walker.steps() / 100000 << " steps each" << endl;
+
+    // A remove frees nodes, after which the finger starts over from the root
+    walker.find(500);
+    big.remove(500);
+    cout << "After removing the finger's node: find(500) is end: " << (walker.find(500) == big.end())
+         << ", find(501): " << walker.find(501)->second << endl;
+
+    // Randomized, with AVL and scapegoat balancing done by the finger's inserts
+    AVLTree<int,int> avl;
+    ScapegoatTree<int,int> scapegoat;
+    BinarySearchTree<int,int> plain;
+    bool avlOk = matchesMap(avl, 43);
+    cout << "Randomized AVL matches: " << avlOk << " (balanced " << avl.isBalanced() << "), scapegoat matches: "
+         << matchesMap(scapegoat, 43) << ", plain BST matches: " << matchesMap(plain, 43) << endl;
+
+    // Writes through a finger keep aggregates up to date
+    AggregateAVLTree<int,int> sums;
+    for(int i = 0; i < 100; i++) sums.insert(std::make_pair(i, 1));
+    TreeFinger<int,int> writer(sums);
+    for(int i = 0; i < 100; i += 10) writer.insert(std::make_pair(i, 2));
+    writer.insert(std::make_pair(1000, 5));
+    cout << "Aggregate total after finger writes: " << sums.total() << endl;
+    return 0;
+}
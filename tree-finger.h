@@ -0,0 +1,225 @@
+#ifndef TREE_FINGER_H
+#define TREE_FINGER_H
+
+#include <utility>
+#include "bst.h"
+
+/**
+ * A cursor that remembers the last node it visited in a tree and starts
+ * the next search from there: it climbs via parent links only until the
+ * key falls inside the current subtree, then descends as usual. In a
+ * balanced tree a key d positions away costs O(log d) instead of
+ * O(log n), which pays off for sequential or clustered access.
+ *
+ * Works with BinarySearchTree and the trees derived from it, whose inserts
+ * go through insertAt so AVL and scapegoat balancing still happen. The
+ * finger notices when the tree may have freed or moved its node (removes,
+ * clear, extract, relayout, moves) and then starts over from the root.
+ * TombstoneAVLTree is not supported: a finger would see its dead nodes.
+ */
+template <typename Key, typename Value>
+class TreeFinger
+{
+public:
+    typedef typename BinarySearchTree<Key, Value>::iterator iterator;
+
+    explicit TreeFinger(BinarySearchTree<Key, Value>& tree);
+
+    iterator find(const Key& key);
+    iterator lower_bound(const Key& key);
+    // Inserts or overwrites, like the tree's insert.
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    // Forgets the position; the next search starts at the root.
+    void reset();
+
+    // Levels climbed and descended over all searches, to compare with
+    // searches from the root.
+    size_t steps() const;
+
+protected:
+    // Helper functions
+    Node<Key, Value>* locate(const Key& key, Node<Key, Value>*& bound);
+
+protected:
+    BinarySearchTree<Key, Value>& tree_;
+    Node<Key, Value>* finger_;
+    Node<Key, Value>* next_;    // finger_'s successor (NULL past the end), if nextKnown_
+    bool nextKnown_;
+    size_t arrivals_;       // the tree's count when next_ was found
+    size_t departures_;     // the tree's count when finger_ was set
+    size_t steps_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TreeFinger class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+TreeFinger<Key, Value>::TreeFinger(BinarySearchTree<Key, Value>& tree) :
+    tree_(tree), finger_(NULL), next_(NULL), nextKnown_(false), arrivals_(0), departures_(tree.departures_), steps_(0)
+{
+}
+
+template<class Key, class Value>
+typename TreeFinger<Key, Value>::iterator TreeFinger<Key, Value>::find(const Key& key)
+{
+    if(tree_.filter_ != NULL && !tree_.filter_->mayContain(key)) return tree_.end();
+    Node<Key, Value>* bound;
+    Node<Key, Value>* node = locate(key, bound);
+    if(node == NULL || node->getKey() != key) return tree_.end();
+    return tree_.iteratorAt(node);
+}
+
+template<class Key, class Value>
+typename TreeFinger<Key, Value>::iterator TreeFinger<Key, Value>::lower_bound(const Key& key)
+{
+    Node<Key, Value>* bound;
+    Node<Key, Value>* node = locate(key, bound);
+    if(node != NULL && node->getKey() == key) return tree_.iteratorAt(node);
+    return tree_.iteratorAt(bound);
+}
+
+template<class Key, class Value>
+void TreeFinger<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Node<Key, Value>* bound;
+    Node<Key, Value>* node = locate(keyValuePair.first, bound);
+    if(node != NULL && node->getKey() == keyValuePair.first) {
+        tree_.assignValue(node, keyValuePair.second);
+        return;
+    }
+    bool asLeftChild = (node != NULL && keyValuePair.first < node->getKey());
+    finger_ = tree_.insertAt(node, asLeftChild, keyValuePair);
+    next_ = asLeftChild ? node : bound;
+    nextKnown_ = true;
+    arrivals_ = tree_.arrivals_;
+    departures_ = tree_.departures_;
+}
+
+template<class Key, class Value>
+void TreeFinger<Key, Value>::reset()
+{
+    finger_ = NULL;
+    nextKnown_ = false;
+}
+
+template<class Key, class Value>
+size_t TreeFinger<Key, Value>::steps() const
+{
+    return steps_;
+}
+
+/**
+* Helper function: locate
+*
+* Returns the node holding key, or else the last node visited, under which
+* key would be inserted (NULL only for an empty tree), and moves the finger
+* there. bound is set to the smallest node with a larger key, or NULL.
+*
+* Going right from the finger, the climb stops at the first ancestor the
+* path enters from the left, once that ancestor's key is not below key:
+* everything between the finger and it lies in the subtree left behind.
+* Going left is the mirror image, except that the climb leaves no upper
+* bound, so a miss off the right end of the subtree asks for the successor.
+* A climb that runs out of ancestors descends from the last one it entered
+* from the matching side, not the root: past that one, no key lies between
+* the finger and key.
+*
+* No climb at all is needed for a key between a finger without a right
+* child and its known successor, which is the common case for appends:
+* that gap can only be the finger's right child. Rotations and rebuilds
+* keep the in-order sequence, so the saved successor holds until some
+* other insert links a node in, which the tree counts.
+*/
+template<class Key, class Value>
+Node<Key, Value>* TreeFinger<Key, Value>::locate(const Key& key, Node<Key, Value>*& bound)
+{
+    if(departures_ != tree_.departures_) {
+        reset();
+        departures_ = tree_.departures_;
+    }
+    Node<Key, Value>* current = (finger_ != NULL) ? finger_ : tree_.root_;
+    bound = NULL;
+    if(current == NULL) return NULL;
+    if(nextKnown_ && arrivals_ == tree_.arrivals_ && current->getRight() == NULL && current->getKey() < key &&
+       (next_ == NULL || key < next_->getKey())) {
+        steps_++;
+        bound = next_;
+        return current;
+    }
+
+    Node<Key, Value>* open = current;
+    if(current->getKey() < key) {
+        Node<Key, Value>* parent = current->getParent();
+        for(; parent != NULL; current = parent, parent = parent->getParent()) {
+            steps_++;
+            if(parent->getLeft() != current) continue;
+            if(!(parent->getKey() < key)) {
+                bound = parent;
+                if(parent->getKey() == key) {
+                    finger_ = parent;
+                    nextKnown_ = false;
+                    return parent;
+                }
+                break;
+            }
+            open = parent;
+        }
+        if(parent == NULL) current = open;
+    }
+    else if(key < current->getKey()) {
+        Node<Key, Value>* parent = current->getParent();
+        for(; parent != NULL; current = parent, parent = parent->getParent()) {
+            steps_++;
+            if(parent->getRight() != current) continue;
+            if(!(key < parent->getKey())) {
+                if(parent->getKey() == key) {
+                    finger_ = parent;
+                    nextKnown_ = false;
+                    return parent;
+                }
+                break;
+            }
+            open = parent;
+        }
+        if(parent == NULL) current = open;
+    }
+
+    Node<Key, Value>* last = current;
+    Node<Key, Value>* within = NULL;
+    while(current != NULL) {
+        steps_++;
+        last = current;
+        if(key < current->getKey()) {
+            within = current;
+            current = current->getLeft();
+        }
+        else if(current->getKey() < key)
+            current = current->getRight();
+        else {
+            finger_ = current;
+            nextKnown_ = false;
+            return current;
+        }
+    }
+    if(within != NULL)
+        bound = within;
+    else if(bound == NULL)
+        bound = BinarySearchTree<Key, Value>::successor(last);
+    finger_ = last;
+    // The search fell off last's right side exactly when bound follows it
+    nextKnown_ = (last->getKey() < key);
+    next_ = bound;
+    arrivals_ = tree_.arrivals_;
+    return last;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TreeFinger class.
+  -----------------------------------------------
+*/
+
+#endif
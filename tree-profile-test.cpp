@@ -0,0 +1,43 @@
+#include <iostream>
+#include <cstdlib>
+#include "bst.h"
+#include "avlbst.h"
+#include "tree-profile.h"
+
+using namespace std;
+
+// A node shaped like the one in equal-paths.h
+struct PlainNode {
+    int key;
+    PlainNode *left, *right;
+    PlainNode(int k, PlainNode* lt = nullptr, PlainNode* rt = nullptr) : key(k), left(lt), right(rt) {}
+};
+
+int main(int argc, char *argv[])
+{
+    // Keys inserted in order make a BinarySearchTree into a chain
+    BinarySearchTree<int,int> chain;
+    for(int i = 0; i < 8; i++) chain.insert(std::make_pair(i, i));
+    cout << "Sorted inserts into BinarySearchTree: " << profileTree(chain);
+
+    BinarySearchTree<int,int> bt;
+    const int keys[] = { 4, 2, 6, 1, 3, 5, 7 };
+    for(int i = 0; i < 7; i++) bt.insert(std::make_pair(keys[i], keys[i]));
+    cout << "Perfect BinarySearchTree: " << profileTree(bt);
+
+    AVLTree<int,int> avl;
+    for(int i = 0; i < 1000; i++) avl.insert(std::make_pair(i, i));
+    TreeProfile p = profileTree(avl);
+    cout << "AVLTree of 1000 sorted keys: " << p;
+    size_t counted = 0;
+    for(size_t d = 0; d < p.leafDepthHistogram.size(); d++) counted += p.leafDepthHistogram[d];
+    cout << "Histogram covers every leaf: " << (counted == p.leaves) << endl;
+
+    PlainNode c(3), b(2, nullptr, &c), a(1, &b, nullptr);
+    cout << "Plain nodes: " << profileTree(&a);
+    PlainNode d(4);
+    a.right = &d;
+    cout << "Plain nodes, one more leaf: " << profileTree(&a);
+    cout << "Empty tree: " << profileTree(BinarySearchTree<int,int>());
+    return 0;
+}
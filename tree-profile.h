@@ -0,0 +1,115 @@
+#ifndef TREE_PROFILE_H
+#define TREE_PROFILE_H
+
+#include <iostream>
+#include <utility>
+#include <vector>
+
+template <typename Key, typename Value>
+class BinarySearchTree;
+
+/**
+ * The shape of a binary tree as seen by lookups. Depths count edges from
+ * the root, so the root is at depth 0.
+ */
+struct TreeProfile
+{
+    TreeProfile() :
+        nodes(0), leaves(0), minLeafDepth(-1), maxLeafDepth(-1),
+        averageLeafDepth(0.0), averageNodeDepth(0.0), equalPaths(true)
+    {}
+
+    size_t nodes;
+    size_t leaves;
+    int minLeafDepth;               // -1 for an empty tree
+    int maxLeafDepth;               // also the height in edges
+    double averageLeafDepth;
+    double averageNodeDepth;        // expected cost of a successful lookup
+    bool equalPaths;                // same verdict as equalPaths()
+    std::vector<size_t> leafDepthHistogram;  // leaves at each depth
+
+    friend std::ostream& operator<<(std::ostream& os, const TreeProfile& p)
+    {
+        os << "nodes " << p.nodes << ", leaves " << p.leaves
+           << ", leaf depth min " << p.minLeafDepth << " / avg " << p.averageLeafDepth
+           << " / max " << p.maxLeafDepth << ", avg node depth " << p.averageNodeDepth
+           << ", equal paths " << p.equalPaths << std::endl;
+        for(size_t d = 0; d < p.leafDepthHistogram.size(); d++) {
+            if(p.leafDepthHistogram[d] != 0)
+                os << "  depth " << d << ": " << p.leafDepthHistogram[d] << " leaves" << std::endl;
+        }
+        return os;
+    }
+};
+
+namespace tree_profile_detail {
+
+// Child access for BinarySearchTree nodes (getLeft/getRight) and for plain
+// structs with left/right members such as the one in equal-paths.h. The
+// int/long argument prefers the accessor when a type has both.
+template <typename N>
+auto leftOf(const N* n, int) -> decltype(n->getLeft()) { return n->getLeft(); }
+template <typename N>
+auto leftOf(const N* n, long) -> decltype(n->left) { return n->left; }
+template <typename N>
+auto rightOf(const N* n, int) -> decltype(n->getRight()) { return n->getRight(); }
+template <typename N>
+auto rightOf(const N* n, long) -> decltype(n->right) { return n->right; }
+
+}
+
+/**
+ * Profiles the subtree at root in one iterative pass: O(n) time and
+ * O(height) memory, since the stack only holds the right siblings along
+ * the current path and the histogram has one slot per depth.
+ */
+template <typename N>
+TreeProfile profileTree(const N* root)
+{
+    using tree_profile_detail::leftOf;
+    using tree_profile_detail::rightOf;
+    TreeProfile p;
+    if(root == NULL) return p;
+
+    size_t leafDepthSum = 0, nodeDepthSum = 0;
+    std::vector<std::pair<const N*, int> > stack;
+    stack.push_back(std::make_pair(root, 0));
+    while(!stack.empty()) {
+        const N* n = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        // Follow left children directly and stack only the right ones
+        while(true) {
+            p.nodes++;
+            nodeDepthSum += depth;
+            const N* left = leftOf(n, 0);
+            const N* right = rightOf(n, 0);
+            if(left == NULL && right == NULL) {
+                if(p.leafDepthHistogram.size() <= (size_t)depth)
+                    p.leafDepthHistogram.resize(depth + 1, 0);
+                p.leafDepthHistogram[depth]++;
+                p.leaves++;
+                leafDepthSum += depth;
+                if(p.minLeafDepth == -1 || depth < p.minLeafDepth) p.minLeafDepth = depth;
+                if(depth > p.maxLeafDepth) p.maxLeafDepth = depth;
+                break;
+            }
+            depth++;
+            if(left != NULL && right != NULL)
+                stack.push_back(std::make_pair(right, depth));
+            n = (left != NULL) ? left : right;
+        }
+    }
+    p.averageLeafDepth = (double)leafDepthSum / p.leaves;
+    p.averageNodeDepth = (double)nodeDepthSum / p.nodes;
+    p.equalPaths = (p.minLeafDepth == p.maxLeafDepth);
+    return p;
+}
+
+template <typename Key, typename Value>
+TreeProfile profileTree(const BinarySearchTree<Key, Value>& tree)
+{
+    return profileTree(tree.getRoot());
+}
+
+#endif
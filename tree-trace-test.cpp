@@ -0,0 +1,172 @@
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <cstdlib>
+#include "avlbst.h"
+#include "tree-trace.h"
+
+using namespace std;
+
+
+// Same items in the same order
+bool sameItems(const BinarySearchTree<int,int>& a, const BinarySearchTree<int,int>& b)
+{
+    BinarySearchTree<int,int>::iterator ia = a.begin(), ib = b.begin();
+    for(; ia != a.end() && ib != b.end(); ++ia, ++ib)
+        if(ia->first != ib->first || ia->second != ib->second) return false;
+    return ia == a.end() && ib == b.end();
+}
+
+int main(int argc, char *argv[])
+{
+    // Record a short session
+    AVLTree<int,int> tree;
+    stringstream buffer;
+    {
+        RecordingTree<int,int> recorder(tree, buffer);
+        for(int i = 0; i < 5; i++) recorder.insert(std::make_pair(i * 10, i));
+        recorder.remove(20);
+        recorder.find(30);
+        recorder[40] = 400;
+        try {
+            recorder[41];
+        }
+        catch(std::out_of_range&) {
+        }
+        int sum = 0;
+        for(RecordingTree<int,int>::iterator it = recorder.begin(); it != recorder.end(); ++it) sum += it->second;
+        RecordingTree<int,int>::iterator from = recorder.find(10);
+        ++from;
+        cout << "Recorded " << recorder.records() << " calls in " << recorder.bytes() << " bytes, sum " << sum << endl;
+    }
+
+    vector<TraceRecord<int,int> > trace = readTrace<int,int>(buffer);
+    cout << "Trace:";
+    bool ordered = true;
+    for(size_t i = 0; i < trace.size(); i++) {
+        cout << " " << traceOpName(trace[i].op) << "(" << trace[i].key;
+        if(trace[i].op == TRACE_INSERT) cout << "," << trace[i].value;
+        if(trace[i].op == TRACE_WALK) cout << "," << trace[i].steps;
+        cout << ")";
+        ordered = ordered && (i == 0 || trace[i - 1].time <= trace[i].time);
+    }
+    cout << endl << "Times in order: " << ordered << endl;
+
+    // A replay rebuilds the recorded tree; operator[] assignments are not calls on the tree
+    vector<AVLTree<int,int> > one(1);
+    ReplayStats stats = replayTrace(one, trace);
+    one[0][40] = 400;
+    cout << "Replay matches: " << sameItems(one[0], tree) << ", " << stats.ops << " ops, "
+         << stats.hits << " hits, " << stats.visited << " walked, latencies " << stats.latency.size() << endl;
+
+    // Random inserts and removes of even keys, written, read back and
+    // replayed on four threads
+    vector<TraceRecord<int,int> > random;
+    AVLTree<int,int> expected;
+    srand(50);
+    for(int i = 0; i < 20000; i++) {
+        int key = 2 * (rand() % 2000);
+        if(rand() % 3 == 0) {
+            random.push_back(TraceRecord<int,int>(TRACE_REMOVE, i * 1000, key));
+            expected.remove(key);
+        }
+        else {
+            random.push_back(TraceRecord<int,int>(TRACE_INSERT, i * 1000, key, i));
+            expected.insert(std::make_pair(key, i));
+        }
+    }
+    stringstream file;
+    writeTrace(file, random);
+    vector<TraceRecord<int,int> > loaded = readTrace<int,int>(file);
+    vector<AVLTree<int,int> > shards(4);
+    stats = replayTrace(shards, loaded);
+    AVLTree<int,int> merged;
+    size_t misplaced = 0;
+    bool shared = true;
+    for(size_t t = 0; t < shards.size(); t++) {
+        for(AVLTree<int,int>::iterator it = shards[t].begin(); it != shards[t].end(); ++it) {
+            misplaced += (traceShard(it->first, shards.size()) != t);
+            merged.insert(*it);
+        }
+        shared = shared && shards[t].size() >= expected.size() / (2 * shards.size());
+    }
+    cout << "Four shards match: " << sameItems(merged, expected) << ", misplaced keys " << misplaced
+         << ", every shard has a share: " << shared << ", ops " << stats.ops << ", p50 <= p99 <= max: "
+         << (stats.percentile(50) <= stats.percentile(99) && stats.percentile(99) <= stats.percentile(100)) << endl;
+
+    // Each walk counts once, though every shard walks its part
+    vector<AVLTree<int,int> > split(4);
+    stats = replayTrace(split, trace);
+    cout << "Split replay: " << stats.ops << " ops of " << trace.size() << ", " << stats.visited << " walked, "
+         << stats.opLatency[TRACE_WALK].size() << " walk segments" << endl;
+
+    // At the recorded pace, 20000 calls a microsecond apart take at least 20 ms
+    vector<AVLTree<int,int> > paced(2);
+    stats = replayTrace(paced, loaded, 1.0);
+    cout << "Paced replay took at least 20 ms: " << (stats.seconds >= 0.02) << endl;
+
+    // A walk keeps the place it started at: calls made while it is open
+    // are written after it, so a replay walks the tree as it was
+    AVLTree<int,int> walked;
+    stringstream during;
+    {
+        RecordingTree<int,int> recorder(walked, during);
+        for(int i = 0; i < 4; i++) recorder.insert(std::make_pair(i, i));
+        RecordingTree<int,int>::iterator it = recorder.begin();
+        ++it;
+        recorder.insert(std::make_pair(10, 10));
+        recorder.remove(0);
+        ++it;
+        RecordingTree<int,int>::iterator copy = it;
+        ++copy;
+        cout << "Held while walking: " << recorder.records() << " records written";
+    }
+    vector<TraceRecord<int,int> > interleaved = readTrace<int,int>(during);
+    cout << ", then:";
+    ordered = true;
+    for(size_t i = 0; i < interleaved.size(); i++) {
+        cout << " " << traceOpName(interleaved[i].op) << "(" << interleaved[i].key;
+        if(interleaved[i].op == TRACE_WALK) cout << "," << interleaved[i].steps;
+        cout << ")";
+        ordered = ordered && (i == 0 || interleaved[i - 1].time <= interleaved[i].time);
+    }
+    vector<AVLTree<int,int> > again(1);
+    replayTrace(again, interleaved);
+    cout << endl << "Times in order: " << ordered << ", replay matches: " << sameItems(again[0], walked) << endl;
+
+    // A failed stream is reported, not silently dropped
+    stringstream broken;
+    RecordingTree<int,int> failing(walked, broken);
+    broken.setstate(std::ios::badbit);
+    try {
+        failing.insert(std::make_pair(20, 20));
+    }
+    catch(std::runtime_error& e) {
+        cout << "Failed stream: " << e.what() << ", tree untouched: " << (walked.find(20) == walked.end()) << endl;
+    }
+
+    // Damaged traces are rejected
+    string bytes = file.str();
+    stringstream truncated(bytes.substr(0, bytes.size() - 3)), wrong("BSTTRACX");
+    try {
+        readTrace<int,int>(truncated);
+    }
+    catch(std::runtime_error& e) {
+        cout << "Truncated: " << e.what() << endl;
+    }
+    try {
+        readTrace<int,int>(wrong);
+    }
+    catch(std::runtime_error& e) {
+        cout << "Bad header: " << e.what() << endl;
+    }
+    try {
+        stringstream whole(bytes);
+        readTrace<long long,int>(whole);
+    }
+    catch(std::runtime_error& e) {
+        cout << "Wrong key type: " << e.what() << endl;
+    }
+    return 0;
+}
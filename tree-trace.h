@@ -0,0 +1,751 @@
+#ifndef TREE_TRACE_H
+#define TREE_TRACE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+ * Workload traces: RecordingTree logs the calls made on a tree to a
+ * compact binary stream, and replayTrace runs such a trace against any
+ * tree with the same interface, timing every call.
+ *
+ * A trace starts with the 8 byte magic "BSTTRACE", a version byte and the
+ * sizes of Key and Value. Each record is then an op byte, the nanoseconds
+ * since the previous record as a LEB128 varint, the key's raw bytes, and
+ * the value's raw bytes for inserts or the step count (another varint)
+ * for walks. An int/int insert takes 10 or 11 bytes.
+ *
+ * Key and Value must be trivially copyable since they are stored as raw
+ * bytes, as in lsm-store.h, so traces only move between builds with the
+ * same layout for both.
+ */
+enum TraceOp { TRACE_INSERT, TRACE_REMOVE, TRACE_FIND, TRACE_AT, TRACE_WALK, TRACE_OP_COUNT };
+
+inline const char* traceOpName(TraceOp op)
+{
+    static const char* names[] = { "insert", "remove", "find", "operator[]", "walk" };
+    return (op < TRACE_OP_COUNT) ? names[op] : "unknown";
+}
+
+template <typename Key, typename Value>
+struct TraceRecord
+{
+    TraceRecord() : op(TRACE_FIND), time(0), key(), value(), steps(0) {}
+    TraceRecord(TraceOp o, uint64_t t, const Key& k, const Value& v = Value(), uint64_t s = 0) :
+        op(o), time(t), key(k), value(v), steps(s)
+    {}
+
+    TraceOp op;
+    uint64_t time;      // nanoseconds since the trace started
+    Key key;            // for walks, the key the walk started at
+    Value value;        // inserts only
+    uint64_t steps;     // walks only: the number of increments
+};
+
+/**
+ * Appends records to a binary stream; the header is written on
+ * construction. Record times must not go backwards. Throws
+ * std::runtime_error once the stream fails.
+ */
+template <typename Key, typename Value>
+class TraceWriter
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "traces store keys and values as raw bytes");
+public:
+    explicit TraceWriter(std::ostream& out);
+
+    void write(const TraceRecord<Key, Value>& record);
+    size_t records() const;
+    size_t bytes() const;
+
+protected:
+    // Helper functions
+    void writeVarint(uint64_t value);
+    void writeRaw(const void* data, size_t length);
+
+protected:
+    std::ostream& out_;
+    uint64_t lastTime_;
+    size_t records_;
+    size_t bytes_;
+};
+
+/**
+ * Reads records back from a stream written by TraceWriter. Throws
+ * std::runtime_error on a bad header, on key or value sizes that do not
+ * match, and on a truncated record.
+ */
+template <typename Key, typename Value>
+class TraceReader
+{
+public:
+    explicit TraceReader(std::istream& in);
+
+    // Reads the next record; false at the end of the trace.
+    bool read(TraceRecord<Key, Value>& record);
+
+protected:
+    // Helper functions
+    uint64_t readVarint();
+    void readRaw(void* data, size_t length);
+
+protected:
+    std::istream& in_;
+    uint64_t time_;
+};
+
+template <typename Key, typename Value>
+void writeTrace(std::ostream& out, const std::vector<TraceRecord<Key, Value> >& trace);
+template <typename Key, typename Value>
+std::vector<TraceRecord<Key, Value> > readTrace(std::istream& in);
+
+/**
+ * Forwards insert, remove, find, operator[] and iteration to a tree and
+ * logs each call with its time. Works for BinarySearchTree and every tree
+ * derived from it, since insert and remove are virtual and lookups go
+ * through internalFind.
+ *
+ * A walk takes its place and time in the trace when it starts, with the
+ * key it started at; its step count is only known once the last copy of
+ * its iterator is destroyed, so calls made meanwhile are held back and
+ * written after it. Iterators must not outlive the recorder. Walks that
+ * never advance are not logged. The recorder is exactly as thread-safe as
+ * the tree: callers that share the tree between threads must also
+ * serialize calls on the recorder.
+ *
+ * Calls throw std::runtime_error once the stream fails; a failure while
+ * writing held calls from an iterator's destructor shows up at the next
+ * logged call instead, as the stream stays failed.
+ */
+template <typename Key, typename Value>
+class RecordingTree
+{
+public:
+    RecordingTree(BinarySearchTree<Key, Value>& tree, std::ostream& out);
+    ~RecordingTree();
+
+    class iterator
+    {
+    public:
+        iterator();
+        std::pair<const Key, Value>& operator*() const;
+        std::pair<const Key, Value>* operator->() const;
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+        iterator& operator++();
+    protected:
+        friend class RecordingTree<Key, Value>;
+
+        // Shared by copies of an iterator; reserves the walk's record when
+        // made and fills in its steps when the last copy goes.
+        struct Walk
+        {
+            Walk(RecordingTree<Key, Value>* owner, const Key& start) : owner(owner), slot(owner->openWalk(start)), steps(0) {}
+            ~Walk() { owner->closeWalk(slot, steps); }
+            RecordingTree<Key, Value>* owner;
+            size_t slot;
+            uint64_t steps;
+        };
+
+        iterator(RecordingTree<Key, Value>* owner, const typename BinarySearchTree<Key, Value>::iterator& it);
+        typename BinarySearchTree<Key, Value>::iterator it_;
+        std::shared_ptr<Walk> walk_;
+    };
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    iterator find(const Key& key);
+    Value& operator[](const Key& key);
+    iterator begin();
+    iterator end();
+
+    size_t size() const;
+    bool empty() const;
+    size_t records() const;
+    size_t bytes() const;
+    BinarySearchTree<Key, Value>& tree();
+
+protected:
+    typedef std::chrono::steady_clock Clock;
+
+    // Helper functions
+    uint64_t now() const;
+    void log(TraceOp op, const Key& key, const Value& value = Value());
+    size_t openWalk(const Key& start);
+    void closeWalk(size_t slot, uint64_t steps);
+    void writeHeld();
+
+protected:
+    BinarySearchTree<Key, Value>& tree_;
+    TraceWriter<Key, Value> writer_;
+    Clock::time_point start_;
+    std::deque<TraceRecord<Key, Value> > held_; // calls from the oldest open walk on, in call order
+    std::deque<bool> open_;                     // for each of held_, a walk still being made
+    size_t heldFrom_;                           // slot of held_.front(); slots count every held record
+};
+
+/**
+ * What a replay measured. Latencies are in nanoseconds, sorted, overall
+ * and per op, one per call made on a tree, so a walk replayed on n shards
+ * gives n latencies for its n segments but counts once in ops; paced replays time each call from when it was due rather
+ * than from when it started, so a replay that falls behind shows the
+ * queueing delay instead of hiding it.
+ */
+struct ReplayStats
+{
+    ReplayStats() : ops(0), hits(0), visited(0), seconds(0.0) {}
+
+    size_t ops;             // trace records replayed, each walk once however many shards ran it
+    size_t hits;            // finds and operator[] calls whose key was present
+    size_t visited;         // increments made by walks
+    double seconds;
+    std::vector<uint64_t> latency;
+    std::vector<uint64_t> opLatency[TRACE_OP_COUNT];
+
+    double throughput() const { return seconds > 0 ? ops / seconds : 0.0; }
+
+    // The p-th percentile, 0 <= p <= 100, of all calls or of one op; 0 if there were none.
+    uint64_t percentile(double p, int op = -1) const
+    {
+        const std::vector<uint64_t>& sorted = (op < 0) ? latency : opLatency[op];
+        if(sorted.empty()) return 0;
+        size_t rank = (size_t)(p / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    friend std::ostream& operator<<(std::ostream& os, const ReplayStats& s)
+    {
+        os << s.ops << " ops in " << s.seconds << " s, " << (size_t)s.throughput() << " ops/s, "
+           << s.hits << " hits, " << s.visited << " walked" << std::endl;
+        os << "  latency ns    p50 " << s.percentile(50) << "  p90 " << s.percentile(90) << "  p99 "
+           << s.percentile(99) << "  p99.9 " << s.percentile(99.9) << "  max " << s.percentile(100) << std::endl;
+        for(int op = 0; op < TRACE_OP_COUNT; op++) {
+            if(s.opLatency[op].empty()) continue;
+            os << "  " << traceOpName((TraceOp)op) << ": " << s.opLatency[op].size() << " ops, p50 "
+               << s.percentile(50, op) << "  p99 " << s.percentile(99, op) << "  max "
+               << s.percentile(100, op) << std::endl;
+        }
+        return os;
+    }
+};
+
+/**
+ * The shard, of shards, whose tree replayTrace gives key's calls to.
+ * std::hash is the identity for integers, so its result goes through the
+ * splitmix64 finalizer first; keys with a common factor, all even say,
+ * would otherwise land on only some of the shards.
+ */
+template <typename Key>
+size_t traceShard(const Key& key, size_t shards)
+{
+    uint64_t h = (uint64_t)std::hash<Key>()(key) + 0x9e3779b97f4a7c15ULL;
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return (size_t)(h % shards);
+}
+
+namespace tree_trace_detail {
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * Replays the records that belong to one shard: those whose key hashes
+ * to it, and every walk, cut to its share of the steps. Shard 0 alone
+ * counts walks in ops.
+ */
+template <typename Tree, typename Key, typename Value>
+void replayShard(Tree& tree, const std::vector<TraceRecord<Key, Value> >& trace, size_t shard, size_t shards,
+                 double speed, Clock::time_point start, ReplayStats& stats)
+{
+    for(size_t i = 0; i < trace.size(); i++) {
+        const TraceRecord<Key, Value>& record = trace[i];
+        if(record.op != TRACE_WALK && shards > 1 && traceShard(record.key, shards) != shard) continue;
+
+        Clock::time_point begin = Clock::now();
+        if(speed > 0) {
+            Clock::time_point due = start + std::chrono::nanoseconds((uint64_t)(record.time / speed));
+            // Sleeping oversleeps by tens of microseconds, so only sleep
+            // for long gaps and yield through short ones
+            if(due - begin > std::chrono::microseconds(200))
+                std::this_thread::sleep_until(due - std::chrono::microseconds(100));
+            while(Clock::now() < due) std::this_thread::yield();
+            begin = due;
+        }
+
+        switch(record.op) {
+        case TRACE_INSERT:
+            tree.insert(std::make_pair(record.key, record.value));
+            break;
+        case TRACE_REMOVE:
+            tree.remove(record.key);
+            break;
+        case TRACE_FIND:
+            stats.hits += (tree.find(record.key) != tree.end());
+            break;
+        case TRACE_AT:
+            try {
+                tree[record.key];
+                stats.hits++;
+            }
+            catch(std::out_of_range&) {
+            }
+            break;
+        default: {
+            uint64_t steps = (record.steps + shards - 1) / shards;
+            typename Tree::iterator it = tree.lower_bound(record.key);
+            for(uint64_t s = 0; s < steps && it != tree.end(); s++, ++it) stats.visited++;
+            break;
+        }
+        }
+
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+        stats.latency.push_back(ns);
+        stats.opLatency[record.op].push_back(ns);
+        if(record.op != TRACE_WALK || shard == 0) stats.ops++;
+    }
+}
+
+}
+
+/**
+ * Replays trace against the trees in shards, one thread per tree; give a
+ * single tree for a plain sequential replay. Each record goes to the
+ * shard traceShard picks for its key, so every tree sees its keys' calls in trace
+ * order and ends up the same on every run whatever the thread timing.
+ * Walks run on every shard over a proportional share of their steps.
+ *
+ * speed 0 replays as fast as possible; otherwise calls are issued at the
+ * trace's own times divided by speed, so 1 is real time and 10 is ten
+ * times faster. The shards may be preloaded or hold results of an earlier
+ * replay.
+ */
+template <typename Tree, typename Key, typename Value>
+ReplayStats replayTrace(std::vector<Tree>& shards, const std::vector<TraceRecord<Key, Value> >& trace,
+                        double speed = 0)
+{
+    if(shards.empty()) throw std::invalid_argument("replayTrace needs at least one tree");
+    std::vector<ReplayStats> partial(shards.size());
+    tree_trace_detail::Clock::time_point start = tree_trace_detail::Clock::now();
+    if(shards.size() == 1) {
+        tree_trace_detail::replayShard(shards[0], trace, 0, 1, speed, start, partial[0]);
+    }
+    else {
+        std::vector<std::thread> workers;
+        for(size_t t = 0; t < shards.size(); t++) {
+            workers.push_back(std::thread([&, t]() {
+                tree_trace_detail::replayShard(shards[t], trace, t, shards.size(), speed, start, partial[t]);
+            }));
+        }
+        for(size_t t = 0; t < workers.size(); t++) workers[t].join();
+    }
+
+    ReplayStats stats;
+    stats.seconds = std::chrono::duration<double>(tree_trace_detail::Clock::now() - start).count();
+    for(size_t t = 0; t < partial.size(); t++) {
+        stats.ops += partial[t].ops;
+        stats.hits += partial[t].hits;
+        stats.visited += partial[t].visited;
+        stats.latency.insert(stats.latency.end(), partial[t].latency.begin(), partial[t].latency.end());
+        for(int op = 0; op < TRACE_OP_COUNT; op++)
+            stats.opLatency[op].insert(stats.opLatency[op].end(), partial[t].opLatency[op].begin(),
+                                       partial[t].opLatency[op].end());
+    }
+    std::sort(stats.latency.begin(), stats.latency.end());
+    for(int op = 0; op < TRACE_OP_COUNT; op++) std::sort(stats.opLatency[op].begin(), stats.opLatency[op].end());
+    return stats;
+}
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TraceWriter class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+TraceWriter<Key, Value>::TraceWriter(std::ostream& out) :
+    out_(out), lastTime_(0), records_(0), bytes_(0)
+{
+    const unsigned char header[11] = { 'B', 'S', 'T', 'T', 'R', 'A', 'C', 'E', 1,
+                                       (unsigned char)sizeof(Key), (unsigned char)sizeof(Value) };
+    writeRaw(header, sizeof(header));
+}
+
+template<class Key, class Value>
+void TraceWriter<Key, Value>::write(const TraceRecord<Key, Value>& record)
+{
+    unsigned char op = (unsigned char)record.op;
+    uint64_t time = std::max(record.time, lastTime_);
+    writeRaw(&op, 1);
+    writeVarint(time - lastTime_);
+    writeRaw(&record.key, sizeof(Key));
+    if(record.op == TRACE_INSERT) writeRaw(&record.value, sizeof(Value));
+    else if(record.op == TRACE_WALK) writeVarint(record.steps);
+    lastTime_ = time;
+    records_++;
+}
+
+template<class Key, class Value>
+size_t TraceWriter<Key, Value>::records() const
+{
+    return records_;
+}
+
+template<class Key, class Value>
+size_t TraceWriter<Key, Value>::bytes() const
+{
+    return bytes_;
+}
+
+template<class Key, class Value>
+void TraceWriter<Key, Value>::writeVarint(uint64_t value)
+{
+    unsigned char buffer[10];
+    size_t length = 0;
+    do {
+        buffer[length] = value & 0x7f;
+        value >>= 7;
+        if(value != 0) buffer[length] |= 0x80;
+        length++;
+    } while(value != 0);
+    writeRaw(buffer, length);
+}
+
+template<class Key, class Value>
+void TraceWriter<Key, Value>::writeRaw(const void* data, size_t length)
+{
+    if(!out_.write((const char*)data, length)) throw std::runtime_error("Cannot write trace");
+    bytes_ += length;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TraceWriter class.
+  -----------------------------------------------
+*/
+
+/*
+  -------------------------------------------------
+  Begin implementations for the TraceReader class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+TraceReader<Key, Value>::TraceReader(std::istream& in) :
+    in_(in), time_(0)
+{
+    unsigned char header[11];
+    if(!in_.read((char*)header, sizeof(header)) || std::memcmp(header, "BSTTRACE", 8) != 0 || header[8] != 1)
+        throw std::runtime_error("Not a tree trace");
+    if(header[9] != sizeof(Key) || header[10] != sizeof(Value))
+        throw std::runtime_error("Trace key or value size does not match");
+}
+
+template<class Key, class Value>
+bool TraceReader<Key, Value>::read(TraceRecord<Key, Value>& record)
+{
+    int op = in_.get();
+    if(op == std::char_traits<char>::eof()) return false;
+    if(op >= TRACE_OP_COUNT) throw std::runtime_error("Bad trace record");
+    record.op = (TraceOp)op;
+    time_ += readVarint();
+    record.time = time_;
+    readRaw(&record.key, sizeof(Key));
+    record.value = Value();
+    record.steps = 0;
+    if(record.op == TRACE_INSERT) readRaw(&record.value, sizeof(Value));
+    else if(record.op == TRACE_WALK) record.steps = readVarint();
+    return true;
+}
+
+template<class Key, class Value>
+uint64_t TraceReader<Key, Value>::readVarint()
+{
+    uint64_t value = 0;
+    for(unsigned shift = 0; shift < 64; shift += 7) {
+        int byte = in_.get();
+        if(byte == std::char_traits<char>::eof()) throw std::runtime_error("Truncated trace");
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if((byte & 0x80) == 0) return value;
+    }
+    throw std::runtime_error("Bad trace record");
+}
+
+template<class Key, class Value>
+void TraceReader<Key, Value>::readRaw(void* data, size_t length)
+{
+    if(!in_.read((char*)data, length)) throw std::runtime_error("Truncated trace");
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the TraceReader class.
+  -----------------------------------------------
+*/
+
+template <typename Key, typename Value>
+void writeTrace(std::ostream& out, const std::vector<TraceRecord<Key, Value> >& trace)
+{
+    TraceWriter<Key, Value> writer(out);
+    for(size_t i = 0; i < trace.size(); i++) writer.write(trace[i]);
+}
+
+template <typename Key, typename Value>
+std::vector<TraceRecord<Key, Value> > readTrace(std::istream& in)
+{
+    TraceReader<Key, Value> reader(in);
+    std::vector<TraceRecord<Key, Value> > trace;
+    TraceRecord<Key, Value> record;
+    while(reader.read(record)) trace.push_back(record);
+    return trace;
+}
+
+/*
+  -------------------------------------------------------------
+  Begin implementations for the RecordingTree::iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+RecordingTree<Key, Value>::iterator::iterator()
+{
+}
+
+template<class Key, class Value>
+RecordingTree<Key, Value>::iterator::iterator(RecordingTree<Key, Value>* owner,
+                                              const typename BinarySearchTree<Key, Value>::iterator& it) :
+    it_(it)
+{
+    if(it_ != owner->tree_.end()) walk_ = std::make_shared<Walk>(owner, it_->first);
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& RecordingTree<Key, Value>::iterator::operator*() const
+{
+    return *it_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>* RecordingTree<Key, Value>::iterator::operator->() const
+{
+    return &(*it_);
+}
+
+template<class Key, class Value>
+bool RecordingTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+    return it_ == rhs.it_;
+}
+
+template<class Key, class Value>
+bool RecordingTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+    return it_ != rhs.it_;
+}
+
+template<class Key, class Value>
+typename RecordingTree<Key, Value>::iterator& RecordingTree<Key, Value>::iterator::operator++()
+{
+    ++it_;
+    if(walk_) walk_->steps++;
+    return *this;
+}
+
+/*
+  -----------------------------------------------------------
+  End implementations for the RecordingTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the RecordingTree class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value>
+RecordingTree<Key, Value>::RecordingTree(BinarySearchTree<Key, Value>& tree, std::ostream& out) :
+    tree_(tree), writer_(out), start_(Clock::now()), heldFrom_(0)
+{
+}
+
+/**
+* Writes what is still held, with any walk left open cut off where it is.
+*/
+template<class Key, class Value>
+RecordingTree<Key, Value>::~RecordingTree()
+{
+    std::fill(open_.begin(), open_.end(), false);
+    try {
+        writeHeld();
+    }
+    catch(std::runtime_error&) {
+    }
+}
+
+template<class Key, class Value>
+void RecordingTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    log(TRACE_INSERT, keyValuePair.first, keyValuePair.second);
+    tree_.insert(keyValuePair);
+}
+
+template<class Key, class Value>
+void RecordingTree<Key, Value>::remove(const Key& key)
+{
+    log(TRACE_REMOVE, key);
+    tree_.remove(key);
+}
+
+template<class Key, class Value>
+typename RecordingTree<Key, Value>::iterator RecordingTree<Key, Value>::find(const Key& key)
+{
+    log(TRACE_FIND, key);
+    return iterator(this, tree_.find(key));
+}
+
+/**
+* Logged before the lookup, so calls that throw std::out_of_range are in
+* the trace too.
+*/
+template<class Key, class Value>
+Value& RecordingTree<Key, Value>::operator[](const Key& key)
+{
+    log(TRACE_AT, key);
+    return tree_[key];
+}
+
+template<class Key, class Value>
+typename RecordingTree<Key, Value>::iterator RecordingTree<Key, Value>::begin()
+{
+    return iterator(this, tree_.begin());
+}
+
+template<class Key, class Value>
+typename RecordingTree<Key, Value>::iterator RecordingTree<Key, Value>::end()
+{
+    return iterator(this, tree_.end());
+}
+
+template<class Key, class Value>
+size_t RecordingTree<Key, Value>::size() const
+{
+    return tree_.size();
+}
+
+template<class Key, class Value>
+bool RecordingTree<Key, Value>::empty() const
+{
+    return tree_.empty();
+}
+
+template<class Key, class Value>
+size_t RecordingTree<Key, Value>::records() const
+{
+    return writer_.records();
+}
+
+template<class Key, class Value>
+size_t RecordingTree<Key, Value>::bytes() const
+{
+    return writer_.bytes();
+}
+
+template<class Key, class Value>
+BinarySearchTree<Key, Value>& RecordingTree<Key, Value>::tree()
+{
+    return tree_;
+}
+
+template<class Key, class Value>
+uint64_t RecordingTree<Key, Value>::now() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+}
+
+/**
+* Helper function: log
+*
+* Writes the call at once unless a walk before it is still open.
+*/
+template<class Key, class Value>
+void RecordingTree<Key, Value>::log(TraceOp op, const Key& key, const Value& value)
+{
+    TraceRecord<Key, Value> record(op, now(), key, value);
+    if(held_.empty()) {
+        writer_.write(record);
+        return;
+    }
+    held_.push_back(record);
+    open_.push_back(false);
+}
+
+/**
+* Helper function: openWalk
+*
+* Holds a walk record, timed now, in call order; returns its slot.
+*/
+template<class Key, class Value>
+size_t RecordingTree<Key, Value>::openWalk(const Key& start)
+{
+    held_.push_back(TraceRecord<Key, Value>(TRACE_WALK, now(), start));
+    open_.push_back(true);
+    return heldFrom_ + held_.size() - 1;
+}
+
+/**
+* Helper function: closeWalk
+*
+* Called from a destructor, so a failed write is left for the next logged
+* call to report.
+*/
+template<class Key, class Value>
+void RecordingTree<Key, Value>::closeWalk(size_t slot, uint64_t steps)
+{
+    held_[slot - heldFrom_].steps = steps;
+    open_[slot - heldFrom_] = false;
+    try {
+        writeHeld();
+    }
+    catch(std::runtime_error&) {
+    }
+}
+
+/**
+* Helper function: writeHeld
+*
+* Writes held records up to the oldest walk still open, dropping walks
+* that never advanced.
+*/
+template<class Key, class Value>
+void RecordingTree<Key, Value>::writeHeld()
+{
+    while(!held_.empty() && !open_.front()) {
+        const TraceRecord<Key, Value>& record = held_.front();
+        if(record.op != TRACE_WALK || record.steps != 0) writer_.write(record);
+        held_.pop_front();
+        open_.pop_front();
+        heldFrom_++;
+    }
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the RecordingTree class.
+  -------------------------------------------------
+*/
+
+#endif